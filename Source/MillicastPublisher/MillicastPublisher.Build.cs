@@ -49,7 +49,8 @@ namespace UnrealBuildTool.Rules
 					"CinematicCamera",
 					"InputCore",
 					"libOpus",
-					"AudioPlatformConfiguration"
+					"AudioPlatformConfiguration",
+					"MillicastPublisherShaders"
 				});
 
 			PrivateIncludePathModuleNames.AddRange(
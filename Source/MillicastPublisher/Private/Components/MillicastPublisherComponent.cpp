@@ -16,14 +16,124 @@
 #include "WebSocketsModule.h"
 #include "IWebSocket.h"
 #include "WebRTC/PeerConnection.h"
+#include "WebRTC/SdpEditor.h"
 
 #include "Util.h"
 
+#include "Async/Async.h"
 #include "Interfaces/IPluginManager.h"
 #include "Kismet/GameplayStatics.h"
 
 constexpr auto HTTP_OK = 200;
 
+/** Codec parameters written in the offer and the answer, from the settings of the source */
+static FSdpCodecProfile MakeCodecProfile(const UMillicastPublisherSource& Source)
+{
+	FSdpCodecProfile Profile;
+
+	if (Source.CaptureAudio)
+	{
+		// The channels of the audio sent to webrtc, shared by all the publishers
+		const int NumChannels = FWebRTCPeerConnection::GetAudioDeviceModule()->GetNumChannels();
+
+		if (NumChannels > 2)
+		{
+			Profile.PreferredAudioFormat = "multiopus/48000/" + std::to_string(NumChannels);
+		}
+		else if (NumChannels == 2)
+		{
+			// Mono is encoded unless the stereo parameter is set
+			Profile.bOpusStereo = true;
+		}
+
+		if (Source.AudioBitrate > 0)
+		{
+			Profile.OpusMaxAverageBitrate = Source.AudioBitrate * 1000;
+		}
+
+		static constexpr int32 PacketTimesMs[] = { 10, 20, 40, 60 };
+		Profile.AudioPtime = PacketTimesMs[FMath::Clamp<int32>(Source.AudioPacketTime, 0, UE_ARRAY_COUNT(PacketTimesMs) - 1)];
+
+		Profile.bOpusFec = Source.AudioFec;
+		if (Source.AudioDtx)
+		{
+			Profile.bOpusDtx = true;
+		}
+		if (Source.AudioCbr)
+		{
+			Profile.bOpusCbr = true;
+		}
+	}
+
+	if (Source.CaptureVideo)
+	{
+		if (Source.VideoStartBitrate > 0)
+		{
+			Profile.VideoStartBitrate = Source.VideoStartBitrate;
+		}
+		if (Source.VideoMinBitrate > 0)
+		{
+			Profile.VideoMinBitrate = Source.VideoMinBitrate;
+		}
+		if (Source.VideoMaxBitrate > 0)
+		{
+			Profile.VideoMaxBitrate = Source.VideoMaxBitrate;
+		}
+	}
+
+	return Profile;
+}
+
+/** Collect the stats of the video encodings sent, and broadcast them from the game thread */
+class FVideoLayerStatsCallback : public webrtc::RTCStatsCollectorCallback
+{
+	TWeakObjectPtr<UMillicastPublisherComponent> Component;
+
+	template<typename T>
+	static T ValueOr(const webrtc::RTCStatsMember<T>& Member, T Default)
+	{
+		return Member.is_defined() ? *Member : Default;
+	}
+
+public:
+	explicit FVideoLayerStatsCallback(UMillicastPublisherComponent* InComponent) : Component(InComponent) {}
+
+	void OnStatsDelivered(const rtc::scoped_refptr<const webrtc::RTCStatsReport>& Report) override
+	{
+		TArray<FMillicastVideoLayerStats> Layers;
+
+		for (const auto* Stats : Report->GetStatsOfType<webrtc::RTCOutboundRTPStreamStats>())
+		{
+			if (ValueOr<std::string>(Stats->kind, "") != webrtc::RTCMediaStreamTrackKind::kVideo)
+			{
+				continue;
+			}
+
+			FMillicastVideoLayerStats& Layer = Layers.AddDefaulted_GetRef();
+#if WEBRTC_VERSION >= 96
+			Layer.Rid = ToString(ValueOr<std::string>(Stats->rid, ""));
+#endif
+			Layer.Width = static_cast<int32>(ValueOr<uint32_t>(Stats->frame_width, 0));
+			Layer.Height = static_cast<int32>(ValueOr<uint32_t>(Stats->frame_height, 0));
+			Layer.FramesPerSecond = static_cast<float>(ValueOr<double>(Stats->frames_per_second, 0.0));
+			Layer.FramesEncoded = ValueOr<uint32_t>(Stats->frames_encoded, 0);
+			Layer.TargetBitrate = static_cast<float>(ValueOr<double>(Stats->target_bitrate, 0.0) / 1000.0);
+
+			if (Layer.FramesEncoded > 0)
+			{
+				Layer.EncodeMsPerFrame = static_cast<float>(ValueOr<double>(Stats->total_encode_time, 0.0) * 1000.0 / Layer.FramesEncoded);
+			}
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [Component = Component, Layers = MoveTemp(Layers)]() {
+			if (Component.IsValid())
+			{
+				Component->OnVideoLayerStats.Broadcast(Layers);
+			}
+		});
+	}
+};
+
 // lambda check if the event is bound before broadcasting.
 auto MakeBroadcastEvent = [](auto&& Event) {
 	return [&Event](auto&& ... Args) {
@@ -272,17 +382,16 @@ bool UMillicastPublisherComponent::PublishToMillicast()
 	CreateSessionDescriptionObserver->SetOnSuccessCallback([this](const std::string& type, const std::string& sdp) {
 		UE_LOG(LogMillicastPublisher, Display, TEXT("pc.createOffer() | sucess\nsdp : %S"), sdp.c_str());
 
-		const std::string s = "minptime=10;useinbandfec=1";
-		std::string sdp_non_const = sdp;
-		std::ostringstream oss;
-		oss << s << "; stereo=1";
+		std::string LocalSdp = sdp;
 
-		auto pos = sdp.find(s);
-		if (pos != std::string::npos) {
-			sdp_non_const.replace(sdp.find(s), s.size(), oss.str());
+		FSdpEditor SdpEditor;
+		if (SdpEditor.Parse(sdp))
+		{
+			SdpEditor.Apply(MakeCodecProfile(*MillicastMediaSource));
+			LocalSdp = SdpEditor.ToString();
 		}
 
-		PeerConnection->SetLocalDescription(sdp_non_const, type);
+		PeerConnection->SetLocalDescription(LocalSdp, type);
 	});
 
 	CreateSessionDescriptionObserver->SetOnFailureCallback([this](const std::string& err) {
@@ -353,12 +462,8 @@ bool UMillicastPublisherComponent::PublishToMillicast()
 	PeerConnection->OaOptions.offer_to_receive_video = false;
 	PeerConnection->OaOptions.offer_to_receive_audio = false;
 
-	// Maximum bitrate
-	if (MaximumBitrate.IsSet()) {
-		webrtc::PeerConnectionInterface::BitrateParameters bitrateParameters;
-		bitrateParameters.max_bitrate_bps = *MaximumBitrate;
-		(*PeerConnection)->SetBitrate(bitrateParameters);
-	}
+	// Minimum, start and maximum bitrate
+	ApplyBitrates(true);
 
 	UE_LOG(LogMillicastPublisher, Log, TEXT("Create offer"));
 	PeerConnection->CreateOffer();
@@ -412,7 +517,17 @@ void UMillicastPublisherComponent::OnMessage(const FString& Msg)
 		FString Sdp = DataJson->GetStringField("sdp");
 		if (PeerConnection) 
 		{
-			PeerConnection->SetRemoteDescription(to_string(Sdp));
+			std::string RemoteSdp = to_string(Sdp);
+
+			// webrtc configures the encoders from the answer, the send parameters are set again in case the server dropped them
+			FSdpEditor SdpEditor;
+			if (MillicastMediaSource && SdpEditor.Parse(RemoteSdp))
+			{
+				SdpEditor.ApplyCodecParameters(MakeCodecProfile(*MillicastMediaSource));
+				RemoteSdp = SdpEditor.ToString();
+			}
+
+			PeerConnection->SetRemoteDescription(RemoteSdp);
 		}
 	}
 	else if(Type == "error") // Error in the request data sent to millicast
@@ -446,12 +561,34 @@ void UMillicastPublisherComponent::CaptureAndAddTracks()
 		init.direction = webrtc::RtpTransceiverDirection::kSendOnly;
 		init.stream_ids = { "unrealstream" };
 
+		if (Track->kind() == webrtc::MediaStreamTrackInterface::kVideoKind)
+		{
+			init.send_encodings = FWebRTCPeerConnection::MakeSendEncodings(*MillicastMediaSource);
+		}
+
 		auto result = (*PeerConnection)->AddTransceiver(Track, init);
 
 		if (result.ok())
 		{
 			UE_LOG(LogMillicastPublisher, Log, TEXT("Add transceiver for %s track : %s"), 
 				Track->kind().c_str(), Track->id().c_str());
+
+			if (Track->kind() == webrtc::MediaStreamTrackInterface::kVideoKind && MillicastMediaSource->PreferredVideoCodecs.Num() > 0)
+			{
+				auto Codecs = FWebRTCPeerConnection::GetVideoCodecPreferences(MillicastMediaSource->PreferredVideoCodecs);
+				if (Codecs.empty())
+				{
+					UE_LOG(LogMillicastPublisher, Warning, TEXT("None of the preferred video codecs is available, every codec is offered"));
+				}
+				else
+				{
+					auto Error = result.value()->SetCodecPreferences(Codecs);
+					if (!Error.ok())
+					{
+						UE_LOG(LogMillicastPublisher, Error, TEXT("Couldn't set the video codec preferences : %S"), Error.message());
+					}
+				}
+			}
 		}
 		else
 		{
@@ -466,4 +603,183 @@ void UMillicastPublisherComponent::CaptureAndAddTracks()
 void UMillicastPublisherComponent::SetMaximumBitrate(int Bps)
 {
 	MaximumBitrate = Bps;
+	ApplyBitrates(false);
+}
+
+void UMillicastPublisherComponent::SetMinimumBitrate(int Bps)
+{
+	MinimumBitrate = Bps;
+	ApplyBitrates(false);
+}
+
+void UMillicastPublisherComponent::SetStartBitrate(int Bps)
+{
+	StartBitrate = Bps;
+	ApplyBitrates(true);
+}
+
+void UMillicastPublisherComponent::ApplyBitrates(bool bApplyStartBitrate)
+{
+	// Set before publishing, applied once the peerconnection is created
+	if (!PeerConnection)
+	{
+		return;
+	}
+
+	webrtc::BitrateSettings Settings;
+	if (MinimumBitrate.IsSet())
+	{
+		Settings.min_bitrate_bps = *MinimumBitrate;
+	}
+	if (bApplyStartBitrate && StartBitrate.IsSet())
+	{
+		Settings.start_bitrate_bps = *StartBitrate;
+	}
+	if (MaximumBitrate.IsSet())
+	{
+		Settings.max_bitrate_bps = *MaximumBitrate;
+	}
+
+	if (!Settings.min_bitrate_bps && !Settings.start_bitrate_bps && !Settings.max_bitrate_bps)
+	{
+		return;
+	}
+
+	// Fails if the bitrates aren't ordered min <= start <= max
+	auto Error = (*PeerConnection)->SetBitrate(Settings);
+	if (!Error.ok())
+	{
+		UE_LOG(LogMillicastPublisher, Error, TEXT("Couldn't set the bitrates : %S"), Error.message());
+	}
+}
+
+TArray<FMillicastEncodingParameters> UMillicastPublisherComponent::GetAudioEncodingParameters() const
+{
+	return GetEncodingParameters(webrtc::MediaStreamTrackInterface::kAudioKind);
+}
+
+bool UMillicastPublisherComponent::SetAudioEncodingParameters(const TArray<FMillicastEncodingParameters>& Parameters)
+{
+	return SetEncodingParameters(webrtc::MediaStreamTrackInterface::kAudioKind, Parameters);
+}
+
+TArray<FMillicastEncodingParameters> UMillicastPublisherComponent::GetVideoEncodingParameters() const
+{
+	return GetEncodingParameters(webrtc::MediaStreamTrackInterface::kVideoKind);
+}
+
+bool UMillicastPublisherComponent::SetVideoEncodingParameters(const TArray<FMillicastEncodingParameters>& Parameters)
+{
+	return SetEncodingParameters(webrtc::MediaStreamTrackInterface::kVideoKind, Parameters);
+}
+
+/** Sender of the first track of a kind, audio or video */
+static rtc::scoped_refptr<webrtc::RtpSenderInterface> FindSender(FWebRTCPeerConnection& PeerConnection, const std::string& Kind)
+{
+	for (const auto& Sender : PeerConnection->GetSenders())
+	{
+		if (Sender->track() && Sender->track()->kind() == Kind)
+		{
+			return Sender;
+		}
+	}
+	return nullptr;
+}
+
+TArray<FMillicastEncodingParameters> UMillicastPublisherComponent::GetEncodingParameters(const std::string& Kind) const
+{
+	TArray<FMillicastEncodingParameters> Parameters;
+
+	auto Sender = PeerConnection ? FindSender(*PeerConnection, Kind) : nullptr;
+	if (!Sender)
+	{
+		return Parameters;
+	}
+
+	for (const webrtc::RtpEncodingParameters& Encoding : Sender->GetParameters().encodings)
+	{
+		FMillicastEncodingParameters& Encoded = Parameters.AddDefaulted_GetRef();
+		Encoded.Rid = ToString(Encoding.rid);
+		Encoded.Active = Encoding.active;
+		Encoded.MaxBitrate = Encoding.max_bitrate_bps.value_or(0) / 1000;
+		Encoded.MaxFramerate = static_cast<int32>(Encoding.max_framerate.value_or(0));
+		Encoded.ScaleResolutionDownBy = static_cast<float>(Encoding.scale_resolution_down_by.value_or(1.0));
+		Encoded.BitratePriority = static_cast<float>(Encoding.bitrate_priority);
+		Encoded.NetworkPriority = static_cast<EncodingPriority>(Encoding.network_priority);
+	}
+
+	return Parameters;
+}
+
+bool UMillicastPublisherComponent::SetEncodingParameters(const std::string& Kind, const TArray<FMillicastEncodingParameters>& Parameters)
+{
+	auto Sender = PeerConnection ? FindSender(*PeerConnection, Kind) : nullptr;
+	if (!Sender)
+	{
+		UE_LOG(LogMillicastPublisher, Warning, TEXT("No %S sender to set the encoding parameters of"), Kind.c_str());
+		return false;
+	}
+
+	// The parameters have to be the last ones read, with the same encodings
+	webrtc::RtpParameters RtpParameters = Sender->GetParameters();
+	if (RtpParameters.encodings.size() != static_cast<size_t>(Parameters.Num()))
+	{
+		UE_LOG(LogMillicastPublisher, Error, TEXT("The %S sender has %d encodings, %d given"),
+			Kind.c_str(), int(RtpParameters.encodings.size()), Parameters.Num());
+		return false;
+	}
+
+	const bool bVideo = Kind == webrtc::MediaStreamTrackInterface::kVideoKind;
+
+	for (int32 Index = 0; Index < Parameters.Num(); ++Index)
+	{
+		const FMillicastEncodingParameters& Encoded = Parameters[Index];
+		webrtc::RtpEncodingParameters& Encoding = RtpParameters.encodings[Index];
+
+		Encoding.active = Encoded.Active;
+		Encoding.bitrate_priority = FMath::Max(Encoded.BitratePriority, 0.f);
+		Encoding.network_priority = static_cast<webrtc::Priority>(Encoded.NetworkPriority.GetValue());
+
+		if (Encoded.MaxBitrate > 0)
+		{
+			Encoding.max_bitrate_bps = Encoded.MaxBitrate * 1000;
+		}
+		else
+		{
+			Encoding.max_bitrate_bps.reset();
+		}
+
+		// Not supported by the audio senders
+		if (bVideo)
+		{
+			if (Encoded.MaxFramerate > 0)
+			{
+				Encoding.max_framerate = Encoded.MaxFramerate;
+			}
+			else
+			{
+				Encoding.max_framerate.reset();
+			}
+			Encoding.scale_resolution_down_by = FMath::Max(Encoded.ScaleResolutionDownBy, 1.f);
+		}
+	}
+
+	auto Error = Sender->SetParameters(RtpParameters);
+	if (!Error.ok())
+	{
+		UE_LOG(LogMillicastPublisher, Error, TEXT("Couldn't set the %S encoding parameters : %S"), Kind.c_str(), Error.message());
+		return false;
+	}
+
+	return true;
+}
+
+void UMillicastPublisherComponent::RequestVideoLayerStats()
+{
+	if (!PeerConnection)
+	{
+		return;
+	}
+
+	(*PeerConnection)->GetStats(new rtc::RefCountedObject<FVideoLayerStatsCallback>(this));
 }
\ No newline at end of file
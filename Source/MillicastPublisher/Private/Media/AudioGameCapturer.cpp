@@ -3,6 +3,7 @@
 
 #include "MillicastPublisherPrivate.h"
 #include "WebRTC/PeerConnection.h"
+#include "WebRTC/AudioDownmix.h"
 
 #include "Util.h"
 
@@ -24,7 +25,8 @@ IMillicastAudioSource* IMillicastAudioSource::Create(AudioCapturerType CapturerT
 	return nullptr;
 }
 
-AudioCapturerBase::AudioCapturerBase() noexcept : RtcAudioSource(nullptr), RtcAudioTrack(nullptr)
+AudioCapturerBase::AudioCapturerBase() noexcept : RtcAudioSource(nullptr), RtcAudioTrack(nullptr),
+	MixGain(1.f), bMixMuted(false)
 {}
 
 void AudioCapturerBase::CreateRtcSourceTrack()
@@ -46,6 +48,61 @@ void AudioCapturerBase::CreateRtcSourceTrack()
 
 	RtcAudioSource = peerConnectionFactory->CreateAudioSource(options);
 	RtcAudioTrack  = peerConnectionFactory->CreateAudioTrack(to_string(TrackId.Get("audio")), RtcAudioSource);
+
+	// With the channels sent to webrtc
+	AudioLane = FWebRTCPeerConnection::GetAudioDeviceModule()->AddInputLane();
+	AudioLane->SetGain(MixGain);
+	AudioLane->SetMuted(bMixMuted);
+}
+
+void AudioCapturerBase::ReleaseRtcSourceTrack()
+{
+	RtcAudioTrack = nullptr;
+	RtcAudioSource = nullptr;
+
+	// The lane isn't destroyed, a capture callback still running only has its audio dropped
+	if (AudioLane)
+	{
+		FWebRTCPeerConnection::GetAudioDeviceModule()->RemoveInputLane(AudioLane);
+	}
+}
+
+void AudioCapturerBase::PushAudio(const float* AudioData, int32 NumSamples, int32 NumChannels, int32 SampleRate)
+{
+	if (!AudioLane)
+	{
+		return;
+	}
+
+	AudioLane->Push(AudioData, NumSamples, NumChannels, SampleRate);
+
+	if (AudioLane->HasBlock())
+	{
+		FWebRTCPeerConnection::GetAudioDeviceModule()->OnInputLaneReady();
+	}
+}
+
+void AudioCapturerBase::SetMixGain(float Gain)
+{
+	MixGain = Gain;
+	if (AudioLane)
+	{
+		AudioLane->SetGain(Gain);
+	}
+}
+
+void AudioCapturerBase::SetMixMuted(bool bMuted)
+{
+	bMixMuted = bMuted;
+	if (AudioLane)
+	{
+		AudioLane->SetMuted(bMuted);
+	}
+}
+
+FAudioInputLane::FStats AudioCapturerBase::GetAudioStats() const
+{
+	return AudioLane ? AudioLane->GetStats() : FAudioInputLane::FStats();
 }
 
 IMillicastSource::FStreamTrackInterface AudioCapturerBase::GetTrack()
@@ -105,10 +162,11 @@ IMillicastSource::FStreamTrackInterface AudioGameCapturer::StartCapture()
 	
 	if (AudioDevice == nullptr) return nullptr;
 
-	AudioDevice->RegisterSubmixBufferListener(this, Submix);
-
+	// The lane must exist before the first submix buffer
 	CreateRtcSourceTrack();
 
+	AudioDevice->RegisterSubmixBufferListener(this, Submix);
+
 	return RtcAudioTrack;
 }
 
@@ -116,10 +174,9 @@ void AudioGameCapturer::StopCapture()
 {
 	if(RtcAudioTrack) 
 	{
-		RtcAudioTrack = nullptr;
-		RtcAudioSource = nullptr;
-
 		AudioDevice->UnregisterSubmixBufferListener(this, Submix);
+
+		ReleaseRtcSourceTrack();
 	}
 }
 
@@ -143,11 +200,10 @@ void AudioGameCapturer::SetAudioDeviceId(Audio::FDeviceId Id)
 
 void AudioGameCapturer::OnNewSubmixBuffer(const USoundSubmix* OwningSubmix, float* AudioData, int32 NumSamples, int32 NumChannels, const int32 SampleRate, double AudioClock)
 {
-	auto Adm = FWebRTCPeerConnection::GetAudioDeviceModule();
-	Adm->SendAudioData(AudioData, NumSamples, NumChannels, SampleRate);
+	PushAudio(AudioData, NumSamples, NumChannels, SampleRate);
 }
 
-AudioDeviceCapture::AudioDeviceCapture() noexcept : VolumeMultiplier(0.f)
+AudioDeviceCapture::AudioDeviceCapture() noexcept : TargetGain(1.f), CurrentGain(1.f)
 {}
 
 AudioDeviceCapture::FStreamTrackInterface AudioDeviceCapture::StartCapture()
@@ -156,26 +212,19 @@ AudioDeviceCapture::FStreamTrackInterface AudioDeviceCapture::StartCapture()
 
 	Audio::FOnCaptureFunction OnCapture = [this](const float* AudioData, int32 NumFrames, int32 NumChannels, int32 SampleRate, double StreamTime, bool bOverFlow)
 	{
-		int32 NumSamples = NumFrames * NumChannels;
-
-		float* MutableAudioData = new float[NumSamples];
-
-		for (int i = 0; i < NumSamples; ++i) {
-			const float factor = pow(10.0f, VolumeMultiplier / 20.f);
-			MutableAudioData[i] = FMath::Clamp(AudioData[i] * factor, -1.f, 1.f);
-		}
-
-		auto Adm = FWebRTCPeerConnection::GetAudioDeviceModule();
-		Adm->SendAudioData(MutableAudioData, NumSamples, NumChannels, SampleRate);
-
-		delete[] MutableAudioData;
+		OnAudioCaptured(AudioData, NumFrames, NumChannels, SampleRate);
 	};
 
 	Audio::FAudioCaptureDeviceParams Params = Audio::FAudioCaptureDeviceParams();
 	Params.DeviceIndex = DeviceIndex;
 
+	// Room for the usual device buffers, so the capture callback doesn't allocate
+	constexpr int32 NumFramesDesired = 1024;
+	GainBuffer.Reserve(NumFramesDesired * 8);
+	CurrentGain = TargetGain;
+
 	// Start the stream here to avoid hitching the audio render thread. 
-	if (AudioCapture.OpenCaptureStream(Params, MoveTemp(OnCapture), 1024))
+	if (AudioCapture.OpenCaptureStream(Params, MoveTemp(OnCapture), NumFramesDesired))
 	{
 		UE_LOG(LogMillicastPublisher, Log, TEXT("Starting audio capture"));
 		AudioCapture.StartStream();
@@ -192,12 +241,25 @@ void AudioDeviceCapture::StopCapture()
 {
 	if (RtcAudioTrack)
 	{
-		RtcAudioSource = nullptr;
-		RtcAudioTrack  = nullptr;
 		AudioCapture.StopStream();
+		ReleaseRtcSourceTrack();
 	}
 }
 
+void AudioDeviceCapture::OnAudioCaptured(const float* AudioData, int32 NumFrames, int32 NumChannels, int32 SampleRate)
+{
+	const int32 NumSamples = NumFrames * NumChannels;
+
+	// Only grows for bigger buffers than any before
+	GainBuffer.SetNumUninitialized(NumSamples, false);
+
+	const float Gain = TargetGain;
+	AudioDownmix::ApplyGain(AudioData, NumFrames, NumChannels, CurrentGain, Gain, GainBuffer.GetData());
+	CurrentGain = Gain;
+
+	PushAudio(GainBuffer.GetData(), NumSamples, NumChannels, SampleRate);
+}
+
 void AudioDeviceCapture::SetAudioCaptureDevice(int32 InDeviceIndex)
 {
 	DeviceIndex = InDeviceIndex;
@@ -879,6 +941,9 @@ WasapiDeviceCapture::FStreamTrackInterface WasapiDeviceCapture::StartCapture()
 
 	LogicalEP lep = numChans_ == 2 ? LogicalEP::InputMusic : LogicalEP::InputVoice;
 
+	// The lane must exist before the stream ticks
+	CreateRtcSourceTrack();
+
 	auto period = UINT(Tmin / 10000);
 	BOOL success = CreateTimerQueueTimer(&sWcore.timer_, NULL, (WAITORTIMERCALLBACK)coreCallback, this, period / 2, period / 2, NULL);
 
@@ -891,8 +956,6 @@ WasapiDeviceCapture::FStreamTrackInterface WasapiDeviceCapture::StartCapture()
 		UE_LOG(LogMillicastPublisher, Log, TEXT("AudioDriver::StartStream( %S ): SUCCESS"), numChans_ == 2 ? "music input" : "voice input");
 	}
 
-	CreateRtcSourceTrack();
-
 	return RtcAudioTrack;
 }
 
@@ -918,8 +981,7 @@ void WasapiDeviceCapture::StopCapture()
 		client_->Stop();
 	}
 
-	RtcAudioTrack = nullptr;
-	RtcAudioSource = nullptr;
+	ReleaseRtcSourceTrack();
 	// we keep ticking the stream until it is released in the callback but tick will do nothing
 }
 
@@ -1007,12 +1069,12 @@ void WasapiDeviceCapture::SendAudioData(const float* pinf, size_t numFramesAvail
 
 		if (results.OutputFramesGenerated > 0)
 		{
-			adm->SendAudioData(results.OutBuffer->GetData(), results.OutputFramesGenerated * numCaptureChannels, numCaptureChannels, kOpusSampleRate);
+			PushAudio(results.OutBuffer->GetData(), results.OutputFramesGenerated * numCaptureChannels, numCaptureChannels, kOpusSampleRate);
 		}
 	}
 	else
 	{
-		adm->SendAudioData(pinf, numFramesAvailable * numCaptureChannels, numCaptureChannels, kOpusSampleRate);
+		PushAudio(pinf, numFramesAvailable * numCaptureChannels, numCaptureChannels, kOpusSampleRate);
 	}
 }
 
@@ -2,6 +2,7 @@
 #pragma once
 
 #include "IMillicastSource.h"
+#include "WebRTC/AudioInputLane.h"
 
 #include <AudioCaptureCore.h>
 #include <AudioResampler.h>
@@ -12,10 +13,32 @@ protected:
 	rtc::scoped_refptr<webrtc::AudioSourceInterface> RtcAudioSource;
 	FStreamTrackInterface                            RtcAudioTrack;
 
+	/**
+	* Audio of this source in the audio device module mix. Created with the track, before the capture starts,
+	* and kept for the lifetime of the capturer
+	*/
+	TSharedPtr<FAudioInputLane, ESPMode::ThreadSafe> AudioLane;
+	float MixGain;
+	bool bMixMuted;
+
+	/** Create the audio source and track, and add the lane of this source to the audio device module mix */
 	void CreateRtcSourceTrack();
+
+	/** Release the audio source and track, and remove the lane from the mix */
+	void ReleaseRtcSourceTrack();
+
+	/** Queue captured audio to the lane of this source. Must always be called from the same thread */
+	void PushAudio(const float* AudioData, int32 NumSamples, int32 NumChannels, int32 SampleRate);
 public:
 	AudioCapturerBase() noexcept;
 	FStreamTrackInterface GetTrack() override;
+
+	/** Linear gain of this source in the mix, and whether it's heard in it */
+	void SetMixGain(float Gain);
+	void SetMixMuted(bool bMuted);
+
+	/** Get the counters of the audio buffered for this source */
+	FAudioInputLane::FStats GetAudioStats() const;
 };
 
 /** Class to capturer audio from the main audio device */
@@ -52,7 +75,15 @@ class AudioDeviceCapture : public AudioCapturerBase
 	int32                     DeviceIndex;
 	Audio::FAudioCapture      AudioCapture;
 
-	float VolumeMultiplier; // dB
+	/** Linear gain set from the volume multiplier, and the gain applied to the last captured buffer */
+	std::atomic<float> TargetGain;
+	float CurrentGain;
+
+	/** Captured audio with the gain applied, reused by every capture callback */
+	TArray<float> GainBuffer;
+
+	/** Apply the gain to the captured audio and queue it. Called on the capture thread */
+	void OnAudioCaptured(const float* AudioData, int32 NumFrames, int32 NumChannels, int32 SampleRate);
 
 public:
 	AudioDeviceCapture() noexcept;
@@ -76,7 +107,8 @@ public:
 	*/
 	void SetAudioCaptureDeviceByName(FStringView name);
 
-	void SetVolumeMultiplier(float f) noexcept { VolumeMultiplier = f;  }
+	/** Set the volume multiplier in dB. The gain ramps to its new value over the next captured buffer */
+	void SetVolumeMultiplier(float f) noexcept { TargetGain = FMath::Pow(10.f, f / 20.f); }
 
 	static TArray<Audio::FCaptureDeviceInfo>& GetCaptureDevicesAvailable();
 };
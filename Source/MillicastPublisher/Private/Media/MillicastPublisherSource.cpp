@@ -4,9 +4,21 @@
 #include "MillicastPublisherPrivate.h"
 #include "RenderTargetCapturer.h"
 #include "AudioGameCapturer.h"
+#include "WebRTC/PeerConnection.h"
 
 #include <RenderTargetPool.h>
 
+static int32 GetNumChannels(AudioChannelLayout Layout)
+{
+	switch (Layout)
+	{
+	case AudioChannelLayout::AUDIO_MONO: return 1;
+	case AudioChannelLayout::AUDIO_5_1: return 6;
+	case AudioChannelLayout::AUDIO_7_1: return 8;
+	default: return 2;
+	}
+}
+
 UMillicastPublisherSource::UMillicastPublisherSource() : VideoSource(nullptr), AudioSource(nullptr)
 {
 	// Add default StreamUrl
@@ -123,6 +135,51 @@ void UMillicastPublisherSource::SetVolumeMultiplier(float f)
 	}
 }
 
+void UMillicastPublisherSource::SetMixGain(float Gain)
+{
+	MixGain = FMath::Max(Gain, 0.f);
+	if (AudioSource)
+	{
+		static_cast<AudioCapturerBase*>(AudioSource.Get())->SetMixGain(MixGain);
+	}
+}
+
+void UMillicastPublisherSource::SetMixMuted(bool Muted)
+{
+	MixMuted = Muted;
+	if (AudioSource)
+	{
+		static_cast<AudioCapturerBase*>(AudioSource.Get())->SetMixMuted(MixMuted);
+	}
+}
+
+FMillicastAudioCaptureStats UMillicastPublisherSource::GetAudioCaptureStats() const
+{
+	FMillicastAudioCaptureStats Stats;
+	if (AudioSource)
+	{
+		const auto BufferStats = static_cast<AudioCapturerBase*>(AudioSource.Get())->GetAudioStats();
+
+		Stats.BufferedMs = BufferStats.BufferedMs;
+		Stats.Overruns = BufferStats.Overruns;
+		Stats.Underruns = BufferStats.Underruns;
+		Stats.DriftPpm = BufferStats.DriftPpm;
+		Stats.Sheds = BufferStats.Sheds;
+		Stats.ShedMs = BufferStats.ShedMs;
+
+		for (uint32 Count : BufferStats.BufferedMsHistogram)
+		{
+			Stats.BufferedMsHistogram.Add(Count);
+		}
+
+		const auto DeliveryStats = FWebRTCPeerConnection::GetAudioDeviceModule()->GetDeliveryStats();
+		Stats.DeliveryJitterMs = DeliveryStats.JitterMs;
+		Stats.MaxDeliveryJitterMs = DeliveryStats.MaxJitterMs;
+		Stats.MaxBlocksPerDelivery = DeliveryStats.MaxBlocksPerWake;
+	}
+	return Stats;
+}
+
 FString UMillicastPublisherSource::GetMediaOption(const FName& Key, const FString& DefaultValue) const
 {
 	if (Key == MillicastPublisherOption::StreamName)
@@ -178,6 +235,13 @@ void UMillicastPublisherSource::StartCapture(TFunction<void(IMillicastSource::FS
 			VideoSource = TUniquePtr<IMillicastVideoSource>(IMillicastVideoSource::Create());
 		}
 
+		if (VideoSource)
+		{
+			auto* src = static_cast<VideoCapturerBase*>(VideoSource.Get());
+			src->SetCaptureFramerate(CaptureFramerate);
+			src->SetStaticFrameDetection(SkipStaticFrames, StaticFrameRefreshRate);
+		}
+
 		// Starts the capture and notify observers
 		if (VideoSource && Callback)
 		{
@@ -187,6 +251,9 @@ void UMillicastPublisherSource::StartCapture(TFunction<void(IMillicastSource::FS
 	// If audio is enabled, create audio capturer
 	if (CaptureAudio)
 	{
+		// Set before the capturer creates its lane in the audio device module
+		FWebRTCPeerConnection::GetAudioDeviceModule()->SetNumChannels(GetNumChannels(AudioChannels));
+
 		AudioSource = TUniquePtr<IMillicastAudioSource>(IMillicastAudioSource::Create(AudioCaptureType));
 
 		if (AudioCaptureType == AudioCapturerType::DEVICE)
@@ -201,6 +268,13 @@ void UMillicastPublisherSource::StartCapture(TFunction<void(IMillicastSource::FS
 			source->SetAudioSubmix(Submix);
 		}
 
+		if (AudioSource)
+		{
+			auto* src = static_cast<AudioCapturerBase*>(AudioSource.Get());
+			src->SetMixGain(MixGain);
+			src->SetMixMuted(MixMuted);
+		}
+
 		// Start the capture and notify observers
 		if (AudioSource && Callback)
 		{
@@ -238,17 +312,78 @@ void UMillicastPublisherSource::ChangeRenderTarget(UTextureRenderTarget2D* InRen
 	}
 }
 
+void UMillicastPublisherSource::SetCaptureFramerate(int32 Framerate)
+{
+	CaptureFramerate = FMath::Max(Framerate, 0);
+	if (VideoSource)
+	{
+		auto* src = static_cast<VideoCapturerBase*>(VideoSource.Get());
+		src->SetCaptureFramerate(CaptureFramerate);
+	}
+}
+
+void UMillicastPublisherSource::SetSkipStaticFrames(bool Enabled, float RefreshRate)
+{
+	SkipStaticFrames = Enabled;
+	StaticFrameRefreshRate = FMath::Max(RefreshRate, 0.f);
+	if (VideoSource)
+	{
+		auto* src = static_cast<VideoCapturerBase*>(VideoSource.Get());
+		src->SetStaticFrameDetection(SkipStaticFrames, StaticFrameRefreshRate);
+	}
+}
+
+FMillicastVideoCaptureStats UMillicastPublisherSource::GetVideoCaptureStats() const
+{
+	FMillicastVideoCaptureStats Stats;
+	if (VideoSource)
+	{
+		auto* src = static_cast<VideoCapturerBase*>(VideoSource.Get());
+		const auto CaptureStats = src->GetCaptureStats();
+
+		Stats.FramesCaptured = CaptureStats.FramesCaptured;
+		Stats.FramesSkipped = CaptureStats.FramesSkipped;
+		Stats.FramesDropped = CaptureStats.FramesDropped;
+		Stats.FramesStatic = CaptureStats.FramesStatic;
+		Stats.QueueDepth = CaptureStats.Queue.QueueDepth;
+		Stats.QueueFramesDropped = CaptureStats.Queue.FramesDropped;
+		Stats.QueueAverageWaitUs = CaptureStats.Queue.AverageWaitUs;
+		Stats.QueueMaxWaitUs = CaptureStats.Queue.MaxWaitUs;
+		Stats.BufferPoolHits = CaptureStats.BufferPool.Hits;
+		Stats.BufferPoolMisses = CaptureStats.BufferPool.Misses;
+		Stats.BufferPoolResidentBytes = CaptureStats.BufferPool.ResidentBytes;
+		Stats.ReadbackPoolResidentBytes = CaptureStats.ReadbackPool.ResidentBytes;
+	}
+	return Stats;
+}
+
 #if WITH_EDITOR
 bool UMillicastPublisherSource::CanEditChange(const FProperty* InProperty) const
 {
 	FString Name;
 	InProperty->GetName(Name);
 
-	// Can't change render target if Capture video is disabled
-	if (Name == MillicastPublisherOption::RenderTarget.ToString())
+	// Can't change render target or capture framerate if Capture video is disabled
+	if (Name == MillicastPublisherOption::RenderTarget.ToString() ||
+		Name == MillicastPublisherOption::CaptureFramerate.ToString() ||
+		Name == MillicastPublisherOption::SkipStaticFrames.ToString() ||
+		Name == MillicastPublisherOption::PreferredVideoCodecs.ToString() ||
+		Name == MillicastPublisherOption::SimulcastLayers.ToString() ||
+		Name == MillicastPublisherOption::VideoStartBitrate.ToString() ||
+		Name == MillicastPublisherOption::VideoMinBitrate.ToString() ||
+		Name == MillicastPublisherOption::VideoMaxBitrate.ToString())
 	{
 		return CaptureVideo;
 	}
+	// Not combined with simulcast
+	if (Name == MillicastPublisherOption::ScalabilityMode.ToString())
+	{
+		return CaptureVideo && SimulcastLayers.Num() <= 1;
+	}
+	if (Name == MillicastPublisherOption::StaticFrameRefreshRate.ToString())
+	{
+		return CaptureVideo && SkipStaticFrames;
+	}
 
 	if (Name == MillicastPublisherOption::CaptureDeviceIndex.ToString())
 	{
@@ -258,7 +393,15 @@ bool UMillicastPublisherSource::CanEditChange(const FProperty* InProperty) const
 	{
 		return CaptureAudio && AudioCaptureType == AudioCapturerType::SUBMIX;
 	}
-	if (Name == MillicastPublisherOption::AudioCaptureType.ToString())
+	if (Name == MillicastPublisherOption::AudioCaptureType.ToString() ||
+		Name == MillicastPublisherOption::AudioChannels.ToString() ||
+		Name == MillicastPublisherOption::AudioBitrate.ToString() ||
+		Name == MillicastPublisherOption::AudioPacketTime.ToString() ||
+		Name == MillicastPublisherOption::AudioDtx.ToString() ||
+		Name == MillicastPublisherOption::AudioFec.ToString() ||
+		Name == MillicastPublisherOption::AudioCbr.ToString() ||
+		Name == MillicastPublisherOption::MixGain.ToString() ||
+		Name == MillicastPublisherOption::MixMuted.ToString())
 	{
 		return CaptureAudio;
 	}
@@ -1,9 +1,7 @@
 #include "RenderTargetCapturer.h"
 #include "MillicastPublisherPrivate.h"
-#include "WebRTC/PeerConnection.h"
 
 #include "Engine/TextureRenderTarget2D.h"
-#include "Util.h"
 
 IMillicastVideoSource* IMillicastVideoSource::Create(UTextureRenderTarget2D* RenderTarget)
 {
@@ -34,22 +32,8 @@ RenderTargetCapturer::FStreamTrackInterface RenderTargetCapturer::StartCapture()
 		return nullptr;
 	}
 
-	// Create WebRTC Video source
-	RtcVideoSource = new rtc::RefCountedObject<FTexture2DVideoSourceAdapter>();
-
-	// Get PCF to create video track
-	auto PeerConnectionFactory = FWebRTCPeerConnection::GetPeerConnectionFactory();
-
-	RtcVideoTrack = PeerConnectionFactory->CreateVideoTrack(to_string(TrackId.Get("render-target-track")), RtcVideoSource);
-
-	if (RtcVideoTrack)
-	{
-		UE_LOG(LogMillicastPublisher, Log, TEXT("Created video track"));
-	}
-	else
-	{
-		UE_LOG(LogMillicastPublisher, Warning, TEXT("Could not create video track"));
-	}
+	// Create WebRTC video source and video track
+	CreateRtcSourceTrack("render-target-track");
 
 	// Attach a callback to be notified when a new frame is ready
 	FCoreDelegates::OnEndFrameRT.AddRaw(this, &RenderTargetCapturer::OnEndFrameRenderThread);
@@ -68,11 +52,6 @@ void RenderTargetCapturer::StopCapture()
 	FCoreDelegates::OnEndFrameRT.RemoveAll(this);
 }
 
-RenderTargetCapturer::FStreamTrackInterface RenderTargetCapturer::GetTrack()
-{
-	return RtcVideoTrack;
-}
-
 void RenderTargetCapturer::SwitchTarget(UTextureRenderTarget2D* InRenderTarget)
 {
 	FScopeLock Lock(&CriticalSection);
@@ -2,16 +2,13 @@
 
 #pragma once
 
-#include "IMillicastSource.h"
-#include "WebRTC/Texture2DVideoSourceAdapter.h"
+#include "VideoCapturerBase.h"
 
 
 /** Video source capturer to capture video frame from a RenderTarget2D */
-class RenderTargetCapturer : public IMillicastVideoSource
+class RenderTargetCapturer : public VideoCapturerBase
 {
 	UTextureRenderTarget2D* RenderTarget;
-	FVideoTrackInterface RtcVideoTrack;
-	rtc::scoped_refptr<FTexture2DVideoSourceAdapter> RtcVideoSource;
 
 	FCriticalSection CriticalSection;
 
@@ -22,8 +19,6 @@ public:
 	FStreamTrackInterface StartCapture() override;
 	void StopCapture() override;
 
-	FStreamTrackInterface GetTrack() override;
-
 	/** Switch render target object while capturing */
 	void SwitchTarget(UTextureRenderTarget2D* InRenderTarget);
 
@@ -2,11 +2,8 @@
 
 #include "Framework/Application/SlateApplication.h"
 
-#include "WebRTC/PeerConnection.h"
 #include "MillicastPublisherPrivate.h"
 
-#include "Util.h"
-
 // Maybe return a TUniquePtr or Shared or somehting less ... raw
 IMillicastVideoSource* IMillicastVideoSource::Create()
 {
@@ -15,28 +12,13 @@ IMillicastVideoSource* IMillicastVideoSource::Create()
 
 IMillicastSource::FStreamTrackInterface SlateWindowVideoCapturer::StartCapture()
 {
-	// Create WebRTC video source
-	RtcVideoSource = new rtc::RefCountedObject<FTexture2DVideoSourceAdapter>();
+	// Create WebRTC video source and video track
+	CreateRtcSourceTrack("slate-window-track");
 
 	// Attach the callback to the Slate window renderer
 	FSlateApplication::Get().GetRenderer()->OnBackBufferReadyToPresent().AddRaw(this, 
 		&SlateWindowVideoCapturer::OnBackBufferReadyToPresent);
 
-	// Get the peerconnection factory to create the video track
-	auto PeerConnectionFactory = FWebRTCPeerConnection::GetPeerConnectionFactory();
-
-	RtcVideoTrack = PeerConnectionFactory->CreateVideoTrack(to_string(TrackId.Get("slate-window-track")), RtcVideoSource);
-
-	// Check
-	if (RtcVideoTrack) 
-	{
-		UE_LOG(LogMillicastPublisher, Log, TEXT("Created video track"));
-	}
-	else
-	{
-		UE_LOG(LogMillicastPublisher, Warning, TEXT("Could not create video track"));
-	}
-
 	return RtcVideoTrack;
 }
 
@@ -52,11 +34,6 @@ void SlateWindowVideoCapturer::StopCapture()
 	RtcVideoTrack = nullptr;
 }
 
-SlateWindowVideoCapturer::FStreamTrackInterface SlateWindowVideoCapturer::GetTrack()
-{
-	return RtcVideoTrack;
-}
-
 void SlateWindowVideoCapturer::OnBackBufferReadyToPresent(SWindow& SlateWindow, const FTexture2DRHIRef& Buffer)
 {
 	FScopeLock lock(&CriticalSection);
@@ -65,7 +42,7 @@ void SlateWindowVideoCapturer::OnBackBufferReadyToPresent(SWindow& SlateWindow,
 	{
 		check(IsInRenderingThread());
 
-		// Create and send webrtc video frame
+		// Read back the back buffer through the same pipeline as render targets and send webrtc video frame
 		RtcVideoSource->OnFrameReady(Buffer, true);
 	}
 }
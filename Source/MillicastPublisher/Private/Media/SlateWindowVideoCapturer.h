@@ -2,24 +2,20 @@
 
 #pragma once
 
-#include "IMillicastSource.h"
-#include "WebRTC/Texture2DVideoSourceAdapter.h"
+#include "VideoCapturerBase.h"
 
 /**
 * This class is a video source capturer and captures video from the Slate Window renderer
 */
-class SlateWindowVideoCapturer : public IMillicastVideoSource
+class SlateWindowVideoCapturer : public VideoCapturerBase
 {
-	rtc::scoped_refptr<FTexture2DVideoSourceAdapter> RtcVideoSource;
-	FVideoTrackInterface RtcVideoTrack;
 	FCriticalSection CriticalSection;
 
 public:
-	SlateWindowVideoCapturer() noexcept : RtcVideoSource(nullptr), RtcVideoTrack(nullptr) {}
+	SlateWindowVideoCapturer() noexcept = default;
 
 	FStreamTrackInterface StartCapture() override;
 	void StopCapture() override;
-	FStreamTrackInterface GetTrack() override;
 
 private:
 	/** Callback from the SlateWindowRenderer when a new frame buffer is ready */
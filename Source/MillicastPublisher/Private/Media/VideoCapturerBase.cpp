@@ -0,0 +1,65 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "VideoCapturerBase.h"
+
+#include "MillicastPublisherPrivate.h"
+#include "WebRTC/PeerConnection.h"
+
+#include "Util.h"
+
+VideoCapturerBase::VideoCapturerBase() noexcept : RtcVideoSource(nullptr), RtcVideoTrack(nullptr), CaptureFramerate(0),
+	bSkipStaticFrames(false), StaticFrameRefreshRate(0.f)
+{}
+
+void VideoCapturerBase::CreateRtcSourceTrack(const FString& DefaultTrackId)
+{
+	// Create WebRTC Video source
+	RtcVideoSource = new rtc::RefCountedObject<FTexture2DVideoSourceAdapter>();
+	RtcVideoSource->SetCaptureFramerate(CaptureFramerate);
+	RtcVideoSource->SetStaticFrameDetection(bSkipStaticFrames, StaticFrameRefreshRate);
+
+	// Get PCF to create video track
+	auto PeerConnectionFactory = FWebRTCPeerConnection::GetPeerConnectionFactory();
+
+	RtcVideoTrack = PeerConnectionFactory->CreateVideoTrack(to_string(TrackId.Get(DefaultTrackId)), RtcVideoSource);
+
+	if (RtcVideoTrack)
+	{
+		UE_LOG(LogMillicastPublisher, Log, TEXT("Created video track"));
+	}
+	else
+	{
+		UE_LOG(LogMillicastPublisher, Warning, TEXT("Could not create video track"));
+	}
+}
+
+IMillicastSource::FStreamTrackInterface VideoCapturerBase::GetTrack()
+{
+	return RtcVideoTrack;
+}
+
+void VideoCapturerBase::SetCaptureFramerate(int32 Framerate)
+{
+	CaptureFramerate = Framerate;
+
+	if (RtcVideoSource)
+	{
+		RtcVideoSource->SetCaptureFramerate(Framerate);
+	}
+}
+
+void VideoCapturerBase::SetStaticFrameDetection(bool bEnabled, float RefreshRate)
+{
+	bSkipStaticFrames = bEnabled;
+	StaticFrameRefreshRate = RefreshRate;
+
+	if (RtcVideoSource)
+	{
+		RtcVideoSource->SetStaticFrameDetection(bEnabled, RefreshRate);
+	}
+}
+
+FTexture2DVideoSourceAdapter::FStats VideoCapturerBase::GetCaptureStats() const
+{
+	return RtcVideoSource ? RtcVideoSource->GetStats() : FTexture2DVideoSourceAdapter::FStats();
+}
@@ -0,0 +1,35 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#pragma once
+
+#include "IMillicastSource.h"
+#include "WebRTC/Texture2DVideoSourceAdapter.h"
+
+/** Common part of the video capturers, pushing textures to webrtc through a FTexture2DVideoSourceAdapter */
+class VideoCapturerBase : public IMillicastVideoSource
+{
+protected:
+	rtc::scoped_refptr<FTexture2DVideoSourceAdapter> RtcVideoSource;
+	FVideoTrackInterface                             RtcVideoTrack;
+
+	int32 CaptureFramerate;
+	bool bSkipStaticFrames;
+	float StaticFrameRefreshRate;
+
+	/** Create the video source and the video track, named after TrackId or the default name */
+	void CreateRtcSourceTrack(const FString& DefaultTrackId);
+
+public:
+	VideoCapturerBase() noexcept;
+
+	FStreamTrackInterface GetTrack() override;
+
+	/** Set the maximum number of frames captured per second, 0 to capture every engine frame */
+	void SetCaptureFramerate(int32 Framerate);
+
+	/** Skip the frames identical to the previous one, still publishing RefreshRate of them per second */
+	void SetStaticFrameDetection(bool bEnabled, float RefreshRate);
+
+	/** Get the capture counters. They are reset when the capture starts */
+	FTexture2DVideoSourceAdapter::FStats GetCaptureStats() const;
+};
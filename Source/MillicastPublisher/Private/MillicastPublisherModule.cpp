@@ -8,6 +8,7 @@
 #include "Modules/ModuleManager.h"
 #include "Styling/SlateStyle.h"
 #include "Media/AudioGameCapturer.h"
+#include "MillicastPublisherSource.h"
 
 DEFINE_LOG_CATEGORY(LogMillicastPublisher);
 
@@ -34,6 +35,14 @@ public:
 		WasapiDeviceCapture::ColdInit();
 #endif
 		CreateStyle();
+
+#if WITH_EDITOR && WEBRTC_VERSION < 96
+		// webrtc can't encode scalable streams before 96, hide the setting rather than ignore it
+		if (FProperty* Property = FindFProperty<FProperty>(UMillicastPublisherSource::StaticClass(), MillicastPublisherOption::ScalabilityMode))
+		{
+			Property->ClearPropertyFlags(CPF_Edit);
+		}
+#endif
 	}
 
 	virtual void ShutdownModule() override 
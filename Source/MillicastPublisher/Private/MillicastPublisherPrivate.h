@@ -13,8 +13,25 @@ namespace MillicastPublisherOption
 	static const FName CaptureAudio("CaptureAudio");
 	static const FName CaptureVideo("CaptureVideo");
 	static const FName RenderTarget("RenderTarget");
+	static const FName CaptureFramerate("CaptureFramerate");
+	static const FName SkipStaticFrames("SkipStaticFrames");
+	static const FName StaticFrameRefreshRate("StaticFrameRefreshRate");
+	static const FName PreferredVideoCodecs("PreferredVideoCodecs");
+	static const FName SimulcastLayers("SimulcastLayers");
+	static const FName ScalabilityMode("ScalabilityMode");
+	static const FName VideoStartBitrate("VideoStartBitrate");
+	static const FName VideoMinBitrate("VideoMinBitrate");
+	static const FName VideoMaxBitrate("VideoMaxBitrate");
 	static const FName Submix("Submix");
 	static const FName CaptureDeviceIndex("CaptureDeviceIndex");
 	static const FName AudioCaptureType("AudioCaptureType");
+	static const FName AudioChannels("AudioChannels");
+	static const FName AudioBitrate("AudioBitrate");
+	static const FName AudioPacketTime("AudioPacketTime");
+	static const FName AudioDtx("AudioDtx");
+	static const FName AudioFec("AudioFec");
+	static const FName AudioCbr("AudioCbr");
 	static const FName VolumeMultiplier("VolumeMultiplier");
+	static const FName MixGain("MixGain");
+	static const FName MixMuted("MixMuted");
 }
@@ -0,0 +1,128 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "WebRTC/AudioDownmix.h"
+
+#include "Math/RandomStream.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastAudioDownmixTest, "Millicast.Publisher.AudioDownmix.SimdMatchesScalar",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMillicastAudioDownmixTest::RunTest(const FString& Parameters)
+{
+	// Not a multiple of the 4 frames of the vector kernels, so the scalar tail runs too
+	constexpr int32 NumFrames = 483;
+	const int32 ChannelCounts[] = { 1, 2, 6, 8 };
+
+	// Out of range values, which have to saturate the same way in every kernel
+	const float OutOfRange[] = { 1.f, -1.f, 1.5f, -1.5f, 1e6f, -1e6f, 1e30f, -1e30f, 0.99999f, -0.99999f };
+
+	FRandomStream Random(42);
+
+	for (int32 NumChannels : ChannelCounts)
+	{
+		TArray<float> In;
+		In.SetNumUninitialized(NumFrames * NumChannels);
+		for (int32 Index = 0; Index < In.Num(); ++Index)
+		{
+			// One frame in four has an out of range sample
+			const bool bOutOfRange = (Index / NumChannels) % 4 == 1 && Index % NumChannels == (Index / NumChannels) % NumChannels;
+			In[Index] = bOutOfRange ? OutOfRange[Index % UE_ARRAY_COUNT(OutOfRange)] : Random.FRandRange(-1.f, 1.f);
+		}
+
+		// Whole buffer, through the SSE2/NEON kernels where the platform has them
+		TArray<int16> Vector;
+		Vector.SetNumUninitialized(2 * NumFrames);
+		AudioDownmix::DownmixToStereoS16(In.GetData(), NumFrames, NumChannels, Vector.GetData());
+
+		// A frame at a time is less than a vector, so every frame goes through the scalar code
+		TArray<int16> Scalar;
+		Scalar.SetNumUninitialized(2 * NumFrames);
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			AudioDownmix::DownmixToStereoS16(In.GetData() + Frame * NumChannels, 1, NumChannels, Scalar.GetData() + 2 * Frame);
+		}
+
+		// The sums of the downmix may be rounded differently when the compiler fuses the scalar multiply and add
+		const int32 Tolerance = NumChannels > 2 ? 1 : 0;
+
+		int32 MaxDifference = 0;
+		int32 FirstMismatch = INDEX_NONE;
+		for (int32 Index = 0; Index < Vector.Num(); ++Index)
+		{
+			const int32 Difference = FMath::Abs(int32(Vector[Index]) - int32(Scalar[Index]));
+			if (Difference > Tolerance && FirstMismatch == INDEX_NONE)
+			{
+				FirstMismatch = Index;
+			}
+			MaxDifference = FMath::Max(MaxDifference, Difference);
+		}
+
+		if (FirstMismatch != INDEX_NONE)
+		{
+			AddError(FString::Printf(TEXT("%d channels: sample %d is %d with SIMD and %d scalar"),
+				NumChannels, FirstMismatch, Vector[FirstMismatch], Scalar[FirstMismatch]));
+		}
+
+		// Full scale values saturate rather than wrap
+		const int16* Samples = Scalar.GetData();
+		for (int32 Frame = 1; Frame < NumFrames; Frame += 4)
+		{
+			const float Value = In[Frame * NumChannels + Frame % NumChannels];
+			if (FMath::Abs(Value) >= 1e6f && (NumChannels <= 2 || Frame % NumChannels < 2))
+			{
+				const int16 Expected = Value > 0.f ? 32767 : -32768;
+				const int32 Sample = 2 * Frame + (NumChannels == 1 ? 0 : Frame % NumChannels);
+				TestEqual(FString::Printf(TEXT("%d channels: frame %d saturates"), NumChannels, Frame), Samples[Sample], Expected);
+			}
+		}
+
+		AddInfo(FString::Printf(TEXT("%d channels: SIMD and scalar differ by at most %d"), NumChannels, MaxDifference));
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastAudioGainRampTest, "Millicast.Publisher.AudioDownmix.GainRamp",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMillicastAudioGainRampTest::RunTest(const FString& Parameters)
+{
+	// Not a multiple of the 4 frames of the vector kernels, so the scalar tail ramps too
+	constexpr int32 NumFrames = 483;
+	const int32 ChannelCounts[] = { 1, 2, 3, 6, 8 };
+
+	for (int32 NumChannels : ChannelCounts)
+	{
+		TArray<float> In;
+		In.Init(0.5f, NumFrames * NumChannels);
+
+		TArray<float> Out;
+		Out.SetNumUninitialized(In.Num());
+		AudioDownmix::ApplyGain(In.GetData(), NumFrames, NumChannels, 0.f, 1.f, Out.GetData());
+
+		int32 FirstMismatch = INDEX_NONE;
+		for (int32 Index = 0; Index < Out.Num() && FirstMismatch == INDEX_NONE; ++Index)
+		{
+			// Every channel of a frame gets the gain of the frame, the last frame the end gain
+			const float Expected = 0.5f * float(Index / NumChannels + 1) / NumFrames;
+			if (!FMath::IsNearlyEqual(Out[Index], Expected, 1e-5f))
+			{
+				FirstMismatch = Index;
+			}
+		}
+
+		if (FirstMismatch != INDEX_NONE)
+		{
+			AddError(FString::Printf(TEXT("%d channels: sample %d of frame %d is %f, %f expected"), NumChannels, FirstMismatch % NumChannels,
+				FirstMismatch / NumChannels, Out[FirstMismatch], 0.5f * float(FirstMismatch / NumChannels + 1) / NumFrames));
+		}
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,161 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "WebRTC/AudioRingBuffer.h"
+#include "WebRTC/AudioDownmix.h"
+
+#include "Async/Async.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastAudioRingBufferStressTest, "Millicast.Publisher.AudioRingBuffer.Stress",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+namespace
+{
+	/** Small enough to wrap around and fill up all the time */
+	constexpr int32 kCapacity = 256;
+	constexpr int32 kNumSamples = 4 * 1024 * 1024;
+	constexpr int32 kMaxBlock = 97;
+}
+
+bool FMillicastAudioRingBufferStressTest::RunTest(const FString& Parameters)
+{
+	TAudioRingBuffer<int32> Ring(kCapacity);
+	TestEqual(TEXT("Capacity"), Ring.Max(), kCapacity);
+
+	// The producer writes an increasing sequence in blocks of varying sizes, and retries a block which doesn't fit
+	TFuture<uint32> Producer = Async(EAsyncExecution::Thread, [&Ring]() {
+		uint32 FailedWrites = 0;
+		int32 Next = 0;
+		int32 Block = 1;
+
+		while (Next < kNumSamples)
+		{
+			const int32 Count = FMath::Min(Block, kNumSamples - Next);
+			const bool bWritten = Ring.Write(Count, [Next](int32* Dest, int32 Offset, int32 SubCount) {
+				for (int32 Index = 0; Index < SubCount; ++Index)
+				{
+					Dest[Index] = Next + Offset + Index;
+				}
+			});
+
+			if (bWritten)
+			{
+				Next += Count;
+				Block = Block % kMaxBlock + 1;
+			}
+			else
+			{
+				++FailedWrites;
+				FPlatformProcess::YieldThread();
+			}
+		}
+		return FailedWrites;
+	});
+
+	// The consumer reads blocks of other sizes, so the reads and writes wrap around at different places
+	uint32 FailedReads = 0;
+	int32 Expected = 0;
+	int32 Block = 1;
+	bool bInOrder = true;
+	TArray<int32> Buffer;
+	Buffer.SetNumUninitialized(kMaxBlock);
+
+	// Read everything even after an error, the producer would wait for room forever otherwise
+	while (Expected < kNumSamples)
+	{
+		const int32 Count = FMath::Min(Block, kNumSamples - Expected);
+		if (!Ring.Pop(Buffer.GetData(), Count))
+		{
+			++FailedReads;
+			FPlatformProcess::YieldThread();
+			continue;
+		}
+
+		for (int32 Index = 0; Index < Count && bInOrder; ++Index)
+		{
+			if (Buffer[Index] != Expected + Index)
+			{
+				AddError(FString::Printf(TEXT("Read %d where %d was expected"), Buffer[Index], Expected + Index));
+				bInOrder = false;
+			}
+		}
+
+		Expected += Count;
+		Block = (Block * 7) % kMaxBlock + 1;
+	}
+
+	const uint32 FailedWrites = Producer.Get();
+
+	TestTrue(TEXT("Samples read in the order they were written"), bInOrder);
+	TestEqual(TEXT("Samples read"), Expected, kNumSamples);
+	TestEqual(TEXT("Samples left"), Ring.Num(), 0);
+	TestEqual(TEXT("Overruns"), Ring.GetOverruns(), FailedWrites);
+	TestEqual(TEXT("Underruns"), Ring.GetUnderruns(), FailedReads);
+
+	AddInfo(FString::Printf(TEXT("%d samples, %u overruns, %u underruns"), kNumSamples, FailedWrites, FailedReads));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastAudioRingBufferFramesTest, "Millicast.Publisher.AudioRingBuffer.FramesAcrossTheWrap",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMillicastAudioRingBufferFramesTest::RunTest(const FString& Parameters)
+{
+	// 5.1, whose frames don't divide a power of two number of samples
+	constexpr int32 NumChannels = 6;
+	constexpr int32 NumFrames = 7;
+
+	TAudioRingBuffer<int16> Ring(64, NumChannels);
+	TestEqual(TEXT("Capacity in whole frames"), Ring.Max() % NumChannels, 0);
+
+	// Every channel has its own level, so a rotation of the channels shows
+	TArray<float> Frames;
+	Frames.SetNumUninitialized(NumFrames * NumChannels);
+	for (int32 Index = 0; Index < Frames.Num(); ++Index)
+	{
+		Frames[Index] = (Index % NumChannels + 1) * 0.1f;
+	}
+
+	TArray<int16> Expected;
+	Expected.SetNumUninitialized(NumChannels);
+	AudioDownmix::RemixS16(Frames.GetData(), 1, NumChannels, NumChannels, Expected.GetData());
+
+	TArray<int16> Read;
+	Read.SetNumUninitialized(NumFrames * NumChannels);
+
+	// Written like the audio input lane does, remixing each region of the write on its own, until it wrapped a few times
+	int32 Wraps = 0;
+	for (int32 Block = 0; Block < 4 * Ring.Max() / (NumFrames * NumChannels) && Wraps < 3; ++Block)
+	{
+		const float* Source = Frames.GetData();
+		const bool bWritten = Ring.Write(NumFrames * NumChannels, [Source, &Wraps](int16* Dest, int32 Offset, int32 Count) {
+			Wraps += Offset > 0 ? 1 : 0;
+			AudioDownmix::RemixS16(Source + Offset / NumChannels * NumChannels, Count / NumChannels, NumChannels, NumChannels, Dest);
+		});
+
+		if (!TestTrue(TEXT("Frames written"), bWritten) || !TestTrue(TEXT("Frames read"), Ring.Pop(Read.GetData(), Read.Num())))
+		{
+			return false;
+		}
+
+		for (int32 Index = 0; Index < Read.Num(); ++Index)
+		{
+			if (Read[Index] != Expected[Index % NumChannels])
+			{
+				AddError(FString::Printf(TEXT("Block %d: channel %d of frame %d is %d, %d expected"),
+					Block, Index % NumChannels, Index / NumChannels, Read[Index], Expected[Index % NumChannels]));
+				return false;
+			}
+		}
+	}
+
+	TestTrue(TEXT("Writes wrapped around the ring"), Wraps > 0);
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
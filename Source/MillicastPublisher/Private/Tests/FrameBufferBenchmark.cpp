@@ -0,0 +1,123 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "WebRTC/Texture2DFrameBuffer.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastFrameBufferBenchmark, "Millicast.Publisher.Benchmark.NV12Delivery",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+namespace
+{
+	/** Average time of Function over NumFrames calls, in milliseconds, after a first call warming up the pools */
+	template<typename FunctionType>
+	double TimePerFrameMs(int32 NumFrames, FunctionType&& Function)
+	{
+		Function();
+
+		const double Start = FPlatformTime::Seconds();
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			Function();
+		}
+		return (FPlatformTime::Seconds() - Start) * 1000.0 / NumFrames;
+	}
+}
+
+bool FMillicastFrameBufferBenchmark::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumFrames = 60;
+	const FIntPoint Resolutions[] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+
+	auto I420Pool = MakeShared<FI420BufferPool, ESPMode::ThreadSafe>();
+	auto NV12Pool = MakeShared<FNV12BufferPool, ESPMode::ThreadSafe>();
+
+	for (const FIntPoint& Resolution : Resolutions)
+	{
+		// Readback of a frame converted to NV12 on the GPU, with a row pitch bigger than the frame like staging textures have
+		const int32 Stride = Align(Resolution.X, 256);
+
+		TArray<uint8> Data;
+		Data.SetNumUninitialized(Stride * Resolution.Y * 3 / 2);
+		for (int32 Index = 0; Index < Data.Num(); ++Index)
+		{
+			Data[Index] = uint8(Index * 7 + Index / Stride);
+		}
+
+		FTextureReadbackRing::FReadbackData ReadbackData;
+		ReadbackData.Data = Data.GetData();
+		ReadbackData.Stride = Stride;
+		ReadbackData.Width = Resolution.X;
+		ReadbackData.Height = Resolution.Y;
+		ReadbackData.SourceRect = FIntRect(FIntPoint::ZeroValue, Resolution);
+		ReadbackData.Format = PF_G8;
+		ReadbackData.Layout = FTextureReadbackRing::ELayout::NV12;
+		ReadbackData.TimestampUs = 0;
+
+		// Converted to I420 by the capture worker, whether the encoder encodes the frame or not
+		const double I420Ms = TimePerFrameMs(NumFrames, [&]() {
+			rtc::scoped_refptr<webrtc::VideoFrameBuffer> Buffer = new rtc::RefCountedObject<FTexture2DFrameBuffer>(ReadbackData, I420Pool);
+			Buffer->ToI420();
+		});
+
+		// Copied by the capture worker, and converted by an encoder taking I420
+		const double NV12ToI420Ms = TimePerFrameMs(NumFrames, [&]() {
+			rtc::scoped_refptr<webrtc::VideoFrameBuffer> Buffer = new rtc::RefCountedObject<FNV12FrameBuffer>(ReadbackData, I420Pool, NV12Pool);
+			Buffer->ToI420();
+		});
+
+		// Copied by the capture worker, and dropped by the encoder
+		const double NV12DroppedMs = TimePerFrameMs(NumFrames, [&]() {
+			rtc::scoped_refptr<webrtc::VideoFrameBuffer> Buffer = new rtc::RefCountedObject<FNV12FrameBuffer>(ReadbackData, I420Pool, NV12Pool);
+		});
+
+		AddInfo(FString::Printf(TEXT("%dx%d: I420 delivery %.3f ms, NV12 delivery to an I420 encoder %.3f ms, NV12 frame dropped %.3f ms"),
+			Resolution.X, Resolution.Y, I420Ms, NV12ToI420Ms, NV12DroppedMs));
+
+#if WEBRTC_VERSION >= 96
+		// Copied by the capture worker, and mapped as is by an encoder taking NV12
+		const double NV12MappedMs = TimePerFrameMs(NumFrames, [&]() {
+			rtc::scoped_refptr<webrtc::VideoFrameBuffer> Buffer = new rtc::RefCountedObject<FNV12FrameBuffer>(ReadbackData, I420Pool, NV12Pool);
+			webrtc::VideoFrameBuffer::Type Types[] = { webrtc::VideoFrameBuffer::Type::kNV12 };
+			Buffer->GetMappedFrameBuffer(Types);
+		});
+
+		// Scaled for a half resolution simulcast layer, then mapped
+		const double NV12ScaledMs = TimePerFrameMs(NumFrames, [&]() {
+			rtc::scoped_refptr<webrtc::VideoFrameBuffer> Buffer = new rtc::RefCountedObject<FNV12FrameBuffer>(ReadbackData, I420Pool, NV12Pool);
+			webrtc::VideoFrameBuffer::Type Types[] = { webrtc::VideoFrameBuffer::Type::kNV12 };
+			Buffer->CropAndScale(0, 0, Resolution.X, Resolution.Y, Resolution.X / 2, Resolution.Y / 2)->GetMappedFrameBuffer(Types);
+		});
+
+		AddInfo(FString::Printf(TEXT("%dx%d: NV12 delivery to an NV12 encoder %.3f ms, with a half resolution layer %.3f ms"),
+			Resolution.X, Resolution.Y, NV12MappedMs, NV12ScaledMs));
+#endif
+
+		// Both paths have to give the encoder the same picture
+		rtc::scoped_refptr<webrtc::VideoFrameBuffer> I420Frame = new rtc::RefCountedObject<FTexture2DFrameBuffer>(ReadbackData, I420Pool);
+		rtc::scoped_refptr<webrtc::VideoFrameBuffer> NV12Frame = new rtc::RefCountedObject<FNV12FrameBuffer>(ReadbackData, I420Pool, NV12Pool);
+		rtc::scoped_refptr<webrtc::I420BufferInterface> Expected = I420Frame->ToI420();
+		rtc::scoped_refptr<webrtc::I420BufferInterface> Actual = NV12Frame->ToI420();
+
+		bool bSame = true;
+		for (int32 Row = 0; Row < Resolution.Y && bSame; ++Row)
+		{
+			bSame = FMemory::Memcmp(Expected->DataY() + Row * Expected->StrideY(), Actual->DataY() + Row * Actual->StrideY(), Resolution.X) == 0;
+		}
+		for (int32 Row = 0; Row < Expected->ChromaHeight() && bSame; ++Row)
+		{
+			bSame = FMemory::Memcmp(Expected->DataU() + Row * Expected->StrideU(), Actual->DataU() + Row * Actual->StrideU(), Expected->ChromaWidth()) == 0
+				&& FMemory::Memcmp(Expected->DataV() + Row * Expected->StrideV(), Actual->DataV() + Row * Actual->StrideV(), Expected->ChromaWidth()) == 0;
+		}
+		TestTrue(FString::Printf(TEXT("%dx%d NV12 frame converts to the same I420 frame"), Resolution.X, Resolution.Y), bSame);
+
+		// Every simulcast layer and sink asking for I420 shares one conversion
+		TestTrue(FString::Printf(TEXT("%dx%d NV12 frame is converted once"), Resolution.X, Resolution.Y), NV12Frame->ToI420() == Actual);
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,103 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "WebRTC/Texture2DFrameBuffer.h"
+
+#include "Async/TaskGraphInterfaces.h"
+#include "HAL/IConsoleManager.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastFrameConversionBenchmark, "Millicast.Publisher.Benchmark.FrameConversion",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FMillicastFrameConversionBenchmark::RunTest(const FString& Parameters)
+{
+	constexpr int32 Width = 3840;
+	constexpr int32 Height = 2160;
+	constexpr int32 NumFrames = 30;
+	const int32 BandCounts[] = { 1, 2, 4, 8, 16 };
+
+	IConsoleVariable* ConversionBands = IConsoleManager::Get().FindConsoleVariable(TEXT("Millicast.Publisher.ConversionBands"));
+	if (!TestNotNull(TEXT("Millicast.Publisher.ConversionBands"), ConversionBands))
+	{
+		return false;
+	}
+
+	// Synthetic BGRA frame read back with a row pitch bigger than the frame, like staging textures have
+	const int32 Stride = Align(Width * 4, 256);
+
+	TArray<uint8> Data;
+	Data.SetNumUninitialized(Stride * Height);
+	for (int32 Index = 0; Index < Data.Num(); ++Index)
+	{
+		Data[Index] = uint8(Index * 13 + Index / Stride);
+	}
+
+	FTextureReadbackRing::FReadbackData ReadbackData;
+	ReadbackData.Data = Data.GetData();
+	ReadbackData.Stride = Stride;
+	ReadbackData.Width = Width;
+	ReadbackData.Height = Height;
+	ReadbackData.SourceRect = FIntRect(0, 0, Width, Height);
+	ReadbackData.Format = PF_B8G8R8A8;
+	ReadbackData.Layout = FTextureReadbackRing::ELayout::Texture;
+	ReadbackData.TimestampUs = 0;
+
+	auto BufferPool = MakeShared<FI420BufferPool, ESPMode::ThreadSafe>();
+
+	const int32 PreviousBands = ConversionBands->GetInt();
+
+	AddInfo(FString::Printf(TEXT("%d task graph workers"), FTaskGraphInterface::Get().GetNumWorkerThreads()));
+
+	rtc::scoped_refptr<webrtc::I420BufferInterface> Reference;
+	double SingleBandMs = 0.0;
+
+	for (int32 NumBands : BandCounts)
+	{
+		ConversionBands->Set(NumBands, ECVF_SetByCode);
+
+		// The first conversion allocates the pooled buffer
+		rtc::scoped_refptr<webrtc::VideoFrameBuffer> Frame = new rtc::RefCountedObject<FTexture2DFrameBuffer>(ReadbackData, BufferPool);
+
+		const double Start = FPlatformTime::Seconds();
+		for (int32 Index = 0; Index < NumFrames; ++Index)
+		{
+			rtc::scoped_refptr<webrtc::VideoFrameBuffer> Converted = new rtc::RefCountedObject<FTexture2DFrameBuffer>(ReadbackData, BufferPool);
+		}
+		const double FrameMs = (FPlatformTime::Seconds() - Start) * 1000.0 / NumFrames;
+
+		if (NumBands == 1)
+		{
+			SingleBandMs = FrameMs;
+			Reference = Frame->ToI420();
+		}
+		else
+		{
+			// The bands must not change the picture
+			rtc::scoped_refptr<webrtc::I420BufferInterface> I420 = Frame->ToI420();
+
+			bool bSame = true;
+			for (int32 Row = 0; Row < Height && bSame; ++Row)
+			{
+				bSame = FMemory::Memcmp(Reference->DataY() + Row * Reference->StrideY(), I420->DataY() + Row * I420->StrideY(), Width) == 0;
+			}
+			for (int32 Row = 0; Row < Reference->ChromaHeight() && bSame; ++Row)
+			{
+				bSame = FMemory::Memcmp(Reference->DataU() + Row * Reference->StrideU(), I420->DataU() + Row * I420->StrideU(), Reference->ChromaWidth()) == 0
+					&& FMemory::Memcmp(Reference->DataV() + Row * Reference->StrideV(), I420->DataV() + Row * I420->StrideV(), Reference->ChromaWidth()) == 0;
+			}
+			TestTrue(FString::Printf(TEXT("%d bands convert to the same frame as 1 band"), NumBands), bSame);
+		}
+
+		AddInfo(FString::Printf(TEXT("%dx%d BGRA to I420 with %d bands: %.3f ms per frame, %.2fx speedup"),
+			Width, Height, NumBands, FrameMs, SingleBandMs / FrameMs));
+	}
+
+	ConversionBands->Set(PreviousBands, ECVF_SetByCode);
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
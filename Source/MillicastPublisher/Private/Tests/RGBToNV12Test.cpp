@@ -0,0 +1,124 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "RGBToNV12Shader.h"
+#include "WebRTC/ReadbackPool.h"
+#include "WebRTC/Texture2DFrameBuffer.h"
+#include "WebRTC/TextureReadbackRing.h"
+
+#include "Math/RandomStream.h"
+#include "Misc/App.h"
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+#include "RenderingThread.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastRGBToNV12Test, "Millicast.Publisher.RGBToNV12",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMillicastRGBToNV12Test::RunTest(const FString& Parameters)
+{
+	constexpr int32 Width = 64;
+	constexpr int32 Height = 48;
+
+	if (!FApp::CanEverRender() || !IsRGBToNV12Supported(FIntPoint(Width, Height)))
+	{
+		AddInfo(TEXT("The GPU color conversion is not supported by this RHI"));
+		return true;
+	}
+
+	// Gradients with noise on top, so neighbouring pixels of a chroma block differ
+	TArray<FColor> Pixels;
+	Pixels.SetNumUninitialized(Width * Height);
+
+	FRandomStream Random(1234);
+	for (int32 y = 0; y < Height; ++y)
+	{
+		for (int32 x = 0; x < Width; ++x)
+		{
+			Pixels[y * Width + x] = FColor(
+				uint8(FMath::Clamp(x * 4 + Random.RandRange(-16, 16), 0, 255)),
+				uint8(FMath::Clamp(y * 5 + Random.RandRange(-16, 16), 0, 255)),
+				uint8(Random.RandRange(0, 255)),
+				255);
+		}
+	}
+
+	// Converted like the CPU path does. FColor is laid out as B, G, R, A, which is what libyuv calls ARGB
+	TArray<uint8> ExpectedY, ExpectedU, ExpectedV;
+	ExpectedY.SetNumUninitialized(Width * Height);
+	ExpectedU.SetNumUninitialized(Width * Height / 4);
+	ExpectedV.SetNumUninitialized(Width * Height / 4);
+	libyuv::ARGBToI420(reinterpret_cast<const uint8*>(Pixels.GetData()), Width * 4,
+		ExpectedY.GetData(), Width, ExpectedU.GetData(), Width / 2, ExpectedV.GetData(), Width / 2, Width, Height);
+
+	TArray<uint8> ConvertedNV12;
+
+	ENQUEUE_RENDER_COMMAND(MillicastRGBToNV12Test)([&Pixels, &ConvertedNV12](FRHICommandListImmediate& RHICmdList) {
+		FRHIResourceCreateInfo CreateInfo(TEXT("MillicastRGBToNV12Test"));
+		FTexture2DRHIRef Texture = RHICreateTexture2D(Width, Height, PF_B8G8R8A8, 1, 1, TexCreate_ShaderResource, CreateInfo);
+		RHIUpdateTexture2D(Texture, 0, FUpdateTextureRegion2D(0, 0, 0, 0, Width, Height), Width * sizeof(FColor),
+			reinterpret_cast<const uint8*>(Pixels.GetData()));
+
+		FReadbackPool ReadbackPool;
+		FTextureReadbackRing ReadbackRing(1, ReadbackPool);
+
+		{
+			FRDGBuilder GraphBuilder(RHICmdList);
+
+			FRDGTextureRef InputTexture = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(Texture, TEXT("MillicastRGBToNV12TestInput")));
+			FRDGTextureRef NV12Texture = AddRGBToNV12Pass(GraphBuilder, InputTexture, FIntRect(0, 0, Width, Height), FIntPoint(Width, Height));
+			ReadbackRing.Enqueue(GraphBuilder, NV12Texture, FIntRect(0, 0, Width, Height), FIntPoint(Width, Height),
+				FTextureReadbackRing::ELayout::NV12, 0);
+
+			GraphBuilder.Execute();
+		}
+
+		RHICmdList.BlockUntilGPUIdle();
+
+		for (int32 Attempt = 0; Attempt < 100 && ReadbackRing.NumInFlight() > 0; ++Attempt)
+		{
+			ReadbackRing.Poll(RHICmdList, [&ConvertedNV12](const FTextureReadbackRing::FReadbackData& ReadbackData) {
+				ConvertedNV12.SetNumUninitialized(ReadbackData.Width * ReadbackData.Height * 3 / 2);
+				for (int32 Row = 0; Row < ReadbackData.Height * 3 / 2; ++Row)
+				{
+					FMemory::Memcpy(ConvertedNV12.GetData() + Row * ReadbackData.Width, ReadbackData.Data + Row * ReadbackData.Stride, ReadbackData.Width);
+				}
+			});
+
+			if (ReadbackRing.NumInFlight() > 0)
+			{
+				FPlatformProcess::Sleep(0.01f);
+			}
+		}
+	});
+
+	FlushRenderingCommands();
+
+	if (!TestEqual(TEXT("Converted size"), ConvertedNV12.Num(), Width * Height * 3 / 2))
+	{
+		return false;
+	}
+
+	// The shader works on floats and libyuv on fixed point, the luma is rounded the same way but the chroma averages aren't
+	auto ComparePlane = [this](const TCHAR* Plane, const uint8* Converted, int32 ConvertedStep, const TArray<uint8>& Expected, int32 Tolerance) {
+		int32 MaxDifference = 0;
+		for (int32 Index = 0; Index < Expected.Num(); ++Index)
+		{
+			MaxDifference = FMath::Max(MaxDifference, FMath::Abs(int32(Converted[Index * ConvertedStep]) - int32(Expected[Index])));
+		}
+		TestTrue(FString::Printf(TEXT("%s plane differs from libyuv by %d, at most %d expected"), Plane, MaxDifference, Tolerance),
+			MaxDifference <= Tolerance);
+	};
+
+	const uint8* ConvertedUV = ConvertedNV12.GetData() + Width * Height;
+	ComparePlane(TEXT("Y"), ConvertedNV12.GetData(), 1, ExpectedY, 1);
+	ComparePlane(TEXT("U"), ConvertedUV, 2, ExpectedU, 2);
+	ComparePlane(TEXT("V"), ConvertedUV + 1, 2, ExpectedV, 2);
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
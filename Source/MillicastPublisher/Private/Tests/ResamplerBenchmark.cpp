@@ -0,0 +1,192 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "WebRTC/PolyphaseResampler.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastResamplerBenchmark, "Millicast.Publisher.Benchmark.AudioResampler",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+namespace
+{
+	constexpr int32 kOutputRate = 48000;
+	constexpr int32 kNumChannels = 2;
+
+	const TCHAR* GetQualityName(FPolyphaseResampler::EQuality Quality)
+	{
+		switch (Quality)
+		{
+		case FPolyphaseResampler::EQuality::Low: return TEXT("Low");
+		case FPolyphaseResampler::EQuality::Medium: return TEXT("Medium");
+		default: return TEXT("High");
+		}
+	}
+
+	/** Resample one second of a full scale sine, in 10 ms blocks like the audio capture, keeping the first channel */
+	TArray<float> ResampleSine(FPolyphaseResampler::EQuality Quality, int32 InputRate, double Frequency)
+	{
+		FPolyphaseResampler Resampler;
+		Resampler.Configure(InputRate, kOutputRate, kNumChannels, Quality);
+
+		const int32 BlockFrames = InputRate / 100;
+
+		TArray<float> In;
+		In.SetNumUninitialized(BlockFrames * kNumChannels);
+
+		TArray<float> Out;
+		TArray<float> Output;
+
+		for (int32 Block = 0; Block < 100; ++Block)
+		{
+			for (int32 Frame = 0; Frame < BlockFrames; ++Frame)
+			{
+				const double Time = double(Block * BlockFrames + Frame) / InputRate;
+				const float Sample = float(FMath::Sin(2.0 * PI * Frequency * Time));
+				for (int32 Channel = 0; Channel < kNumChannels; ++Channel)
+				{
+					In[Frame * kNumChannels + Channel] = Sample;
+				}
+			}
+
+			Out.SetNumUninitialized(Resampler.GetNumOutputFrames(BlockFrames) * kNumChannels, false);
+			const int32 NumOutputFrames = Resampler.Process(In.GetData(), BlockFrames, Out.GetData());
+
+			for (int32 Frame = 0; Frame < NumOutputFrames; ++Frame)
+			{
+				Output.Add(Out[Frame * kNumChannels]);
+			}
+		}
+
+		// Skip the start of the stream, filtered with the silence before it
+		Output.RemoveAt(0, FMath::Min(Output.Num(), kOutputRate / 10));
+		return Output;
+	}
+
+	/** Power of the signal left once the best fitting sine at Frequency is removed, against the power of that sine, in dB */
+	double GetSignalToNoise(const TArray<float>& Output, double Frequency)
+	{
+		// Least squares fit of A sin + B cos
+		double SS = 0.0, SC = 0.0, CC = 0.0, YS = 0.0, YC = 0.0;
+		for (int32 Index = 0; Index < Output.Num(); ++Index)
+		{
+			const double Phase = 2.0 * PI * Frequency * Index / kOutputRate;
+			const double S = FMath::Sin(Phase);
+			const double C = FMath::Cos(Phase);
+			SS += S * S;
+			SC += S * C;
+			CC += C * C;
+			YS += Output[Index] * S;
+			YC += Output[Index] * C;
+		}
+
+		const double Determinant = SS * CC - SC * SC;
+		const double A = (YS * CC - YC * SC) / Determinant;
+		const double B = (YC * SS - YS * SC) / Determinant;
+
+		double Signal = 0.0, Noise = 0.0;
+		for (int32 Index = 0; Index < Output.Num(); ++Index)
+		{
+			const double Phase = 2.0 * PI * Frequency * Index / kOutputRate;
+			const double Fit = A * FMath::Sin(Phase) + B * FMath::Cos(Phase);
+			Signal += Fit * Fit;
+			Noise += (Output[Index] - Fit) * (Output[Index] - Fit);
+		}
+
+		return 10.0 * FMath::LogX(10.0, Signal / FMath::Max(Noise, 1e-30));
+	}
+
+	/** Attenuation of a full scale sine, in dB */
+	double GetAttenuation(const TArray<float>& Output)
+	{
+		double Power = 0.0;
+		for (float Sample : Output)
+		{
+			Power += double(Sample) * Sample;
+		}
+
+		return 10.0 * FMath::LogX(10.0, 0.5 / FMath::Max(Power / FMath::Max(Output.Num(), 1), 1e-30));
+	}
+}
+
+bool FMillicastResamplerBenchmark::RunTest(const FString& Parameters)
+{
+	const FPolyphaseResampler::EQuality Qualities[] = {
+		FPolyphaseResampler::EQuality::Low, FPolyphaseResampler::EQuality::Medium, FPolyphaseResampler::EQuality::High
+	};
+
+	// Worst SNR and stop band each quality has to keep, a few dB under the measured ones.
+	// The stop band starts right after the transition band, which is wider for the shorter filters
+	const double MinSignalToNoiseDb[] = { 65.0, 85.0, 105.0 };
+	const double MinStopBandDb[] = { 45.0, 80.0, 100.0 };
+
+	for (int32 QualityIndex = 0; QualityIndex < UE_ARRAY_COUNT(Qualities); ++QualityIndex)
+	{
+		const FPolyphaseResampler::EQuality Quality = Qualities[QualityIndex];
+
+		// Sweep of the pass band, 44.1 kHz captures being the most common ones to resample
+		double MinSignalToNoise = TNumericLimits<double>::Max();
+		for (double Frequency = 100.0; Frequency <= 16000.0; Frequency *= 1.5)
+		{
+			MinSignalToNoise = FMath::Min(MinSignalToNoise, GetSignalToNoise(ResampleSine(Quality, 44100, Frequency), Frequency));
+		}
+
+		// Sweep of the stop band when decimating, which folds back into the pass band if it isn't filtered out
+		double MinStopBand = TNumericLimits<double>::Max();
+		for (double Frequency = 27000.0; Frequency <= 47000.0; Frequency += 2000.0)
+		{
+			MinStopBand = FMath::Min(MinStopBand, GetAttenuation(ResampleSine(Quality, 96000, Frequency)));
+		}
+
+		AddInfo(FString::Printf(TEXT("%s quality: %.1f dB worst SNR from 100 Hz to 16 kHz at 44.1 kHz, %.1f dB worst stop band from 27 to 47 kHz at 96 kHz"),
+			GetQualityName(Quality), MinSignalToNoise, MinStopBand));
+
+		TestTrue(FString::Printf(TEXT("%s quality SNR above %.0f dB"), GetQualityName(Quality), MinSignalToNoiseDb[QualityIndex]),
+			MinSignalToNoise >= MinSignalToNoiseDb[QualityIndex]);
+		TestTrue(FString::Printf(TEXT("%s quality stop band above %.0f dB"), GetQualityName(Quality), MinStopBandDb[QualityIndex]),
+			MinStopBand >= MinStopBandDb[QualityIndex]);
+	}
+
+	// CPU cost of the 10 ms blocks of a stereo capture
+	constexpr int32 NumBlocks = 1000;
+	const int32 InputRates[] = { 8000, 44100, 96000, 192000 };
+
+	for (int32 InputRate : InputRates)
+	{
+		const int32 BlockFrames = InputRate / 100;
+
+		TArray<float> In;
+		In.SetNumUninitialized(BlockFrames * kNumChannels);
+		for (int32 Index = 0; Index < In.Num(); ++Index)
+		{
+			In[Index] = float(FMath::Sin(Index * 0.01));
+		}
+
+		TArray<float> Out;
+
+		for (FPolyphaseResampler::EQuality Quality : Qualities)
+		{
+			FPolyphaseResampler Resampler;
+			Resampler.Configure(InputRate, kOutputRate, kNumChannels, Quality);
+
+			// Sized for the largest block, so nothing allocates while timed
+			Out.SetNumUninitialized((FMath::DivideAndRoundUp(BlockFrames * kOutputRate, InputRate) + 2) * kNumChannels, false);
+			Resampler.Process(In.GetData(), BlockFrames, Out.GetData());
+
+			const double Start = FPlatformTime::Seconds();
+			for (int32 Block = 0; Block < NumBlocks; ++Block)
+			{
+				Resampler.Process(In.GetData(), BlockFrames, Out.GetData());
+			}
+			const double BlockUs = (FPlatformTime::Seconds() - Start) * 1e6 / NumBlocks;
+
+			AddInfo(FString::Printf(TEXT("%.1f kHz to 48 kHz stereo, %s quality: %.2f us per 10 ms block"),
+				InputRate / 1000.0, GetQualityName(Quality), BlockUs));
+		}
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
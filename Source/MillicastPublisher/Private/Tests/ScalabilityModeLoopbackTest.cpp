@@ -0,0 +1,458 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "WebRTC/PeerConnection.h"
+#include "WebRTC/AudioDeviceModule.h"
+#include "WebRTC/SessionDescriptionObserver.h"
+#include "MillicastPublisherSource.h"
+
+#include "UObject/Package.h"
+
+#include <algorithm>
+#include <iterator>
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastScalabilityModeLoopbackTest, "Millicast.Publisher.ScalabilityModeLoopback",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+#if WEBRTC_VERSION >= 96
+
+namespace
+{
+	constexpr int32 kWidth = 1280;
+	constexpr int32 kHeight = 720;
+	constexpr int32 kFramerate = 30;
+
+	/** Layers of the frames the encoders produced */
+	struct FEncodedLayers
+	{
+		FCriticalSection Section;
+		TSet<int32> SpatialIds;
+		TSet<int32> TemporalIds;
+		int32 NumFrames = 0;
+
+		void Reset()
+		{
+			FScopeLock Lock(&Section);
+			SpatialIds.Empty();
+			TemporalIds.Empty();
+			NumFrames = 0;
+		}
+	};
+
+	using FEncodedLayersRef = TSharedRef<FEncodedLayers, ESPMode::ThreadSafe>;
+
+	/** Records the layers of every encoded frame before passing it on to webrtc */
+	class FLayerObserver : public webrtc::EncodedImageCallback
+	{
+	public:
+		FLayerObserver(webrtc::EncodedImageCallback* InCallback, FEncodedLayersRef InLayers)
+			: Callback(InCallback), Layers(MoveTemp(InLayers))
+		{}
+
+		Result OnEncodedImage(const webrtc::EncodedImage& EncodedImage, const webrtc::CodecSpecificInfo* CodecSpecificInfo) override
+		{
+			if (CodecSpecificInfo)
+			{
+				FScopeLock Lock(&Layers->Section);
+				++Layers->NumFrames;
+
+				// The spatial index of a VP9 frame moved from its codec specific info to the encoded image
+				if (CodecSpecificInfo->codecType == webrtc::kVideoCodecVP9)
+				{
+					const uint8 TemporalIdx = CodecSpecificInfo->codecSpecific.VP9.temporal_idx;
+					Layers->SpatialIds.Add(EncodedImage.SpatialIndex().value_or(0));
+					Layers->TemporalIds.Add(TemporalIdx == webrtc::kNoTemporalIdx ? 0 : TemporalIdx);
+				}
+				else if (CodecSpecificInfo->generic_frame_info)
+				{
+					Layers->SpatialIds.Add(CodecSpecificInfo->generic_frame_info->spatial_id);
+					Layers->TemporalIds.Add(CodecSpecificInfo->generic_frame_info->temporal_id);
+				}
+			}
+
+			return Callback->OnEncodedImage(EncodedImage, CodecSpecificInfo);
+		}
+
+		void OnDroppedFrame(DropReason Reason) override
+		{
+			Callback->OnDroppedFrame(Reason);
+		}
+
+	private:
+		webrtc::EncodedImageCallback* Callback;
+		FEncodedLayersRef Layers;
+	};
+
+	/** Encoder of the built-in factory, with its output observed */
+	class FObservedEncoder : public webrtc::VideoEncoder
+	{
+	public:
+		FObservedEncoder(std::unique_ptr<webrtc::VideoEncoder> InEncoder, FEncodedLayersRef InLayers)
+			: Encoder(MoveTemp(InEncoder)), Layers(MoveTemp(InLayers))
+		{}
+
+		void SetFecControllerOverride(webrtc::FecControllerOverride* FecControllerOverride) override
+		{
+			Encoder->SetFecControllerOverride(FecControllerOverride);
+		}
+
+		int32_t InitEncode(const webrtc::VideoCodec* CodecSettings, const Settings& EncoderSettings) override
+		{
+			return Encoder->InitEncode(CodecSettings, EncoderSettings);
+		}
+
+		int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* Callback) override
+		{
+			Observer = Callback ? MakeUnique<FLayerObserver>(Callback, Layers) : nullptr;
+			return Encoder->RegisterEncodeCompleteCallback(Observer.Get());
+		}
+
+		int32_t Release() override { return Encoder->Release(); }
+
+		int32_t Encode(const webrtc::VideoFrame& Frame, const std::vector<webrtc::VideoFrameType>* FrameTypes) override
+		{
+			return Encoder->Encode(Frame, FrameTypes);
+		}
+
+		void SetRates(const RateControlParameters& Parameters) override { Encoder->SetRates(Parameters); }
+		void OnPacketLossRateUpdate(float PacketLossRate) override { Encoder->OnPacketLossRateUpdate(PacketLossRate); }
+		void OnRttUpdate(int64_t RttMs) override { Encoder->OnRttUpdate(RttMs); }
+		void OnLossNotification(const LossNotification& Notification) override { Encoder->OnLossNotification(Notification); }
+		EncoderInfo GetEncoderInfo() const override { return Encoder->GetEncoderInfo(); }
+
+	private:
+		std::unique_ptr<webrtc::VideoEncoder> Encoder;
+		TUniquePtr<FLayerObserver> Observer;
+		FEncodedLayersRef Layers;
+	};
+
+	/** The built-in video encoder factory the publisher uses, its encoders observed */
+	class FObservedEncoderFactory : public webrtc::VideoEncoderFactory
+	{
+	public:
+		explicit FObservedEncoderFactory(FEncodedLayersRef InLayers)
+			: Factory(webrtc::CreateBuiltinVideoEncoderFactory()), Layers(MoveTemp(InLayers))
+		{}
+
+		std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override { return Factory->GetSupportedFormats(); }
+
+		std::unique_ptr<webrtc::VideoEncoder> CreateVideoEncoder(const webrtc::SdpVideoFormat& Format) override
+		{
+			return std::make_unique<FObservedEncoder>(Factory->CreateVideoEncoder(Format), Layers);
+		}
+
+	private:
+		std::unique_ptr<webrtc::VideoEncoderFactory> Factory;
+		FEncodedLayersRef Layers;
+	};
+
+	/** Video source the test pushes synthetic frames to */
+	class FSyntheticVideoSource : public rtc::AdaptedVideoTrackSource
+	{
+	public:
+		void PushFrame(int32 Index)
+		{
+			rtc::scoped_refptr<webrtc::I420Buffer> Buffer = webrtc::I420Buffer::Create(kWidth, kHeight);
+			webrtc::I420Buffer::SetBlack(Buffer);
+
+			// A moving bar, so the encoder doesn't only skip
+			for (int32 Y = 0; Y < kHeight; ++Y)
+			{
+				FMemory::Memset(Buffer->MutableDataY() + Y * Buffer->StrideY() + (Index * 16) % (kWidth - 64), 235, 64);
+			}
+
+			OnFrame(webrtc::VideoFrame::Builder()
+				.set_video_frame_buffer(Buffer)
+				.set_timestamp_us(rtc::TimeMicros())
+				.set_rotation(webrtc::kVideoRotation_0)
+				.build());
+		}
+
+		webrtc::MediaSourceInterface::SourceState state() const override { return kLive; }
+		absl::optional<bool> needs_denoising() const override { return false; }
+		bool is_screencast() const override { return false; }
+		bool remote() const override { return false; }
+	};
+
+	/** Signals the end of the candidate gathering, so the descriptions are exchanged with every candidate in them */
+	class FLoopbackObserver : public webrtc::PeerConnectionObserver
+	{
+	public:
+		FEvent* GatheringDone = FPlatformProcess::GetSynchEventFromPool(true);
+
+		~FLoopbackObserver()
+		{
+			FPlatformProcess::ReturnSynchEventToPool(GatheringDone);
+		}
+
+		void OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState NewState) override {}
+		void OnDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> DataChannel) override {}
+		void OnRenegotiationNeeded() override {}
+		void OnIceCandidate(const webrtc::IceCandidateInterface* Candidate) override {}
+
+		void OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState NewState) override
+		{
+			if (NewState == webrtc::PeerConnectionInterface::kIceGatheringComplete)
+			{
+				GatheringDone->Trigger();
+			}
+		}
+	};
+
+	/** Description created or set on the signaling thread, which may outlive the test if it times out */
+	struct FDescriptionResult
+	{
+		FEvent* Done = FPlatformProcess::GetSynchEventFromPool();
+		std::string Type;
+		std::string Sdp;
+		std::string Error;
+
+		~FDescriptionResult()
+		{
+			FPlatformProcess::ReturnSynchEventToPool(Done);
+		}
+	};
+
+	using FDescriptionResultRef = TSharedRef<FDescriptionResult, ESPMode::ThreadSafe>;
+
+	const FTimespan kTimeout = FTimespan::FromSeconds(10.0);
+
+	/** Create the offer or the answer and set it as local description, returning it once its candidates are gathered */
+	FDescriptionResultRef CreateLocalDescription(webrtc::PeerConnectionInterface* PeerConnection, FLoopbackObserver& Observer, bool bOffer)
+	{
+		auto Created = MakeShared<FDescriptionResult, ESPMode::ThreadSafe>();
+
+		auto* CreateObserver = new TSessionDescriptionObserver<webrtc::CreateSessionDescriptionObserver>();
+		CreateObserver->SetOnSuccessCallback([Created](const std::string& Type, const std::string& Sdp) {
+			Created->Type = Type;
+			Created->Sdp = Sdp;
+			Created->Done->Trigger();
+		});
+		CreateObserver->SetOnFailureCallback([Created](const std::string& Error) {
+			Created->Error = Error;
+			Created->Done->Trigger();
+		});
+
+		const webrtc::PeerConnectionInterface::RTCOfferAnswerOptions Options;
+		if (bOffer)
+		{
+			PeerConnection->CreateOffer(CreateObserver, Options);
+		}
+		else
+		{
+			PeerConnection->CreateAnswer(CreateObserver, Options);
+		}
+
+		if (!Created->Done->Wait(kTimeout) || !Created->Error.empty())
+		{
+			Created->Error = Created->Error.empty() ? "timed out" : Created->Error;
+			return Created;
+		}
+
+		auto Set = MakeShared<FDescriptionResult, ESPMode::ThreadSafe>();
+
+		auto* SetObserver = new TSessionDescriptionObserver<webrtc::SetSessionDescriptionObserver>();
+		SetObserver->SetOnSuccessCallback([Set]() { Set->Done->Trigger(); });
+		SetObserver->SetOnFailureCallback([Set](const std::string& Error) {
+			Set->Error = Error;
+			Set->Done->Trigger();
+		});
+
+		PeerConnection->SetLocalDescription(SetObserver, webrtc::CreateSessionDescription(Created->Type, Created->Sdp, nullptr));
+
+		if (!Set->Done->Wait(kTimeout) || !Set->Error.empty() || !Observer.GatheringDone->Wait(kTimeout))
+		{
+			Set->Error = Set->Error.empty() ? "timed out" : Set->Error;
+			return Set;
+		}
+
+		// Now with the candidates
+		Set->Type = Created->Type;
+		PeerConnection->local_description()->ToString(&Set->Sdp);
+		return Set;
+	}
+
+	/** Set the description of the other peer. Returns the error, empty on success */
+	std::string SetRemoteDescription(webrtc::PeerConnectionInterface* PeerConnection, const FDescriptionResult& Description)
+	{
+		auto Set = MakeShared<FDescriptionResult, ESPMode::ThreadSafe>();
+
+		auto* SetObserver = new TSessionDescriptionObserver<webrtc::SetSessionDescriptionObserver>();
+		SetObserver->SetOnSuccessCallback([Set]() { Set->Done->Trigger(); });
+		SetObserver->SetOnFailureCallback([Set](const std::string& Error) {
+			Set->Error = Error;
+			Set->Done->Trigger();
+		});
+
+		PeerConnection->SetRemoteDescription(SetObserver, webrtc::CreateSessionDescription(Description.Type, Description.Sdp, nullptr));
+
+		return Set->Done->Wait(kTimeout) ? Set->Error : "timed out";
+	}
+}
+
+#endif // WEBRTC_VERSION >= 96
+
+bool FMillicastScalabilityModeLoopbackTest::RunTest(const FString& Parameters)
+{
+#if WEBRTC_VERSION >= 96
+	struct FCase
+	{
+		VideoScalabilityMode Mode;
+		int32 NumSpatialLayers;
+		int32 NumTemporalLayers;
+	};
+
+	const FCase Cases[] = {
+		{ VideoScalabilityMode::SCALABILITY_L1T3, 1, 3 },
+		{ VideoScalabilityMode::SCALABILITY_L3T3, 3, 3 },
+	};
+	const char* CodecNames[] = { cricket::kVp9CodecName, cricket::kAv1CodecName };
+
+	rtc::InitializeSSL();
+
+	TUniquePtr<rtc::Thread> SignalingThread(rtc::Thread::Create().release());
+	SignalingThread->SetName("MillicastLoopbackSignalingThread", nullptr);
+	SignalingThread->Start();
+
+	std::unique_ptr<webrtc::TaskQueueFactory> TaskQueueFactory = webrtc::CreateDefaultTaskQueueFactory();
+
+	FEncodedLayersRef Layers = MakeShared<FEncodedLayers, ESPMode::ThreadSafe>();
+
+	// Same factory as the publisher's, but for the encoders being observed
+	rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> Factory = webrtc::CreatePeerConnectionFactory(
+		nullptr, nullptr, SignalingThread.Get(), FAudioDeviceModule::Create(TaskQueueFactory.get()),
+		webrtc::CreateBuiltinAudioEncoderFactory(), webrtc::CreateBuiltinAudioDecoderFactory(),
+		std::make_unique<FObservedEncoderFactory>(Layers), webrtc::CreateBuiltinVideoDecoderFactory(),
+		nullptr, nullptr);
+
+	if (!TestTrue(TEXT("Create the peer connection factory"), Factory != nullptr))
+	{
+		SignalingThread->Stop();
+		return false;
+	}
+
+	const auto Capabilities = Factory->GetRtpSenderCapabilities(cricket::MEDIA_TYPE_VIDEO);
+
+	UMillicastPublisherSource* Source = NewObject<UMillicastPublisherSource>(GetTransientPackage());
+
+	for (const char* CodecName : CodecNames)
+	{
+		std::vector<webrtc::RtpCodecCapability> Codecs;
+		std::copy_if(Capabilities.codecs.begin(), Capabilities.codecs.end(), std::back_inserter(Codecs),
+			[CodecName](const webrtc::RtpCodecCapability& Capability) { return Capability.name == CodecName; });
+
+		if (Codecs.empty())
+		{
+			AddInfo(FString::Printf(TEXT("%S: not built in, skipped"), CodecName));
+			continue;
+		}
+
+		for (const FCase& Case : Cases)
+		{
+			Source->ScalabilityMode = Case.Mode;
+			Layers->Reset();
+
+			const webrtc::RtpEncodingParameters Encoding = FWebRTCPeerConnection::MakeSendEncodings(*Source)[0];
+			const FString Description = FString::Printf(TEXT("%S %S"), CodecName, Encoding.scalability_mode.value_or("").c_str());
+
+			FLoopbackObserver SenderObserver;
+			FLoopbackObserver ReceiverObserver;
+
+			auto Sender = Factory->CreatePeerConnection(FWebRTCPeerConnection::GetDefaultConfig(), nullptr, nullptr, &SenderObserver);
+			auto Receiver = Factory->CreatePeerConnection(FWebRTCPeerConnection::GetDefaultConfig(), nullptr, nullptr, &ReceiverObserver);
+
+			rtc::scoped_refptr<FSyntheticVideoSource> VideoSource = new rtc::RefCountedObject<FSyntheticVideoSource>();
+
+			// The transceiver the publisher component creates, with the encodings of the source
+			webrtc::RtpTransceiverInit Init;
+			Init.direction = webrtc::RtpTransceiverDirection::kSendOnly;
+			Init.stream_ids = { "loopback" };
+			Init.send_encodings = FWebRTCPeerConnection::MakeSendEncodings(*Source);
+
+			auto Transceiver = Sender->AddTransceiver(Factory->CreateVideoTrack("video", VideoSource), Init);
+			if (TestTrue(FString::Printf(TEXT("%s: add the video transceiver"), *Description), Transceiver.ok())
+				&& TestTrue(FString::Printf(TEXT("%s: prefer the codec"), *Description), Transceiver.value()->SetCodecPreferences(Codecs).ok()))
+			{
+				// Room for every spatial layer from the start, rather than waiting for the bandwidth estimation to ramp up
+				webrtc::BitrateSettings Bitrate;
+				Bitrate.start_bitrate_bps = 2500000;
+				Sender->SetBitrate(Bitrate);
+
+				const FDescriptionResultRef Offer = CreateLocalDescription(Sender, SenderObserver, true);
+				std::string Error = Offer->Error;
+
+				if (Error.empty())
+				{
+					Error = SetRemoteDescription(Receiver, *Offer);
+				}
+
+				FDescriptionResultRef Answer = MakeShared<FDescriptionResult, ESPMode::ThreadSafe>();
+				if (Error.empty())
+				{
+					Answer = CreateLocalDescription(Receiver, ReceiverObserver, false);
+					Error = Answer->Error;
+				}
+
+				if (Error.empty())
+				{
+					Error = SetRemoteDescription(Sender, *Answer);
+				}
+
+				if (TestTrue(FString::Printf(TEXT("%s: negotiate the loopback (%S)"), *Description, Error.c_str()), Error.empty()))
+				{
+					// Frames are sent for a few seconds once connected, so every layer gets encoded
+					const double ConnectDeadline = FPlatformTime::Seconds() + kTimeout.GetTotalSeconds();
+					double SendDeadline = 0.0;
+					for (int32 Index = 0; SendDeadline == 0.0 || FPlatformTime::Seconds() < SendDeadline; ++Index)
+					{
+						if (SendDeadline == 0.0 && Sender->peer_connection_state() == webrtc::PeerConnectionInterface::PeerConnectionState::kConnected)
+						{
+							SendDeadline = FPlatformTime::Seconds() + 3.0;
+						}
+						else if (SendDeadline == 0.0 && FPlatformTime::Seconds() > ConnectDeadline)
+						{
+							break;
+						}
+
+						VideoSource->PushFrame(Index);
+						FPlatformProcess::Sleep(1.f / kFramerate);
+					}
+
+					TestTrue(FString::Printf(TEXT("%s: connected"), *Description), SendDeadline > 0.0);
+
+					FScopeLock Lock(&Layers->Section);
+
+					TArray<int32> SpatialIds = Layers->SpatialIds.Array();
+					TArray<int32> TemporalIds = Layers->TemporalIds.Array();
+					SpatialIds.Sort();
+					TemporalIds.Sort();
+
+					AddInfo(FString::Printf(TEXT("%s: %d frames encoded, spatial layers %s, temporal layers %s"), *Description, Layers->NumFrames,
+						*FString::JoinBy(SpatialIds, TEXT(" "), [](int32 Id) { return FString::FromInt(Id); }),
+						*FString::JoinBy(TemporalIds, TEXT(" "), [](int32 Id) { return FString::FromInt(Id); })));
+
+					TestEqual(FString::Printf(TEXT("%s: spatial layers encoded"), *Description), SpatialIds.Num(), Case.NumSpatialLayers);
+					TestEqual(FString::Printf(TEXT("%s: temporal layers encoded"), *Description), TemporalIds.Num(), Case.NumTemporalLayers);
+					TestTrue(FString::Printf(TEXT("%s: layers numbered from 0"), *Description),
+						SpatialIds.Num() > 0 && SpatialIds.Last() == SpatialIds.Num() - 1 && TemporalIds.Num() > 0 && TemporalIds.Last() == TemporalIds.Num() - 1);
+				}
+			}
+
+			Sender->Close();
+			Receiver->Close();
+		}
+	}
+
+	Factory = nullptr;
+	SignalingThread->Stop();
+#else
+	AddInfo(TEXT("Scalability modes need webrtc 96"));
+#endif
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,395 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "WebRTC/SdpEditor.h"
+
+namespace
+{
+	/** Offer of the publisher, as webrtc 96 creates it with the H264 and AV1 encoders of the plugin */
+	const char* kOffer =
+		"v=0\r\n"
+		"o=- 4611731400430051336 2 IN IP4 127.0.0.1\r\n"
+		"s=-\r\n"
+		"t=0 0\r\n"
+		"a=group:BUNDLE 0 1 2\r\n"
+		"a=extmap-allow-mixed\r\n"
+		"a=msid-semantic: WMS unrealstream\r\n"
+		"m=audio 9 UDP/TLS/RTP/SAVPF 111 63 103 9 0 8 110 126\r\n"
+		"c=IN IP4 0.0.0.0\r\n"
+		"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+		"a=ice-ufrag:Xb3k\r\n"
+		"a=ice-pwd:kq8Vh3dDMv0cB5Q4oZ1nS7uR\r\n"
+		"a=ice-options:trickle\r\n"
+		"a=fingerprint:sha-256 6B:8B:5A:F0:1D:4C:78:36:5E:1B:C3:23:5A:4D:AC:92:26:70:8A:FC:5E:4B:6F:11:7E:A8:6D:E3:7C:19:0A:42\r\n"
+		"a=setup:actpass\r\n"
+		"a=mid:0\r\n"
+		"a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\r\n"
+		"a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\r\n"
+		"a=sendonly\r\n"
+		"a=msid:unrealstream audio\r\n"
+		"a=rtcp-mux\r\n"
+		"a=rtpmap:111 opus/48000/2\r\n"
+		"a=rtcp-fb:111 transport-cc\r\n"
+		"a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+		"a=rtpmap:63 red/48000/2\r\n"
+		"a=fmtp:63 111/111\r\n"
+		"a=rtpmap:103 ISAC/16000\r\n"
+		"a=rtpmap:9 G722/8000\r\n"
+		"a=rtpmap:0 PCMU/8000\r\n"
+		"a=rtpmap:8 PCMA/8000\r\n"
+		"a=rtpmap:110 telephone-event/48000\r\n"
+		"a=rtpmap:126 telephone-event/8000\r\n"
+		"a=ssrc:3570614608 cname:4TOk42mSjXCkVIa6\r\n"
+		"a=ssrc:3570614608 msid:unrealstream audio\r\n"
+		"m=video 9 UDP/TLS/RTP/SAVPF 96 97 98 99 100 101 35 36 102 125 127\r\n"
+		"c=IN IP4 0.0.0.0\r\n"
+		"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+		"a=ice-ufrag:Xb3k\r\n"
+		"a=ice-pwd:kq8Vh3dDMv0cB5Q4oZ1nS7uR\r\n"
+		"a=ice-options:trickle\r\n"
+		"a=fingerprint:sha-256 6B:8B:5A:F0:1D:4C:78:36:5E:1B:C3:23:5A:4D:AC:92:26:70:8A:FC:5E:4B:6F:11:7E:A8:6D:E3:7C:19:0A:42\r\n"
+		"a=setup:actpass\r\n"
+		"a=mid:1\r\n"
+		"a=extmap:14 urn:ietf:params:rtp-hdrext:toffset\r\n"
+		"a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\r\n"
+		"a=sendonly\r\n"
+		"a=msid:unrealstream video\r\n"
+		"a=rtcp-mux\r\n"
+		"a=rtcp-rsize\r\n"
+		"a=rtpmap:96 VP8/90000\r\n"
+		"a=rtcp-fb:96 goog-remb\r\n"
+		"a=rtcp-fb:96 transport-cc\r\n"
+		"a=rtcp-fb:96 ccm fir\r\n"
+		"a=rtcp-fb:96 nack\r\n"
+		"a=rtcp-fb:96 nack pli\r\n"
+		"a=rtpmap:97 rtx/90000\r\n"
+		"a=fmtp:97 apt=96\r\n"
+		"a=rtpmap:98 VP9/90000\r\n"
+		"a=rtcp-fb:98 goog-remb\r\n"
+		"a=rtcp-fb:98 nack\r\n"
+		"a=fmtp:98 profile-id=0\r\n"
+		"a=rtpmap:99 rtx/90000\r\n"
+		"a=fmtp:99 apt=98\r\n"
+		"a=rtpmap:100 H264/90000\r\n"
+		"a=rtcp-fb:100 goog-remb\r\n"
+		"a=rtcp-fb:100 nack\r\n"
+		"a=fmtp:100 level-asymmetry-allowed=1;packetization-mode=1;profile-level-id=42e01f\r\n"
+		"a=rtpmap:101 rtx/90000\r\n"
+		"a=fmtp:101 apt=100\r\n"
+		"a=rtpmap:35 AV1/90000\r\n"
+		"a=rtcp-fb:35 goog-remb\r\n"
+		"a=rtcp-fb:35 nack\r\n"
+		"a=rtpmap:36 rtx/90000\r\n"
+		"a=fmtp:36 apt=35\r\n"
+		"a=rtpmap:102 red/90000\r\n"
+		"a=rtpmap:125 rtx/90000\r\n"
+		"a=fmtp:125 apt=102\r\n"
+		"a=rtpmap:127 ulpfec/90000\r\n"
+		"a=ssrc-group:FID 1771926178 2943720474\r\n"
+		"a=ssrc:1771926178 cname:4TOk42mSjXCkVIa6\r\n"
+		"a=ssrc:2943720474 cname:4TOk42mSjXCkVIa6\r\n"
+		"m=application 9 UDP/DTLS/SCTP webrtc-datachannel\r\n"
+		"c=IN IP4 0.0.0.0\r\n"
+		"a=ice-ufrag:Xb3k\r\n"
+		"a=ice-pwd:kq8Vh3dDMv0cB5Q4oZ1nS7uR\r\n"
+		"a=ice-options:trickle\r\n"
+		"a=fingerprint:sha-256 6B:8B:5A:F0:1D:4C:78:36:5E:1B:C3:23:5A:4D:AC:92:26:70:8A:FC:5E:4B:6F:11:7E:A8:6D:E3:7C:19:0A:42\r\n"
+		"a=setup:actpass\r\n"
+		"a=mid:2\r\n"
+		"a=sctp-port:5000\r\n"
+		"a=max-message-size:262144\r\n";
+
+	/** Offer with the surround formats webrtc adds when the multichannel opus codecs are enabled */
+	const char* kMultiopusOffer =
+		"v=0\r\n"
+		"o=- 8196431045112460185 2 IN IP4 127.0.0.1\r\n"
+		"s=-\r\n"
+		"t=0 0\r\n"
+		"a=group:BUNDLE 0\r\n"
+		"a=msid-semantic: WMS unrealstream\r\n"
+		"m=audio 9 UDP/TLS/RTP/SAVPF 111 114 115 116 110\r\n"
+		"c=IN IP4 0.0.0.0\r\n"
+		"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+		"a=mid:0\r\n"
+		"a=sendonly\r\n"
+		"a=rtcp-mux\r\n"
+		"a=rtpmap:111 opus/48000/2\r\n"
+		"a=rtcp-fb:111 transport-cc\r\n"
+		"a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+		"a=rtpmap:114 multiopus/48000/6\r\n"
+		"a=fmtp:114 channel_mapping=0,4,1,2,3,5;coupled_streams=2;minptime=10;num_streams=4;useinbandfec=1\r\n"
+		"a=rtpmap:115 multiopus/48000/8\r\n"
+		"a=fmtp:115 channel_mapping=0,6,1,2,3,4,5,7;coupled_streams=3;minptime=10;num_streams=5;useinbandfec=1\r\n"
+		"a=rtpmap:116 multiopus/48000/4\r\n"
+		"a=fmtp:116 channel_mapping=0,1,2,3;coupled_streams=2;minptime=10;num_streams=2;useinbandfec=1\r\n"
+		"a=rtpmap:110 telephone-event/48000\r\n"
+		"a=fmtp:110 0-15\r\n"
+		"a=ssrc:2004913717 cname:bX9s1VmmX3fNyS2T\r\n";
+
+	/** Answer of the media server to the offer, which keeps none of the send parameters */
+	const char* kAnswer =
+		"v=0\r\n"
+		"o=- 1663315289830 1 IN IP4 127.0.0.1\r\n"
+		"s=-\r\n"
+		"t=0 0\r\n"
+		"a=group:BUNDLE 0 1 2\r\n"
+		"a=msid-semantic: WMS *\r\n"
+		"a=ice-lite\r\n"
+		"m=audio 9 UDP/TLS/RTP/SAVPF 111\r\n"
+		"c=IN IP4 0.0.0.0\r\n"
+		"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+		"a=ice-ufrag:e2b3f1a7\r\n"
+		"a=ice-pwd:0c3ed21f8b4dc1a6e79b6b6e\r\n"
+		"a=fingerprint:sha-256 1F:1D:6B:25:91:5C:0E:AB:8F:25:3D:55:F6:0E:83:88:5F:CB:9D:55:A4:39:3B:76:0E:DF:27:64:6D:3E:38:2A\r\n"
+		"a=setup:passive\r\n"
+		"a=mid:0\r\n"
+		"a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\r\n"
+		"a=recvonly\r\n"
+		"a=rtcp-mux\r\n"
+		"a=rtpmap:111 opus/48000/2\r\n"
+		"a=rtcp-fb:111 transport-cc\r\n"
+		"a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+		"a=ptime:20\r\n"
+		"m=video 9 UDP/TLS/RTP/SAVPF 100 101\r\n"
+		"c=IN IP4 0.0.0.0\r\n"
+		"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+		"a=ice-ufrag:e2b3f1a7\r\n"
+		"a=ice-pwd:0c3ed21f8b4dc1a6e79b6b6e\r\n"
+		"a=fingerprint:sha-256 1F:1D:6B:25:91:5C:0E:AB:8F:25:3D:55:F6:0E:83:88:5F:CB:9D:55:A4:39:3B:76:0E:DF:27:64:6D:3E:38:2A\r\n"
+		"a=setup:passive\r\n"
+		"a=mid:1\r\n"
+		"a=recvonly\r\n"
+		"a=rtcp-mux\r\n"
+		"a=rtcp-rsize\r\n"
+		"a=rtpmap:100 H264/90000\r\n"
+		"a=rtcp-fb:100 goog-remb\r\n"
+		"a=rtcp-fb:100 nack\r\n"
+		"a=fmtp:100 level-asymmetry-allowed=1;packetization-mode=1;profile-level-id=42e01f\r\n"
+		"a=rtpmap:101 rtx/90000\r\n"
+		"a=fmtp:101 apt=100\r\n"
+		"m=application 9 UDP/DTLS/SCTP webrtc-datachannel\r\n"
+		"c=IN IP4 0.0.0.0\r\n"
+		"a=mid:2\r\n"
+		"a=sctp-port:5000\r\n";
+
+	FString ToFString(const std::string& Value)
+	{
+		return UTF8_TO_TCHAR(Value.c_str());
+	}
+
+	/** The m= line of the first section of a kind */
+	FString GetMLine(const std::string& Sdp, const std::string& Kind)
+	{
+		const std::string Prefix = "m=" + Kind + " ";
+		const auto Start = Sdp.find(Prefix);
+		return Start != std::string::npos ? ToFString(Sdp.substr(Start, Sdp.find("\r\n", Start) - Start)) : FString();
+	}
+
+	bool Contains(const std::string& Sdp, const std::string& Lines)
+	{
+		return Sdp.find(Lines) != std::string::npos;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastSdpEditorRoundTripTest, "Millicast.Publisher.SdpEditor.RoundTrip",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMillicastSdpEditorRoundTripTest::RunTest(const FString& Parameters)
+{
+	for (const char* Sdp : { kOffer, kMultiopusOffer, kAnswer })
+	{
+		FSdpEditor SdpEditor;
+		if (TestTrue(TEXT("Parse"), SdpEditor.Parse(Sdp)))
+		{
+			// Nothing edited, nothing changed, down to the fmtp lines which aren't name=value
+			TestEqual(TEXT("Written back byte for byte"), ToFString(SdpEditor.ToString()), ToFString(Sdp));
+		}
+	}
+
+	FSdpEditor SdpEditor;
+	TestFalse(TEXT("Parse a description without media section"), SdpEditor.Parse("v=0\r\no=- 0 0 IN IP4 127.0.0.1\r\ns=-\r\nt=0 0\r\n"));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastSdpEditorPreferFormatTest, "Millicast.Publisher.SdpEditor.PreferFormat",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMillicastSdpEditorPreferFormatTest::RunTest(const FString& Parameters)
+{
+	FSdpEditor SdpEditor;
+	SdpEditor.Parse(kMultiopusOffer);
+
+	TestTrue(TEXT("Prefer multiopus/48000/6"), SdpEditor.PreferFormat("audio", "multiopus/48000/6"));
+	TestFalse(TEXT("Prefer a format which isn't offered"), SdpEditor.PreferFormat("audio", "multiopus/48000/3"));
+
+	const std::string Edited = SdpEditor.ToString();
+	TestEqual(TEXT("Audio m-line"), GetMLine(Edited, "audio"), TEXT("m=audio 9 UDP/TLS/RTP/SAVPF 114 111 115 116 110"));
+
+	// Only the m-line moves
+	FSdpEditor Original;
+	Original.Parse(kMultiopusOffer);
+	std::string Expected = Original.ToString();
+	Expected.replace(Expected.find("111 114"), 7, "114 111");
+	TestEqual(TEXT("Other lines unchanged"), ToFString(Edited), ToFString(Expected));
+
+	// The encoding is matched whatever its case, in every section of the kind only
+	SdpEditor.Parse(kOffer);
+	TestTrue(TEXT("Prefer h264/90000"), SdpEditor.PreferFormat("video", "h264/90000"));
+	TestFalse(TEXT("Prefer a video format in the audio section"), SdpEditor.PreferFormat("audio", "H264/90000"));
+	TestEqual(TEXT("Video m-line"), GetMLine(SdpEditor.ToString(), "video"), TEXT("m=video 9 UDP/TLS/RTP/SAVPF 100 96 97 98 99 101 35 36 102 125 127"));
+	TestEqual(TEXT("Audio m-line"), GetMLine(SdpEditor.ToString(), "audio"), TEXT("m=audio 9 UDP/TLS/RTP/SAVPF 111 63 103 9 0 8 110 126"));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastSdpEditorFmtpTest, "Millicast.Publisher.SdpEditor.Fmtp",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMillicastSdpEditorFmtpTest::RunTest(const FString& Parameters)
+{
+	FSdpEditor SdpEditor;
+	SdpEditor.Parse(kOffer);
+
+	TestEqual(TEXT("Get useinbandfec"), ToFString(SdpEditor.GetFmtpParameter("audio", "opus", "useinbandfec").Get("")), TEXT("1"));
+	TestFalse(TEXT("Get a parameter which isn't set"), SdpEditor.GetFmtpParameter("audio", "opus", "stereo").IsSet());
+
+	// An existing parameter is replaced in place, a new one goes last
+	TestEqual(TEXT("Set useinbandfec"), SdpEditor.SetFmtpParameter("audio", "opus", "useinbandfec", "0"), 1);
+	TestEqual(TEXT("Set stereo"), SdpEditor.SetFmtpParameter("audio", "OPUS", "stereo", "1"), 1);
+	TestEqual(TEXT("Remove minptime"), SdpEditor.RemoveFmtpParameter("audio", "opus", "minptime"), 1);
+	TestEqual(TEXT("Remove a parameter which isn't set"), SdpEditor.RemoveFmtpParameter("audio", "opus", "usedtx"), 0);
+
+	// A format without fmtp line gets one after its rtpmap line
+	TestEqual(TEXT("Set the AV1 profile"), SdpEditor.SetFmtpParameter("video", "AV1", "profile", "0"), 1);
+
+	// The redundancy of red isn't name=value, it's kept as is
+	TestEqual(TEXT("Set on red"), SdpEditor.SetFmtpParameter("audio", "red", "x", "1"), 1);
+
+	// The last parameter removed drops the line
+	TestEqual(TEXT("Remove the VP9 profile"), SdpEditor.RemoveFmtpParameter("video", "VP9", "profile-id"), 1);
+
+	const std::string Edited = SdpEditor.ToString();
+	TestTrue(TEXT("opus fmtp line"), Contains(Edited, "a=rtcp-fb:111 transport-cc\r\na=fmtp:111 useinbandfec=0;stereo=1\r\na=rtpmap:63 red/48000/2\r\n"));
+	TestTrue(TEXT("red fmtp line"), Contains(Edited, "a=fmtp:63 111/111;x=1\r\n"));
+	TestTrue(TEXT("AV1 fmtp line"), Contains(Edited, "a=rtpmap:35 AV1/90000\r\na=fmtp:35 profile=0\r\na=rtcp-fb:35 goog-remb\r\n"));
+	TestFalse(TEXT("VP9 fmtp line"), Contains(Edited, "a=fmtp:98 "));
+	TestTrue(TEXT("telephone-event has no fmtp line"), Contains(Edited, "a=rtpmap:110 telephone-event/48000\r\na=rtpmap:126 telephone-event/8000\r\n"));
+
+	// What isn't edited is written back as is
+	FSdpEditor Reparsed;
+	Reparsed.Parse(Edited);
+	TestEqual(TEXT("Edited description written back byte for byte"), ToFString(Reparsed.ToString()), ToFString(Edited));
+
+	TestEqual(TEXT("Unchanged video m-line"), GetMLine(Edited, "video"), TEXT("m=video 9 UDP/TLS/RTP/SAVPF 96 97 98 99 100 101 35 36 102 125 127"));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastSdpEditorApplyTest, "Millicast.Publisher.SdpEditor.Apply",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMillicastSdpEditorApplyTest::RunTest(const FString& Parameters)
+{
+	FSdpCodecProfile Profile;
+	Profile.PreferredAudioFormat = "multiopus/48000/6";
+	Profile.AudioPtime = 40;
+	Profile.OpusMaxAverageBitrate = 128000;
+	Profile.bOpusDtx = false;
+	Profile.bOpusFec = true;
+	Profile.bOpusCbr = true;
+	Profile.bOpusStereo = true;
+	Profile.VideoStartBitrate = 2500;
+	Profile.VideoMaxBitrate = 8000;
+
+	FSdpEditor SdpEditor;
+	SdpEditor.Parse(kMultiopusOffer);
+	SdpEditor.Apply(Profile);
+
+	std::string Edited = SdpEditor.ToString();
+	TestEqual(TEXT("Audio m-line"), GetMLine(Edited, "audio"), TEXT("m=audio 9 UDP/TLS/RTP/SAVPF 114 111 115 116 110"));
+	TestTrue(TEXT("opus fmtp line"), Contains(Edited,
+		"a=fmtp:111 minptime=10;useinbandfec=1;maxaveragebitrate=128000;usedtx=0;cbr=1;stereo=1\r\n"));
+	TestTrue(TEXT("multiopus fmtp line, without stereo"), Contains(Edited,
+		"a=fmtp:114 channel_mapping=0,4,1,2,3,5;coupled_streams=2;minptime=10;num_streams=4;useinbandfec=1;maxaveragebitrate=128000;usedtx=0;cbr=1\r\n"));
+	TestFalse(TEXT("telephone-event fmtp line"), Contains(Edited, "a=fmtp:110 0-15;"));
+
+	// ptime is a media attribute, opus doesn't read it from the fmtp line
+	TestEqual(TEXT("a=ptime"), ToFString(SdpEditor.GetMediaAttribute("audio", "ptime").Get("")), TEXT("40"));
+	TestFalse(TEXT("ptime in the opus fmtp line"), SdpEditor.GetFmtpParameter("audio", "opus", "ptime").IsSet());
+	TestFalse(TEXT("ptime in an fmtp line"), Contains(Edited, "ptime=40"));
+	TestTrue(TEXT("a=ptime added to the audio section"), Contains(Edited, "a=ssrc:2004913717 cname:bX9s1VmmX3fNyS2T\r\na=ptime:40\r\n"));
+
+	// The bitrates go to the codecs, not to the formats protecting them
+	Profile.PreferredAudioFormat.clear();
+	SdpEditor.Parse(kOffer);
+	SdpEditor.Apply(Profile);
+	Edited = SdpEditor.ToString();
+
+	for (const char* Codec : { "VP8", "VP9", "H264", "AV1" })
+	{
+		TestEqual(FString::Printf(TEXT("%s start bitrate"), UTF8_TO_TCHAR(Codec)),
+			ToFString(SdpEditor.GetFmtpParameter("video", Codec, "x-google-start-bitrate").Get("")), TEXT("2500"));
+		TestEqual(FString::Printf(TEXT("%s max bitrate"), UTF8_TO_TCHAR(Codec)),
+			ToFString(SdpEditor.GetFmtpParameter("video", Codec, "x-google-max-bitrate").Get("")), TEXT("8000"));
+		TestFalse(FString::Printf(TEXT("%s min bitrate"), UTF8_TO_TCHAR(Codec)),
+			SdpEditor.GetFmtpParameter("video", Codec, "x-google-min-bitrate").IsSet());
+	}
+	for (const char* Codec : { "rtx", "red", "ulpfec" })
+	{
+		TestFalse(FString::Printf(TEXT("%s start bitrate"), UTF8_TO_TCHAR(Codec)),
+			SdpEditor.GetFmtpParameter("video", Codec, "x-google-start-bitrate").IsSet());
+	}
+	TestTrue(TEXT("VP8 fmtp line"), Contains(Edited, "a=rtpmap:96 VP8/90000\r\na=fmtp:96 x-google-start-bitrate=2500;x-google-max-bitrate=8000\r\n"));
+	TestTrue(TEXT("rtx fmtp line"), Contains(Edited, "a=fmtp:97 apt=96\r\n"));
+	TestTrue(TEXT("red has no fmtp line"), Contains(Edited, "a=rtpmap:102 red/90000\r\na=rtpmap:125 rtx/90000\r\n"));
+	TestTrue(TEXT("ulpfec has no fmtp line"), Contains(Edited, "a=rtpmap:127 ulpfec/90000\r\na=ssrc-group:"));
+
+	// Unset parameters leave the description alone
+	SdpEditor.Parse(kOffer);
+	SdpEditor.Apply(FSdpCodecProfile());
+	TestEqual(TEXT("Empty profile"), ToFString(SdpEditor.ToString()), ToFString(kOffer));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastSdpEditorAnswerTest, "Millicast.Publisher.SdpEditor.Answer",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMillicastSdpEditorAnswerTest::RunTest(const FString& Parameters)
+{
+	FSdpCodecProfile Profile;
+	Profile.PreferredAudioFormat = "multiopus/48000/6";
+	Profile.AudioPtime = 60;
+	Profile.OpusMaxAverageBitrate = 96000;
+	Profile.bOpusStereo = true;
+	Profile.VideoMinBitrate = 300;
+
+	FSdpEditor SdpEditor;
+	SdpEditor.Parse(kAnswer);
+	SdpEditor.ApplyCodecParameters(Profile);
+
+	const std::string Edited = SdpEditor.ToString();
+
+	// The formats the server chose stay
+	TestEqual(TEXT("Audio m-line"), GetMLine(Edited, "audio"), TEXT("m=audio 9 UDP/TLS/RTP/SAVPF 111"));
+	TestEqual(TEXT("Video m-line"), GetMLine(Edited, "video"), TEXT("m=video 9 UDP/TLS/RTP/SAVPF 100 101"));
+
+	// webrtc configures the encoders from these
+	TestTrue(TEXT("opus fmtp line"), Contains(Edited, "a=fmtp:111 minptime=10;useinbandfec=1;maxaveragebitrate=96000;stereo=1\r\n"));
+	TestTrue(TEXT("a=ptime replaced in place"), Contains(Edited, "a=fmtp:111 minptime=10;useinbandfec=1;maxaveragebitrate=96000;stereo=1\r\na=ptime:60\r\nm=video"));
+	TestFalse(TEXT("Previous a=ptime"), Contains(Edited, "a=ptime:20"));
+	TestTrue(TEXT("H264 fmtp line"), Contains(Edited,
+		"a=fmtp:100 level-asymmetry-allowed=1;packetization-mode=1;profile-level-id=42e01f;x-google-min-bitrate=300\r\n"));
+	TestTrue(TEXT("rtx fmtp line"), Contains(Edited, "a=fmtp:101 apt=100\r\n"));
+
+	// The data channel section has no attribute to edit
+	TestFalse(TEXT("a=ptime in the data channel section"), Contains(Edited, "a=sctp-port:5000\r\na=ptime"));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
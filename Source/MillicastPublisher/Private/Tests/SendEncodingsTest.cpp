@@ -0,0 +1,118 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "WebRTC/PeerConnection.h"
+#include "MillicastPublisherSource.h"
+
+#include "UObject/Package.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastSendEncodingsTest, "Millicast.Publisher.SendEncodings",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+namespace
+{
+	FMillicastSimulcastLayer MakeLayer(float ScaleResolutionDownBy, int32 MaxBitrate = 0)
+	{
+		FMillicastSimulcastLayer Layer;
+		Layer.ScaleResolutionDownBy = ScaleResolutionDownBy;
+		Layer.MaxBitrate = MaxBitrate;
+		return Layer;
+	}
+}
+
+bool FMillicastSendEncodingsTest::RunTest(const FString& Parameters)
+{
+	UMillicastPublisherSource* Source = NewObject<UMillicastPublisherSource>(GetTransientPackage());
+
+	TestEqual(TEXT("Default single encoding"), int32(FWebRTCPeerConnection::MakeSendEncodings(*Source).size()), 0);
+
+	// Lowest resolution first, the generated identifiers follow the order of the settings
+	Source->SimulcastLayers = { MakeLayer(1.f, 2500), MakeLayer(4.f), MakeLayer(2.f, 800) };
+
+	auto Encodings = FWebRTCPeerConnection::MakeSendEncodings(*Source);
+	if (TestEqual(TEXT("Simulcast encodings"), int32(Encodings.size()), 3))
+	{
+		const char* Rids[] = { "l1", "l2", "l0" };
+		const double Scales[] = { 4.0, 2.0, 1.0 };
+		const int MaxBitrates[] = { 0, 800000, 2500000 };
+
+		for (int32 Index = 0; Index < 3; ++Index)
+		{
+			TestEqual(FString::Printf(TEXT("Encoding %d rid"), Index), FString(UTF8_TO_TCHAR(Encodings[Index].rid.c_str())), FString(UTF8_TO_TCHAR(Rids[Index])));
+			TestEqual(FString::Printf(TEXT("Encoding %d scale"), Index), Encodings[Index].scale_resolution_down_by.value_or(0.0), Scales[Index]);
+			TestEqual(FString::Printf(TEXT("Encoding %d max bitrate"), Index), Encodings[Index].max_bitrate_bps.value_or(0), MaxBitrates[Index]);
+		}
+	}
+
+	// A single layer isn't simulcast
+	Source->SimulcastLayers = { MakeLayer(2.f) };
+	Encodings = FWebRTCPeerConnection::MakeSendEncodings(*Source);
+	if (TestEqual(TEXT("Single layer encodings"), int32(Encodings.size()), 1))
+	{
+		TestTrue(TEXT("Single layer without rid"), Encodings[0].rid.empty());
+	}
+
+#if WEBRTC_VERSION >= 96
+	Source->SimulcastLayers.Empty();
+	Source->ScalabilityMode = VideoScalabilityMode::SCALABILITY_L1T3;
+	Encodings = FWebRTCPeerConnection::MakeSendEncodings(*Source);
+	if (TestEqual(TEXT("Scalable encoding"), int32(Encodings.size()), 1))
+	{
+		TestEqual(TEXT("Scalability mode"), FString(UTF8_TO_TCHAR(Encodings[0].scalability_mode.value_or("").c_str())), FString(TEXT("L1T3")));
+	}
+
+	Source->SimulcastLayers = { MakeLayer(2.f) };
+	Source->ScalabilityMode = VideoScalabilityMode::SCALABILITY_L3T3;
+	Encodings = FWebRTCPeerConnection::MakeSendEncodings(*Source);
+	if (TestEqual(TEXT("Scaled scalable encoding"), int32(Encodings.size()), 1))
+	{
+		TestEqual(TEXT("Scalability mode of the layer"), FString(UTF8_TO_TCHAR(Encodings[0].scalability_mode.value_or("").c_str())), FString(TEXT("L3T3")));
+		TestEqual(TEXT("Scale of the layer"), Encodings[0].scale_resolution_down_by.value_or(0.0), 2.0);
+	}
+
+	// Simulcast wins over the scalability mode
+	AddExpectedError(TEXT("is ignored with 2 simulcast layers"), EAutomationExpectedErrorFlags::Contains, 1);
+	Source->SimulcastLayers = { MakeLayer(1.f), MakeLayer(2.f) };
+	Encodings = FWebRTCPeerConnection::MakeSendEncodings(*Source);
+	if (TestEqual(TEXT("Simulcast encodings with a scalability mode"), int32(Encodings.size()), 2))
+	{
+		TestFalse(TEXT("Scalability mode of the first layer"), Encodings[0].scalability_mode.has_value());
+		TestFalse(TEXT("Scalability mode of the second layer"), Encodings[1].scalability_mode.has_value());
+	}
+
+	// The encoding is taken as is by the video transceiver, with VP9 negotiated first
+	Source->SimulcastLayers.Empty();
+	Source->ScalabilityMode = VideoScalabilityMode::SCALABILITY_L1T3;
+
+	FWebRTCPeerConnection* PeerConnection = FWebRTCPeerConnection::Create(FWebRTCPeerConnection::GetDefaultConfig());
+
+	webrtc::RtpTransceiverInit Init;
+	Init.direction = webrtc::RtpTransceiverDirection::kSendOnly;
+	Init.send_encodings = FWebRTCPeerConnection::MakeSendEncodings(*Source);
+
+	auto Transceiver = (*PeerConnection)->AddTransceiver(cricket::MEDIA_TYPE_VIDEO, Init);
+	if (TestTrue(TEXT("Add the scalable video transceiver"), Transceiver.ok()))
+	{
+		const auto Codecs = FWebRTCPeerConnection::GetVideoCodecPreferences({ VIDEO_VP9 });
+		if (!Codecs.empty())
+		{
+			TestTrue(TEXT("Prefer VP9"), Transceiver.value()->SetCodecPreferences(Codecs).ok());
+		}
+
+		const auto SendParameters = Transceiver.value()->sender()->GetParameters();
+		if (TestEqual(TEXT("Sender encodings"), int32(SendParameters.encodings.size()), 1))
+		{
+			TestEqual(TEXT("Sender scalability mode"), FString(UTF8_TO_TCHAR(SendParameters.encodings[0].scalability_mode.value_or("").c_str())), FString(TEXT("L1T3")));
+		}
+	}
+
+	delete PeerConnection;
+#endif
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,175 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "WebRTC/PeerConnection.h"
+
+#include <algorithm>
+#include <sstream>
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastVideoCodecPreferencesTest, "Millicast.Publisher.VideoCodecPreferences",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+namespace
+{
+	/** Offer created on the signaling thread, which may outlive the test if it times out */
+	struct FOfferResult
+	{
+		FEvent* Done = FPlatformProcess::GetSynchEventFromPool();
+		std::string Sdp;
+		std::string Error;
+
+		~FOfferResult()
+		{
+			FPlatformProcess::ReturnSynchEventToPool(Done);
+		}
+	};
+
+	bool IsProtectionCodec(const std::string& Codec)
+	{
+		return Codec == cricket::kRtxCodecName || Codec == cricket::kRedCodecName
+			|| Codec == cricket::kUlpfecCodecName || Codec == cricket::kFlexfecCodecName;
+	}
+
+	/** Codecs of the m=video line in their order, the formats of a codec which follow each other counted once */
+	TArray<FString> GetOfferedVideoCodecs(const std::string& Sdp, bool& bProtectionLast)
+	{
+		TMap<FString, FString> CodecByPayloadType;
+		TArray<FString> PayloadTypes;
+
+		std::istringstream Stream(Sdp);
+		std::string Line;
+		bool bInVideo = false;
+		while (std::getline(Stream, Line))
+		{
+			if (!Line.empty() && Line.back() == '\r')
+			{
+				Line.pop_back();
+			}
+
+			if (Line.compare(0, 2, "m=") == 0)
+			{
+				bInVideo = Line.compare(0, 8, "m=video ") == 0;
+				if (bInVideo)
+				{
+					// m=video <port> <proto> <payload types>
+					FString(UTF8_TO_TCHAR(Line.c_str())).ParseIntoArrayWS(PayloadTypes);
+					PayloadTypes.RemoveAt(0, 3);
+				}
+			}
+			else if (bInVideo && Line.compare(0, 9, "a=rtpmap:") == 0)
+			{
+				// a=rtpmap:<payload type> <codec>/<clock rate>
+				const auto Space = Line.find(' ');
+				CodecByPayloadType.Add(UTF8_TO_TCHAR(Line.substr(9, Space - 9).c_str()),
+					UTF8_TO_TCHAR(Line.substr(Space + 1, Line.find('/', Space) - Space - 1).c_str()));
+			}
+		}
+
+		TArray<FString> Codecs;
+		bProtectionLast = true;
+		bool bProtectionSeen = false;
+		for (const FString& PayloadType : PayloadTypes)
+		{
+			const FString Codec = CodecByPayloadType.FindRef(PayloadType);
+			if (IsProtectionCodec(TCHAR_TO_UTF8(*Codec)))
+			{
+				bProtectionSeen = true;
+				continue;
+			}
+
+			bProtectionLast &= !bProtectionSeen;
+			if (Codecs.Num() == 0 || Codecs.Last() != Codec)
+			{
+				Codecs.Add(Codec);
+			}
+		}
+		return Codecs;
+	}
+}
+
+bool FMillicastVideoCodecPreferencesTest::RunTest(const FString& Parameters)
+{
+	static const char* CodecNames[] = { cricket::kVp8CodecName, cricket::kVp9CodecName, cricket::kH264CodecName, cricket::kAv1CodecName };
+
+	const TArray<TEnumAsByte<VideoCodecType>> Preferences[] = {
+		{ VIDEO_H264, VIDEO_VP8 },
+		{ VIDEO_AV1, VIDEO_VP9, VIDEO_VP8, VIDEO_H264 },
+		{ VIDEO_VP9 },
+		{ VIDEO_VP8, VIDEO_VP8, VIDEO_H264 },
+	};
+
+	const auto Capabilities = FWebRTCPeerConnection::GetPeerConnectionFactory()->GetRtpSenderCapabilities(cricket::MEDIA_TYPE_VIDEO);
+	auto IsAvailable = [&Capabilities](const char* Codec) {
+		return std::any_of(Capabilities.codecs.begin(), Capabilities.codecs.end(), [Codec](const auto& Capability) { return Capability.name == Codec; });
+	};
+
+	for (const auto& PreferredCodecs : Preferences)
+	{
+		// The codecs of the m-line, the ones which aren't built in skipped
+		TArray<FString> Expected;
+		for (const auto& Codec : PreferredCodecs)
+		{
+			const FString Name = UTF8_TO_TCHAR(CodecNames[Codec.GetValue()]);
+			if (IsAvailable(CodecNames[Codec.GetValue()]) && !Expected.Contains(Name))
+			{
+				Expected.Add(Name);
+			}
+		}
+
+		const FString Description = FString::Join(Expected, TEXT(", "));
+
+		const auto Codecs = FWebRTCPeerConnection::GetVideoCodecPreferences(PreferredCodecs);
+		if (Expected.Num() == 0)
+		{
+			TestTrue(TEXT("No codec preference without an available codec"), Codecs.empty());
+			continue;
+		}
+
+		FWebRTCPeerConnection* PeerConnection = FWebRTCPeerConnection::Create(FWebRTCPeerConnection::GetDefaultConfig());
+
+		webrtc::RtpTransceiverInit Init;
+		Init.direction = webrtc::RtpTransceiverDirection::kSendOnly;
+
+		auto Transceiver = (*PeerConnection)->AddTransceiver(cricket::MEDIA_TYPE_VIDEO, Init);
+		if (!TestTrue(TEXT("Add the video transceiver"), Transceiver.ok()))
+		{
+			delete PeerConnection;
+			return false;
+		}
+
+		const auto Error = Transceiver.value()->SetCodecPreferences(Codecs);
+		TestTrue(FString::Printf(TEXT("%s: set the codec preferences (%S)"), *Description, Error.message()), Error.ok());
+
+		auto Offer = MakeShared<FOfferResult, ESPMode::ThreadSafe>();
+		PeerConnection->GetCreateDescriptionObserver()->SetOnSuccessCallback([Offer](const std::string& Type, const std::string& Sdp) {
+			Offer->Sdp = Sdp;
+			Offer->Done->Trigger();
+		});
+		PeerConnection->GetCreateDescriptionObserver()->SetOnFailureCallback([Offer](const std::string& Error) {
+			Offer->Error = Error;
+			Offer->Done->Trigger();
+		});
+		PeerConnection->CreateOffer();
+
+		const bool bCreated = Offer->Done->Wait(FTimespan::FromSeconds(10.0));
+		delete PeerConnection;
+
+		if (!TestTrue(FString::Printf(TEXT("%s: create the offer %S"), *Description, Offer->Error.c_str()), bCreated && Offer->Error.empty()))
+		{
+			continue;
+		}
+
+		bool bProtectionLast = false;
+		const TArray<FString> Offered = GetOfferedVideoCodecs(Offer->Sdp, bProtectionLast);
+
+		TestEqual(FString::Printf(TEXT("%s: codecs of the m-line"), *Description), FString::Join(Offered, TEXT(", ")), Description);
+		TestTrue(FString::Printf(TEXT("%s: retransmission and error correction formats after the codecs"), *Description), bProtectionLast);
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
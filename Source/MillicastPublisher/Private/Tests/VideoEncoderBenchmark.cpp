@@ -0,0 +1,212 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "WebRTC/WebRTCInc.h"
+
+#include <algorithm>
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMillicastVideoEncoderBenchmark, "Millicast.Publisher.Benchmark.VideoEncoders",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+namespace
+{
+	constexpr int32 kFramerate = 30;
+	constexpr int32 kBitrateKbps = 2500;
+
+	/** Counts what the encoder outputs. The software encoders output a frame before Encode returns */
+	class FEncodedImageCounter : public webrtc::EncodedImageCallback
+	{
+	public:
+		int32 NumFrames = 0;
+		int64 NumBytes = 0;
+
+#if WEBRTC_VERSION >= 96
+		Result OnEncodedImage(const webrtc::EncodedImage& EncodedImage, const webrtc::CodecSpecificInfo* CodecSpecificInfo) override
+#else
+		Result OnEncodedImage(const webrtc::EncodedImage& EncodedImage, const webrtc::CodecSpecificInfo* CodecSpecificInfo,
+			const webrtc::RTPFragmentationHeader* Fragmentation) override
+#endif
+		{
+			++NumFrames;
+			NumBytes += EncodedImage.size();
+			return Result(Result::OK);
+		}
+	};
+
+	/** Single layer realtime settings, as the publisher sends a single stream per codec */
+	webrtc::VideoCodec MakeCodecSettings(webrtc::VideoCodecType CodecType, FIntPoint Resolution)
+	{
+		webrtc::VideoCodec Codec;
+		Codec.codecType = CodecType;
+		Codec.width = Resolution.X;
+		Codec.height = Resolution.Y;
+		Codec.startBitrate = kBitrateKbps;
+		Codec.maxBitrate = kBitrateKbps;
+		Codec.minBitrate = 100;
+		Codec.maxFramerate = kFramerate;
+		Codec.qpMax = 56;
+		Codec.numberOfSimulcastStreams = 1;
+		Codec.mode = webrtc::VideoCodecMode::kRealtimeVideo;
+
+		switch (CodecType)
+		{
+		case webrtc::kVideoCodecVP8:
+			*Codec.VP8() = webrtc::VideoEncoder::GetDefaultVp8Settings();
+			break;
+		case webrtc::kVideoCodecVP9:
+			*Codec.VP9() = webrtc::VideoEncoder::GetDefaultVp9Settings();
+			break;
+		case webrtc::kVideoCodecH264:
+			*Codec.H264() = webrtc::VideoEncoder::GetDefaultH264Settings();
+			break;
+		default:
+			break;
+		}
+
+		webrtc::SpatialLayer& Layer = Codec.simulcastStream[0];
+		Layer.width = Resolution.X;
+		Layer.height = Resolution.Y;
+		Layer.maxFramerate = kFramerate;
+		Layer.numberOfTemporalLayers = 1;
+		Layer.maxBitrate = kBitrateKbps;
+		Layer.targetBitrate = kBitrateKbps;
+		Layer.minBitrate = 100;
+		Layer.qpMax = Codec.qpMax;
+		Layer.active = true;
+
+		// VP9 takes its single layer from the spatial layers
+		if (CodecType == webrtc::kVideoCodecVP9)
+		{
+			Codec.spatialLayers[0] = Layer;
+		}
+
+		return Codec;
+	}
+
+	/** Synthetic frame moving every frame, so the encoder has motion to search and residuals to code */
+	rtc::scoped_refptr<webrtc::I420Buffer> MakeFrame(FIntPoint Resolution, int32 Index)
+	{
+		rtc::scoped_refptr<webrtc::I420Buffer> Buffer = webrtc::I420Buffer::Create(Resolution.X, Resolution.Y);
+
+		for (int32 Y = 0; Y < Resolution.Y; ++Y)
+		{
+			uint8* Row = Buffer->MutableDataY() + Y * Buffer->StrideY();
+			for (int32 X = 0; X < Resolution.X; ++X)
+			{
+				Row[X] = uint8((X + 4 * Index) ^ (Y + 2 * Index)) + uint8((X * Y) >> 9);
+			}
+		}
+
+		for (int32 Y = 0; Y < Buffer->ChromaHeight(); ++Y)
+		{
+			uint8* RowU = Buffer->MutableDataU() + Y * Buffer->StrideU();
+			uint8* RowV = Buffer->MutableDataV() + Y * Buffer->StrideV();
+			for (int32 X = 0; X < Buffer->ChromaWidth(); ++X)
+			{
+				RowU[X] = uint8(128 + (X + Index) % 64);
+				RowV[X] = uint8(128 - (Y + Index) % 64);
+			}
+		}
+
+		return Buffer;
+	}
+}
+
+bool FMillicastVideoEncoderBenchmark::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumFrames = 60;
+	const FIntPoint Resolutions[] = { { 1280, 720 }, { 1920, 1080 } };
+	const char* CodecNames[] = { cricket::kVp8CodecName, cricket::kVp9CodecName, cricket::kH264CodecName, cricket::kAv1CodecName };
+
+	// The factory the peer connections are created with
+	std::unique_ptr<webrtc::VideoEncoderFactory> Factory = webrtc::CreateBuiltinVideoEncoderFactory();
+	const std::vector<webrtc::SdpVideoFormat> Formats = Factory->GetSupportedFormats();
+
+	const webrtc::VideoEncoder::Settings EncoderSettings(webrtc::VideoEncoder::Capabilities(false), FPlatformMisc::NumberOfCores(), 1200);
+
+	for (const char* CodecName : CodecNames)
+	{
+		// The first format of a codec is the one offered first, e.g. the H264 profile preferred
+		const auto Format = std::find_if(Formats.begin(), Formats.end(), [CodecName](const webrtc::SdpVideoFormat& Candidate) {
+			return Candidate.name == CodecName;
+		});
+
+		if (Format == Formats.end())
+		{
+			AddInfo(FString::Printf(TEXT("%S: not built in, skipped"), CodecName));
+			continue;
+		}
+
+		for (const FIntPoint& Resolution : Resolutions)
+		{
+			std::unique_ptr<webrtc::VideoEncoder> Encoder = Factory->CreateVideoEncoder(*Format);
+			if (!TestTrue(FString::Printf(TEXT("%S: create the encoder"), CodecName), Encoder != nullptr))
+			{
+				break;
+			}
+
+			const webrtc::VideoCodec Codec = MakeCodecSettings(webrtc::PayloadStringToCodecType(CodecName), Resolution);
+			const int32 InitResult = Encoder->InitEncode(&Codec, EncoderSettings);
+			if (!TestEqual(FString::Printf(TEXT("%S %dx%d: initialize the encoder"), CodecName, Resolution.X, Resolution.Y),
+				InitResult, int32(WEBRTC_VIDEO_CODEC_OK)))
+			{
+				continue;
+			}
+
+			FEncodedImageCounter Counter;
+			Encoder->RegisterEncodeCompleteCallback(&Counter);
+
+			webrtc::VideoBitrateAllocation Allocation;
+			Allocation.SetBitrate(0, 0, kBitrateKbps * 1000);
+			Encoder->SetRates(webrtc::VideoEncoder::RateControlParameters(Allocation, kFramerate));
+
+			// Generated beforehand, only the encoding is timed
+			TArray<webrtc::VideoFrame> Frames;
+			for (int32 Index = 0; Index < NumFrames; ++Index)
+			{
+				Frames.Add(webrtc::VideoFrame::Builder()
+					.set_video_frame_buffer(MakeFrame(Resolution, Index))
+					.set_timestamp_rtp(Index * (90000 / kFramerate))
+					.set_timestamp_us(Index * (rtc::kNumMicrosecsPerSec / kFramerate))
+					.set_rotation(webrtc::kVideoRotation_0)
+					.build());
+			}
+
+			// The first frame is a key frame, the others are left to the encoder
+			const std::vector<webrtc::VideoFrameType> KeyFrame = { webrtc::VideoFrameType::kVideoFrameKey };
+
+			double TotalMs = 0.0;
+			double KeyFrameMs = 0.0;
+			for (int32 Index = 0; Index < NumFrames; ++Index)
+			{
+				const double Start = FPlatformTime::Seconds();
+				Encoder->Encode(Frames[Index], Index == 0 ? &KeyFrame : nullptr);
+				const double FrameMs = (FPlatformTime::Seconds() - Start) * 1000.0;
+
+				if (Index == 0)
+				{
+					KeyFrameMs = FrameMs;
+				}
+				else
+				{
+					TotalMs += FrameMs;
+				}
+			}
+
+			Encoder->Release();
+
+			TestTrue(FString::Printf(TEXT("%S %dx%d: frames encoded"), CodecName, Resolution.X, Resolution.Y), Counter.NumFrames > 0);
+
+			AddInfo(FString::Printf(TEXT("%S %dx%d: %.2f ms per frame, %.2f ms for the key frame, %d of %d frames encoded, %.0f kbps"),
+				CodecName, Resolution.X, Resolution.Y, TotalMs / (NumFrames - 1), KeyFrameMs, Counter.NumFrames, NumFrames,
+				Counter.NumBytes * 8.0 * kFramerate / NumFrames / 1000.0));
+		}
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
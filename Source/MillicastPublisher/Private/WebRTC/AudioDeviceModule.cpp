@@ -2,7 +2,20 @@
 
 #include "AudioDeviceModule.h"
 #include "MillicastPublisherPrivate.h"
-#include "common_audio/include/audio_util.h"
+#include "AudioDownmix.h"
+
+static TAutoConsoleVariable<int32> CVarMillicastAudioDeliveryMode(
+	TEXT("Millicast.Publisher.AudioDeliveryMode"),
+	1,
+	TEXT("How the captured audio is handed to webrtc. 0: every 10 ms by a timer, 1: as soon as a 10 ms block is captured. ")
+	TEXT("Takes effect on the next recording."),
+	ECVF_Default);
+
+/** Lanes which received no audio for this long don't hold back the delivery of the others */
+static constexpr int64 kStalledLaneUs = 100 * rtc::kNumMicrosecsPerMillisec;
+
+/** A timer late by more than this many blocks skips ahead instead of catching up */
+static constexpr int32 kMaxCatchUpBlocks = 10;
 
 const char FAudioDeviceModule::kTimerQueueName[] = "FAudioDeviceModuleTimer";
 
@@ -11,8 +24,22 @@ FAudioDeviceModule::FAudioDeviceModule(webrtc::TaskQueueFactory* TaskQueueFactor
 	bIsRecordingInitialized(false),
 	bIsStarted(false),
 	NextFrameTime(0),
+	NumChannels(kDefaultNumberOfChannels),
+	bPushDelivery(false),
+	bDeliveryScheduled(false),
+	LastDeliveryTimeUs(0),
+	BlocksDelivered(0),
+	MaxBlocksPerWake(0),
+	JitterMs(0.f),
+	MaxJitterMs(0.f),
 	TaskQueue(TaskQueueFactory->CreateTaskQueue(kTimerQueueName, webrtc::TaskQueueFactory::Priority::NORMAL))
 {
+	static_assert(FAudioInputLane::kSampleRate == kSamplesPerSecond && FAudioInputLane::kBlockFrames == int32(kNumberSamples),
+		"Input lanes must pop the blocks sent to webrtc");
+
+	LaneBuffer.SetNumZeroed(kNumberSamples * kMaxNumberOfChannels);
+	MixBuffer.SetNumZeroed(kNumberSamples * kMaxNumberOfChannels);
+	SendBuffer.SetNumZeroed(kNumberSamples * kMaxNumberOfChannels);
 	AudioTransport = nullptr;
 }
 
@@ -122,9 +149,23 @@ int32_t FAudioDeviceModule::StartRecording()
 		return 0;
 	}
 
+	FScopeLock Lock(&CriticalSection);
+
 	bIsRecording = true;
+	bPushDelivery = CVarMillicastAudioDeliveryMode.GetValueOnAnyThread() == 1;
+	LastDeliveryTimeUs = 0;
+
+	// Without a timer pacing the blocks, there's no other clock to compensate the drift against
+	for (const TSharedPtr<FAudioInputLane, ESPMode::ThreadSafe>& Lane : InputLanes)
+	{
+		Lane->SetDriftCompensationAllowed(!bPushDelivery);
+		Lane->SetActive(true);
+	}
 
-	TaskQueue.PostTask([this]() { Send(); });
+	if (!bPushDelivery)
+	{
+		TaskQueue.PostTask([this]() { Send(); });
+	}
 
 	return 0;
 }
@@ -136,9 +177,16 @@ int32_t FAudioDeviceModule::StopRecording()
 		return 0;
 	}
 
+	FScopeLock Lock(&CriticalSection);
+
 	bIsRecording = false;
 	bIsStarted = false;
 
+	for (const TSharedPtr<FAudioInputLane, ESPMode::ThreadSafe>& Lane : InputLanes)
+	{
+		Lane->SetActive(false);
+	}
+
 	return 0;
 }
 
@@ -208,7 +256,7 @@ int32 FAudioDeviceModule::SetStereoRecording(bool enable)
 
 int32 FAudioDeviceModule::StereoRecording(bool* enabled) const
 {
-	*enabled = true;
+	*enabled = GetNumChannels() > 1;
 	return 0;
 }
 
@@ -218,44 +266,83 @@ int32_t FAudioDeviceModule::PlayoutDelay(uint16_t* delay_ms) const
 	return 0;
 }
 
-void FAudioDeviceModule::SendAudioData(const float* AudioData, int32 NumSamples, int32 NumChannels, const int32 SampleRate)
+bool FAudioDeviceModule::SetNumChannels(int32 InNumChannels)
 {
-	if (!bIsRecordingInitialized)
+	if (InNumChannels != 1 && InNumChannels != 2 && InNumChannels != 6 && InNumChannels != 8)
 	{
-		UE_LOG(LogMillicastPublisher, Warning, TEXT("AudioDeviceModule has not been iniatilized"));
-		return;
+		UE_LOG(LogMillicastPublisher, Warning, TEXT("AudioDeviceModule doesn't support %d channels"), InNumChannels);
+		return false;
 	}
 
-	if (kSamplesPerSecond != SampleRate)
+	FScopeLock Lock(&CriticalSection);
+
+	if (InNumChannels == NumChannels)
 	{
-		UE_LOG(LogMillicastPublisher, Warning, TEXT("AudioDeviceModule supports only %d Hz"), kSamplesPerSecond);
-		return;
+		return true;
 	}
 
-	Audio::TSampleBuffer<float> Buffer(AudioData, NumSamples, NumChannels, SampleRate);
-	if (Buffer.GetNumChannels() != kNumberOfChannels)
+	if (InputLanes.Num() > 0)
 	{
-		Buffer.MixBufferToChannels(kNumberOfChannels);
+		UE_LOG(LogMillicastPublisher, Warning, TEXT("Audio is already captured with %d channels, it can't be changed to %d"),
+			NumChannels.load(), InNumChannels);
+		return false;
 	}
-	
-	const float* Data = Buffer.GetData();
 
-	{
-		FScopeLock Lock(&CriticalSection);
-		const auto num = AudioBuffer.Num();
-		AudioBuffer.AddZeroed(Buffer.GetNumSamples());
+	NumChannels = InNumChannels;
+	return true;
+}
+
+int32 FAudioDeviceModule::GetNumChannels() const
+{
+	return NumChannels;
+}
+
+TSharedPtr<FAudioInputLane, ESPMode::ThreadSafe> FAudioDeviceModule::AddInputLane()
+{
+	FScopeLock Lock(&CriticalSection);
+
+	auto Lane = MakeShared<FAudioInputLane, ESPMode::ThreadSafe>(NumChannels.load());
+	Lane->SetDriftCompensationAllowed(!bPushDelivery);
+	Lane->SetActive(bIsRecording);
+	InputLanes.Add(Lane);
+
+	return Lane;
+}
+
+void FAudioDeviceModule::RemoveInputLane(const TSharedPtr<FAudioInputLane, ESPMode::ThreadSafe>& Lane)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	Lane->SetActive(false);
+	InputLanes.Remove(Lane);
+}
 
-		webrtc::FloatToS16(AudioData, Buffer.GetNumSamples(), AudioBuffer.GetData() + num);
+void FAudioDeviceModule::OnInputLaneReady()
+{
+	// One task delivers every block complete by then, the capture thread never waits for the task queue
+	if (bIsRecording && bPushDelivery && !bDeliveryScheduled.exchange(true))
+	{
+		TaskQueue.PostTask([this]() { DeliverPendingBlocks(); });
 	}
 }
 
+FAudioDeviceModule::FDeliveryStats FAudioDeviceModule::GetDeliveryStats() const
+{
+	FDeliveryStats Stats;
+	Stats.BlocksDelivered = BlocksDelivered;
+	Stats.MaxBlocksPerWake = MaxBlocksPerWake;
+	Stats.JitterMs = JitterMs;
+	Stats.MaxJitterMs = MaxJitterMs;
+	return Stats;
+}
+
 void FAudioDeviceModule::Send()
 {
 	RTC_DCHECK_RUN_ON(&TaskQueue);
 	{
 		FScopeLock Lock(&CriticalSection);
 
-		if (bIsRecording)
+		if (bIsRecording && !bPushDelivery)
 		{
 			if (!bIsStarted)
 			{
@@ -263,18 +350,138 @@ void FAudioDeviceModule::Send()
 				bIsStarted = true;
 			}
 
-			if (AudioBuffer.Num() >= kNumberSamples * kNumberOfChannels)
+			// Every block due is sent, so a late wake doesn't add latency for good
+			const int64_t current_time = rtc::TimeMillis();
+			int32 NumBlocks = 0;
+			while (NextFrameTime <= current_time && NumBlocks < kMaxCatchUpBlocks)
 			{
-				uint32_t micLevel = 0;
-				AudioTransport->RecordedDataIsAvailable(AudioBuffer.GetData(), kNumberSamples, sizeof(Sample),
-					kNumberOfChannels, kSamplesPerSecond, 0, 0, micLevel, false, micLevel);
-				AudioBuffer.RemoveAt(0, kNumberSamples * kNumberOfChannels, true);
+				SendBlock();
+				NextFrameTime += kTimePerFrameMs;
+				++NumBlocks;
 			}
-			NextFrameTime += kTimePerFrameMs;
-			const int64_t current_time = rtc::TimeMillis();
-			const int64_t wait_time =
-				(NextFrameTime > current_time) ? NextFrameTime - current_time : 0;
+			RecordWake(NumBlocks);
+
+			if (NextFrameTime <= current_time)
+			{
+				NextFrameTime = current_time + kTimePerFrameMs;
+			}
+
+			const int64_t wait_time = NextFrameTime - current_time;
 			TaskQueue.PostDelayedTask([this]() { Send(); }, int32_t(wait_time));
 		}
 	}
 }
+
+void FAudioDeviceModule::DeliverPendingBlocks()
+{
+	RTC_DCHECK_RUN_ON(&TaskQueue);
+
+	// Cleared first, a block completed while delivering schedules another task
+	bDeliveryScheduled = false;
+
+	FScopeLock Lock(&CriticalSection);
+
+	if (!bIsRecording || !bPushDelivery)
+	{
+		return;
+	}
+
+	int32 NumBlocks = 0;
+	while (AreInputLanesReady())
+	{
+		SendBlock();
+		++NumBlocks;
+	}
+	RecordWake(NumBlocks);
+}
+
+bool FAudioDeviceModule::AreInputLanesReady() const
+{
+	const int64 Now = rtc::TimeMicros();
+
+	bool bHasBlock = false;
+	for (const TSharedPtr<FAudioInputLane, ESPMode::ThreadSafe>& Lane : InputLanes)
+	{
+		if (Lane->HasBlock())
+		{
+			bHasBlock = true;
+		}
+		else if (Now - Lane->GetLastPushTimeUs() < kStalledLaneUs)
+		{
+			// Its next block is coming, it would underrun if the others were mixed now
+			return false;
+		}
+	}
+
+	return bHasBlock;
+}
+
+bool FAudioDeviceModule::SendBlock()
+{
+	if (!MixInputLanes())
+	{
+		return false;
+	}
+
+	if (AudioTransport)
+	{
+		uint32_t micLevel = 0;
+		AudioTransport->RecordedDataIsAvailable(SendBuffer.GetData(), kNumberSamples, sizeof(Sample) * NumChannels,
+			NumChannels, kSamplesPerSecond, 0, 0, micLevel, false, micLevel);
+	}
+
+	const int64 Now = rtc::TimeMicros();
+	if (LastDeliveryTimeUs != 0)
+	{
+		const float Deviation = FMath::Abs(float(Now - LastDeliveryTimeUs) / rtc::kNumMicrosecsPerMillisec - kTimePerFrameMs);
+		JitterMs = JitterMs + (Deviation - JitterMs) / 16.f;
+		MaxJitterMs = FMath::Max<float>(MaxJitterMs, Deviation);
+	}
+	LastDeliveryTimeUs = Now;
+
+	BlocksDelivered.fetch_add(1, std::memory_order_relaxed);
+
+	return true;
+}
+
+void FAudioDeviceModule::RecordWake(int32 NumBlocks)
+{
+	if (uint32(NumBlocks) > MaxBlocksPerWake)
+	{
+		MaxBlocksPerWake = uint32(NumBlocks);
+	}
+}
+
+bool FAudioDeviceModule::MixInputLanes()
+{
+	// A single lane at unity gain is sent as is, without going through the float mix
+	if (InputLanes.Num() == 1 && InputLanes[0]->GetGain() == 1.f && !InputLanes[0]->IsMuted())
+	{
+		return InputLanes[0]->PopBlock(SendBuffer.GetData());
+	}
+
+	const int32 BlockSamples = kNumberSamples * NumChannels;
+	FMemory::Memzero(MixBuffer.GetData(), BlockSamples * sizeof(float));
+
+	// Every lane is consumed, even muted or late ones, so none of them builds up latency
+	bool bHasAudio = false;
+	for (const TSharedPtr<FAudioInputLane, ESPMode::ThreadSafe>& Lane : InputLanes)
+	{
+		if (Lane->PopBlock(LaneBuffer.GetData()))
+		{
+			if (!Lane->IsMuted())
+			{
+				AudioDownmix::AccumulateS16(LaneBuffer.GetData(), BlockSamples, Lane->GetGain(), MixBuffer.GetData());
+			}
+			bHasAudio = true;
+		}
+	}
+
+	if (bHasAudio)
+	{
+		// Converted with saturation, lanes adding up above full scale are clipped
+		AudioDownmix::RemixS16(MixBuffer.GetData(), kNumberSamples, NumChannels, NumChannels, SendBuffer.GetData());
+	}
+
+	return bHasAudio;
+}
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "WebRTC/WebRTCInc.h"
+#include "WebRTC/AudioInputLane.h"
 #include "AudioDevice.h"
 
 #include "Sound/SoundWaveProcedural.h"
@@ -15,14 +16,13 @@ class FAudioDeviceModule : public webrtc::AudioDeviceModule
 
 	/** Audio device module constants */
 	static constexpr int kTimePerFrameMs = 10;
-	static constexpr uint8_t kNumberOfChannels = 2;
+	static constexpr int kDefaultNumberOfChannels = 2;
+	static constexpr int kMaxNumberOfChannels = FAudioInputLane::kMaxNumChannels;
 	static constexpr int kSamplesPerSecond = 48000;
 	static constexpr int kTotalDelayMs = 0;
 	static constexpr int kClockDriftMs = 0;
 	static constexpr uint32_t kMaxVolume = 14392;
 	static constexpr size_t kNumberSamples = kTimePerFrameMs * kSamplesPerSecond / 1000;
-	static constexpr size_t kNumberBytesPerSample = sizeof(Sample) * kNumberOfChannels;
-	static constexpr size_t kBytesPerBuffer = kNumberBytesPerSample * kNumberSamples;
 
 	static const char kTimerQueueName[];
 
@@ -34,7 +34,37 @@ public:
 	static rtc::scoped_refptr<FAudioDeviceModule> Create(webrtc::TaskQueueFactory * queue_factory);
 
 public:
-	void SendAudioData(const float* AudioData, int32 NumSamples, int32 NumChannels, const int32 SampleRate);
+	/**
+	* Set the number of channels sent to webrtc: 1, 2, 6 for 5.1 or 8 for 7.1, in the engine channel order.
+	* It's shared by all the audio sources, so it can only change while no source is capturing. Returns false if it didn't.
+	*/
+	bool SetNumChannels(int32 InNumChannels);
+	int32 GetNumChannels() const;
+
+	/**
+	* Create a lane whose audio is mixed in the audio sent to webrtc, until it's removed.
+	* Every audio source has its own lane, so the sources are mixed rather than interleaved in the same buffer.
+	*/
+	TSharedPtr<FAudioInputLane, ESPMode::ThreadSafe> AddInputLane();
+	void RemoveInputLane(const TSharedPtr<FAudioInputLane, ESPMode::ThreadSafe>& Lane);
+
+	/**
+	* Called by the audio sources once their lane has a complete 10 ms block.
+	* With push delivery, the blocks are mixed and handed to webrtc as soon as every lane has one.
+	*/
+	void OnInputLaneReady();
+
+	/** Delivery counters, shared by all the lanes */
+	struct FDeliveryStats
+	{
+		uint32 BlocksDelivered = 0;
+		uint32 MaxBlocksPerWake = 0; // Most 10 ms blocks delivered at once, catching up after a late wake
+		float JitterMs = 0.f;        // Smoothed deviation of the interval between two blocks from 10 ms, as the RFC 3550 jitter
+		float MaxJitterMs = 0.f;     // Largest deviation of the interval between two blocks from 10 ms
+	};
+
+	/** Get the delivery counters. Can be called from any thread */
+	FDeliveryStats GetDeliveryStats() const;
 
 public:
 	// webrtc::AudioDeviceModule interface
@@ -188,16 +218,55 @@ public:
 private:
 	void Send();
 
+	/** Deliver every block complete in every lane, on the task queue. Used by push delivery */
+	void DeliverPendingBlocks();
+
+	/** Whether every lane still receiving audio has a complete block */
+	bool AreInputLanesReady() const;
+
+	/** Mix a 10 ms block of every lane and hand it to webrtc. Returns false if no lane had audio */
+	bool SendBlock();
+
+	/** Pop a 10 ms block from every lane and mix them into SendBuffer. Returns false if no lane had audio */
+	bool MixInputLanes();
+
+	/** Record how many blocks were delivered by a wake of the task queue */
+	void RecordWake(int32 NumBlocks);
+
 private:
-	bool bIsRecording;    // True when audio is being pulled by the instance.
+	std::atomic<bool> bIsRecording;    // True when audio is being pulled by the instance.
 	bool bIsRecordingInitialized;  // True when the instance is ready to pull audio.
 
 	bool bIsStarted;
 	int64_t NextFrameTime;
 
+	/** Channels of the blocks sent to webrtc, and of the lanes. Only changes under the critical section */
+	std::atomic<int32> NumChannels;
+
+	/** Blocks are delivered as soon as they are complete rather than paced by the task queue. Set when recording starts */
+	std::atomic<bool> bPushDelivery;
+	std::atomic<bool> bDeliveryScheduled;
+
+	/** Delivery telemetry, written by the task queue only */
+	int64 LastDeliveryTimeUs;
+	std::atomic<uint32> BlocksDelivered;
+	std::atomic<uint32> MaxBlocksPerWake;
+	std::atomic<float> JitterMs;
+	std::atomic<float> MaxJitterMs;
+
 	rtc::TaskQueue TaskQueue;
 
-	TArray<Sample> AudioBuffer;
+	/** Lanes mixed every 10 ms, guarded by the critical section */
+	TArray<TSharedPtr<FAudioInputLane, ESPMode::ThreadSafe>> InputLanes;
+
+	/**
+	* Block popped from a lane, the lanes mixed, and the 10 ms block given to webrtc. Only used by the task queue,
+	* and sized for the most channels
+	*/
+	TArray<Sample> LaneBuffer;
+	TArray<float> MixBuffer;
+	TArray<Sample> SendBuffer;
+
 	webrtc::AudioTransport * AudioTransport;
 
 	FCriticalSection CriticalSection;
@@ -0,0 +1,549 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "AudioDownmix.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+#include <arm_neon.h>
+#define MILLICAST_DOWNMIX_NEON 1
+#elif PLATFORM_ENABLE_VECTORINTRINSICS
+#include <emmintrin.h>
+#define MILLICAST_DOWNMIX_SSE 1
+#endif
+
+namespace
+{
+	constexpr float kMinus3dB = 0.70710678f;
+
+	/** Same scaling as webrtc::FloatToS16 */
+	constexpr float kS16Scale = 32768.f;
+
+	/** Channel counts the vector gain ramps handle, the others go through the scalar code */
+	constexpr int32 kMaxGainChannels = 16;
+
+	using FChannelGains = TArray<float, TInlineAllocator<16>>;
+
+	/** Gain of every input channel in the left and right outputs */
+	void GetDownmixGains(int32 NumChannels, FChannelGains& OutLeft, FChannelGains& OutRight)
+	{
+		OutLeft.SetNumZeroed(NumChannels);
+		OutRight.SetNumZeroed(NumChannels);
+
+		switch (NumChannels)
+		{
+		case 1:
+			OutLeft[0] = OutRight[0] = 1.f;
+			break;
+		case 4: // FL FR SL SR
+			OutLeft[0] = OutRight[1] = 1.f;
+			OutLeft[2] = OutRight[3] = kMinus3dB;
+			break;
+		case 6: // FL FR FC LFE SL SR
+		case 8: // FL FR FC LFE SL SR BL BR
+			OutLeft[0] = OutRight[1] = 1.f;
+			OutLeft[2] = OutRight[2] = kMinus3dB;
+			for (int32 Channel = 4; Channel < NumChannels; Channel += 2)
+			{
+				OutLeft[Channel] = OutRight[Channel + 1] = kMinus3dB;
+			}
+			break;
+		default: // Even channels on the left, odd channels on the right
+			for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+			{
+				(Channel % 2 == 0 ? OutLeft : OutRight)[Channel] = Channel < 2 ? 1.f : kMinus3dB;
+			}
+			break;
+		}
+	}
+
+	using FRemixGains = TArray<float, TInlineAllocator<64>>;
+
+	/** Gain of every input channel in every output channel, OutChannels rows of InChannels gains */
+	void GetRemixGains(int32 InChannels, int32 OutChannels, FRemixGains& OutGains)
+	{
+		OutGains.SetNumZeroed(InChannels * OutChannels);
+
+		auto SetGain = [&OutGains, InChannels](int32 OutChannel, int32 InChannel, float Gain) {
+			OutGains[OutChannel * InChannels + InChannel] = Gain;
+		};
+
+		if (OutChannels == 1)
+		{
+			// Average of the stereo downmix
+			FChannelGains GainsL, GainsR;
+			GetDownmixGains(InChannels, GainsL, GainsR);
+			for (int32 Channel = 0; Channel < InChannels; ++Channel)
+			{
+				SetGain(0, Channel, 0.5f * (GainsL[Channel] + GainsR[Channel]));
+			}
+		}
+		else if (InChannels == 1)
+		{
+			SetGain(FMath::Min(2, OutChannels - 1), 0, 1.f);
+		}
+		else if (InChannels == 4 && OutChannels >= 6) // FL FR SL SR
+		{
+			SetGain(0, 0, 1.f);
+			SetGain(1, 1, 1.f);
+			SetGain(4, 2, 1.f);
+			SetGain(5, 3, 1.f);
+		}
+		else
+		{
+			for (int32 Channel = 0; Channel < FMath::Min(InChannels, OutChannels); ++Channel)
+			{
+				SetGain(Channel, Channel, 1.f);
+			}
+
+			// Extra channels, such as the 7.1 back channels, go to the last output pair
+			for (int32 Channel = OutChannels; Channel < InChannels; ++Channel)
+			{
+				SetGain(FMath::Max(OutChannels - 2 + Channel % 2, 0), Channel, kMinus3dB);
+			}
+		}
+	}
+
+	/** Rounded half to even like the SIMD conversions, so both give the same samples */
+	FORCEINLINE void Convert(float Value, int16& Out)
+	{
+		Out = int16(FMath::RoundHalfToEven(FMath::Clamp(Value * kS16Scale, -32768.f, 32767.f)));
+	}
+
+	FORCEINLINE void Convert(float Value, float& Out)
+	{
+		Out = Value;
+	}
+
+	template<typename OutType>
+	void StereoScalar(const float* In, int32 NumSamples, OutType* Out)
+	{
+		for (int32 i = 0; i < NumSamples; ++i)
+		{
+			Convert(In[i], Out[i]);
+		}
+	}
+
+	template<typename OutType>
+	void MonoScalar(const float* In, int32 NumFrames, OutType* Out)
+	{
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			Convert(In[Frame], Out[2 * Frame]);
+			Convert(In[Frame], Out[2 * Frame + 1]);
+		}
+	}
+
+	template<typename OutType>
+	void DownmixScalar(const float* In, int32 NumFrames, int32 NumChannels, const float* GainsL, const float* GainsR, OutType* Out)
+	{
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			const float* Samples = In + Frame * NumChannels;
+
+			float Left = 0.f;
+			float Right = 0.f;
+			for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+			{
+				Left += Samples[Channel] * GainsL[Channel];
+				Right += Samples[Channel] * GainsR[Channel];
+			}
+
+			Convert(Left, Out[2 * Frame]);
+			Convert(Right, Out[2 * Frame + 1]);
+		}
+	}
+
+	template<typename OutType>
+	void RemixScalar(const float* In, int32 NumFrames, int32 InChannels, int32 OutChannels, const float* Gains, OutType* Out)
+	{
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			const float* Samples = In + Frame * InChannels;
+
+			for (int32 OutChannel = 0; OutChannel < OutChannels; ++OutChannel)
+			{
+				const float* Row = Gains + OutChannel * InChannels;
+
+				float Value = 0.f;
+				for (int32 Channel = 0; Channel < InChannels; ++Channel)
+				{
+					Value += Samples[Channel] * Row[Channel];
+				}
+
+				Convert(Value, Out[Frame * OutChannels + OutChannel]);
+			}
+		}
+	}
+
+#if MILLICAST_DOWNMIX_SSE
+	/** 8 floats to 8 saturated 16 bits samples */
+	FORCEINLINE void StoreS16(__m128 A, __m128 B, int16* Out)
+	{
+		// Clamped before the conversion, which gives INT_MIN for anything out of the int32 range, even positive values
+		const __m128 Scale = _mm_set1_ps(kS16Scale);
+		const __m128 Min = _mm_set1_ps(-32768.f);
+		const __m128 Max = _mm_set1_ps(32767.f);
+		const __m128i IntA = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(A, Scale), Min), Max));
+		const __m128i IntB = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(B, Scale), Min), Max));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(Out), _mm_packs_epi32(IntA, IntB));
+	}
+
+	FORCEINLINE void Store(__m128 A, __m128 B, int16* Out)
+	{
+		StoreS16(A, B, Out);
+	}
+
+	FORCEINLINE void Store(__m128 A, __m128 B, float* Out)
+	{
+		_mm_storeu_ps(Out, A);
+		_mm_storeu_ps(Out + 4, B);
+	}
+
+	/** Returns the number of frames processed, the remaining ones are left to the scalar code */
+	template<typename OutType>
+	int32 StereoVector(const float* In, int32 NumFrames, OutType* Out)
+	{
+		const int32 NumVectorFrames = NumFrames & ~3;
+		for (int32 Frame = 0; Frame < NumVectorFrames; Frame += 4)
+		{
+			Store(_mm_loadu_ps(In + 2 * Frame), _mm_loadu_ps(In + 2 * Frame + 4), Out + 2 * Frame);
+		}
+		return NumVectorFrames;
+	}
+
+	template<typename OutType>
+	int32 MonoVector(const float* In, int32 NumFrames, OutType* Out)
+	{
+		const int32 NumVectorFrames = NumFrames & ~3;
+		for (int32 Frame = 0; Frame < NumVectorFrames; Frame += 4)
+		{
+			const __m128 Mono = _mm_loadu_ps(In + Frame);
+			Store(_mm_unpacklo_ps(Mono, Mono), _mm_unpackhi_ps(Mono, Mono), Out + 2 * Frame);
+		}
+		return NumVectorFrames;
+	}
+
+	/** 4 frames at a time, each channel of the 4 frames is gathered in a vector */
+	template<typename OutType>
+	int32 DownmixVector(const float* In, int32 NumFrames, int32 NumChannels, const float* GainsL, const float* GainsR, OutType* Out)
+	{
+		const int32 NumVectorFrames = NumFrames & ~3;
+		for (int32 Frame = 0; Frame < NumVectorFrames; Frame += 4)
+		{
+			const float* Samples = In + Frame * NumChannels;
+
+			__m128 Left = _mm_setzero_ps();
+			__m128 Right = _mm_setzero_ps();
+			for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+			{
+				const __m128 Values = _mm_setr_ps(Samples[Channel], Samples[NumChannels + Channel],
+					Samples[2 * NumChannels + Channel], Samples[3 * NumChannels + Channel]);
+
+				Left = _mm_add_ps(Left, _mm_mul_ps(Values, _mm_set1_ps(GainsL[Channel])));
+				Right = _mm_add_ps(Right, _mm_mul_ps(Values, _mm_set1_ps(GainsR[Channel])));
+			}
+
+			Store(_mm_unpacklo_ps(Left, Right), _mm_unpackhi_ps(Left, Right), Out + 2 * Frame);
+		}
+		return NumVectorFrames;
+	}
+
+	/** Returns the number of samples accumulated, the remaining ones are left to the scalar code */
+	int32 AccumulateVector(const int16* In, int32 NumSamples, float Scale, float* Mix)
+	{
+		const __m128 ScaleVector = _mm_set1_ps(Scale);
+		const int32 NumVectorSamples = NumSamples & ~7;
+		for (int32 i = 0; i < NumVectorSamples; i += 8)
+		{
+			// Sign extended to 32 bits by moving the samples to the upper half and shifting them back
+			const __m128i Values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(In + i));
+			const __m128 Low = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(Values, Values), 16));
+			const __m128 High = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(Values, Values), 16));
+
+			_mm_storeu_ps(Mix + i, _mm_add_ps(_mm_loadu_ps(Mix + i), _mm_mul_ps(Low, ScaleVector)));
+			_mm_storeu_ps(Mix + i + 4, _mm_add_ps(_mm_loadu_ps(Mix + i + 4), _mm_mul_ps(High, ScaleVector)));
+		}
+		return NumVectorSamples;
+	}
+
+	/**
+	* Gain of the first frame and gain increment per frame. Returns the number of frames processed.
+	* Goes through blocks of 4 frames, which are NumChannels vectors whatever the channel count.
+	*/
+	int32 GainVector(const float* In, int32 NumFrames, int32 NumChannels, float Gain, float Step, float* Out)
+	{
+		if (NumChannels > kMaxGainChannels)
+		{
+			return 0;
+		}
+
+		// Frame of each lane of the vectors of a block, relative to the first frame of the block
+		__m128 FrameOffsets[kMaxGainChannels];
+		for (int32 v = 0; v < NumChannels; ++v)
+		{
+			const int32 Sample = 4 * v;
+			FrameOffsets[v] = _mm_setr_ps(float(Sample / NumChannels), float((Sample + 1) / NumChannels),
+				float((Sample + 2) / NumChannels), float((Sample + 3) / NumChannels));
+		}
+
+		const __m128 Steps = _mm_set1_ps(Step);
+		__m128 BlockGain = _mm_set1_ps(Gain);
+		const __m128 Increment = _mm_set1_ps(4.f * Step);
+		const __m128 Min = _mm_set1_ps(-1.f);
+		const __m128 Max = _mm_set1_ps(1.f);
+
+		const int32 NumVectorFrames = NumFrames & ~3;
+		for (int32 i = 0; i < NumVectorFrames * NumChannels; i += 4 * NumChannels)
+		{
+			for (int32 v = 0; v < NumChannels; ++v)
+			{
+				const __m128 Gains = _mm_add_ps(BlockGain, _mm_mul_ps(FrameOffsets[v], Steps));
+				const __m128 Values = _mm_mul_ps(_mm_loadu_ps(In + i + 4 * v), Gains);
+				_mm_storeu_ps(Out + i + 4 * v, _mm_min_ps(_mm_max_ps(Values, Min), Max));
+			}
+			BlockGain = _mm_add_ps(BlockGain, Increment);
+		}
+		return NumVectorFrames;
+	}
+#elif MILLICAST_DOWNMIX_NEON
+	/** 8 floats to 8 saturated 16 bits samples */
+	FORCEINLINE void StoreS16(float32x4_t A, float32x4_t B, int16* Out)
+	{
+		const int32x4_t IntA = vcvtnq_s32_f32(vmulq_n_f32(A, kS16Scale));
+		const int32x4_t IntB = vcvtnq_s32_f32(vmulq_n_f32(B, kS16Scale));
+
+		vst1q_s16(Out, vcombine_s16(vqmovn_s32(IntA), vqmovn_s32(IntB)));
+	}
+
+	FORCEINLINE void Store(float32x4_t A, float32x4_t B, int16* Out)
+	{
+		StoreS16(A, B, Out);
+	}
+
+	FORCEINLINE void Store(float32x4_t A, float32x4_t B, float* Out)
+	{
+		vst1q_f32(Out, A);
+		vst1q_f32(Out + 4, B);
+	}
+
+	/** Returns the number of frames processed, the remaining ones are left to the scalar code */
+	template<typename OutType>
+	int32 StereoVector(const float* In, int32 NumFrames, OutType* Out)
+	{
+		const int32 NumVectorFrames = NumFrames & ~3;
+		for (int32 Frame = 0; Frame < NumVectorFrames; Frame += 4)
+		{
+			Store(vld1q_f32(In + 2 * Frame), vld1q_f32(In + 2 * Frame + 4), Out + 2 * Frame);
+		}
+		return NumVectorFrames;
+	}
+
+	template<typename OutType>
+	int32 MonoVector(const float* In, int32 NumFrames, OutType* Out)
+	{
+		const int32 NumVectorFrames = NumFrames & ~3;
+		for (int32 Frame = 0; Frame < NumVectorFrames; Frame += 4)
+		{
+			const float32x4x2_t Stereo = vzipq_f32(vld1q_f32(In + Frame), vld1q_f32(In + Frame));
+			Store(Stereo.val[0], Stereo.val[1], Out + 2 * Frame);
+		}
+		return NumVectorFrames;
+	}
+
+	/** 4 frames at a time, each channel of the 4 frames is gathered in a vector */
+	template<typename OutType>
+	int32 DownmixVector(const float* In, int32 NumFrames, int32 NumChannels, const float* GainsL, const float* GainsR, OutType* Out)
+	{
+		const int32 NumVectorFrames = NumFrames & ~3;
+		for (int32 Frame = 0; Frame < NumVectorFrames; Frame += 4)
+		{
+			const float* Samples = In + Frame * NumChannels;
+
+			float32x4_t Left = vdupq_n_f32(0.f);
+			float32x4_t Right = vdupq_n_f32(0.f);
+			for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+			{
+				float32x4_t Values = vdupq_n_f32(Samples[Channel]);
+				Values = vsetq_lane_f32(Samples[NumChannels + Channel], Values, 1);
+				Values = vsetq_lane_f32(Samples[2 * NumChannels + Channel], Values, 2);
+				Values = vsetq_lane_f32(Samples[3 * NumChannels + Channel], Values, 3);
+
+				Left = vmlaq_n_f32(Left, Values, GainsL[Channel]);
+				Right = vmlaq_n_f32(Right, Values, GainsR[Channel]);
+			}
+
+			const float32x4x2_t Stereo = vzipq_f32(Left, Right);
+			Store(Stereo.val[0], Stereo.val[1], Out + 2 * Frame);
+		}
+		return NumVectorFrames;
+	}
+
+	/** Returns the number of samples accumulated, the remaining ones are left to the scalar code */
+	int32 AccumulateVector(const int16* In, int32 NumSamples, float Scale, float* Mix)
+	{
+		const int32 NumVectorSamples = NumSamples & ~7;
+		for (int32 i = 0; i < NumVectorSamples; i += 8)
+		{
+			const int16x8_t Values = vld1q_s16(In + i);
+			const float32x4_t Low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(Values)));
+			const float32x4_t High = vcvtq_f32_s32(vmovl_s16(vget_high_s16(Values)));
+
+			vst1q_f32(Mix + i, vmlaq_n_f32(vld1q_f32(Mix + i), Low, Scale));
+			vst1q_f32(Mix + i + 4, vmlaq_n_f32(vld1q_f32(Mix + i + 4), High, Scale));
+		}
+		return NumVectorSamples;
+	}
+
+	/**
+	* Gain of the first frame and gain increment per frame. Returns the number of frames processed.
+	* Goes through blocks of 4 frames, which are NumChannels vectors whatever the channel count.
+	*/
+	int32 GainVector(const float* In, int32 NumFrames, int32 NumChannels, float Gain, float Step, float* Out)
+	{
+		if (NumChannels > kMaxGainChannels)
+		{
+			return 0;
+		}
+
+		// Frame of each lane of the vectors of a block, relative to the first frame of the block
+		float32x4_t FrameOffsets[kMaxGainChannels];
+		for (int32 v = 0; v < NumChannels; ++v)
+		{
+			const int32 Sample = 4 * v;
+			const float Offsets[4] = { float(Sample / NumChannels), float((Sample + 1) / NumChannels),
+				float((Sample + 2) / NumChannels), float((Sample + 3) / NumChannels) };
+			FrameOffsets[v] = vld1q_f32(Offsets);
+		}
+
+		float32x4_t BlockGain = vdupq_n_f32(Gain);
+		const float32x4_t Increment = vdupq_n_f32(4.f * Step);
+		const float32x4_t Min = vdupq_n_f32(-1.f);
+		const float32x4_t Max = vdupq_n_f32(1.f);
+
+		const int32 NumVectorFrames = NumFrames & ~3;
+		for (int32 i = 0; i < NumVectorFrames * NumChannels; i += 4 * NumChannels)
+		{
+			for (int32 v = 0; v < NumChannels; ++v)
+			{
+				const float32x4_t Gains = vmlaq_n_f32(BlockGain, FrameOffsets[v], Step);
+				const float32x4_t Values = vmulq_f32(vld1q_f32(In + i + 4 * v), Gains);
+				vst1q_f32(Out + i + 4 * v, vminq_f32(vmaxq_f32(Values, Min), Max));
+			}
+			BlockGain = vaddq_f32(BlockGain, Increment);
+		}
+		return NumVectorFrames;
+	}
+#else
+	template<typename OutType>
+	int32 StereoVector(const float*, int32, OutType*) { return 0; }
+	template<typename OutType>
+	int32 MonoVector(const float*, int32, OutType*) { return 0; }
+	template<typename OutType>
+	int32 DownmixVector(const float*, int32, int32, const float*, const float*, OutType*) { return 0; }
+	int32 AccumulateVector(const int16*, int32, float, float*) { return 0; }
+	int32 GainVector(const float*, int32, int32, float, float, float*) { return 0; }
+#endif
+
+	template<typename OutType>
+	void MixToStereo(const float* In, int32 NumFrames, int32 NumChannels, OutType* Out)
+	{
+		int32 Done;
+
+		switch (NumChannels)
+		{
+		case 1:
+			Done = MonoVector(In, NumFrames, Out);
+			MonoScalar(In + Done, NumFrames - Done, Out + 2 * Done);
+			break;
+		case 2:
+			Done = StereoVector(In, NumFrames, Out);
+			StereoScalar(In + 2 * Done, 2 * (NumFrames - Done), Out + 2 * Done);
+			break;
+		default:
+		{
+			FChannelGains GainsL, GainsR;
+			GetDownmixGains(NumChannels, GainsL, GainsR);
+
+			Done = DownmixVector(In, NumFrames, NumChannels, GainsL.GetData(), GainsR.GetData(), Out);
+			DownmixScalar(In + NumChannels * Done, NumFrames - Done, NumChannels, GainsL.GetData(), GainsR.GetData(), Out + 2 * Done);
+			break;
+		}
+		}
+	}
+
+	template<typename OutType>
+	void RemixTo(const float* In, int32 NumFrames, int32 InChannels, int32 OutChannels, OutType* Out)
+	{
+		if (OutChannels == 2)
+		{
+			MixToStereo(In, NumFrames, InChannels, Out);
+		}
+		else if (InChannels == OutChannels)
+		{
+			// Converted as pairs of samples, whatever the frames they belong to
+			const int32 NumSamples = NumFrames * InChannels;
+			const int32 Done = StereoVector(In, NumSamples / 2, Out);
+			StereoScalar(In + 2 * Done, NumSamples - 2 * Done, Out + 2 * Done);
+		}
+		else
+		{
+			// Surround and mono outputs are rare enough not to be vectorized
+			FRemixGains Gains;
+			GetRemixGains(InChannels, OutChannels, Gains);
+			RemixScalar(In, NumFrames, InChannels, OutChannels, Gains.GetData(), Out);
+		}
+	}
+}
+
+void AudioDownmix::DownmixToStereoS16(const float* In, int32 NumFrames, int32 NumChannels, int16* Out)
+{
+	MixToStereo(In, NumFrames, NumChannels, Out);
+}
+
+void AudioDownmix::DownmixToStereo(const float* In, int32 NumFrames, int32 NumChannels, float* Out)
+{
+	MixToStereo(In, NumFrames, NumChannels, Out);
+}
+
+void AudioDownmix::RemixS16(const float* In, int32 NumFrames, int32 InChannels, int32 OutChannels, int16* Out)
+{
+	RemixTo(In, NumFrames, InChannels, OutChannels, Out);
+}
+
+void AudioDownmix::Remix(const float* In, int32 NumFrames, int32 InChannels, int32 OutChannels, float* Out)
+{
+	RemixTo(In, NumFrames, InChannels, OutChannels, Out);
+}
+
+void AudioDownmix::AccumulateS16(const int16* In, int32 NumSamples, float Gain, float* Mix)
+{
+	const float Scale = Gain / kS16Scale;
+
+	const int32 Done = AccumulateVector(In, NumSamples, Scale, Mix);
+	for (int32 i = Done; i < NumSamples; ++i)
+	{
+		Mix[i] += In[i] * Scale;
+	}
+}
+
+void AudioDownmix::ApplyGain(const float* In, int32 NumFrames, int32 NumChannels, float StartGain, float EndGain, float* Out)
+{
+	if (NumFrames <= 0 || NumChannels <= 0)
+	{
+		return;
+	}
+
+	// The last frame reaches the end gain, the channels of a frame get the same gain
+	const float Step = (EndGain - StartGain) / NumFrames;
+	const float Gain = StartGain + Step;
+
+	const int32 Done = GainVector(In, NumFrames, NumChannels, Gain, Step, Out);
+	for (int32 Frame = Done; Frame < NumFrames; ++Frame)
+	{
+		const float FrameGain = Gain + Step * Frame;
+		for (int32 i = Frame * NumChannels; i < (Frame + 1) * NumChannels; ++i)
+		{
+			Out[i] = FMath::Clamp(In[i] * FrameGain, -1.f, 1.f);
+		}
+	}
+}
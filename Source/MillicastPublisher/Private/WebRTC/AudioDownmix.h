@@ -0,0 +1,40 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace AudioDownmix
+{
+	/**
+	* Mix interleaved float frames of any channel count down to stereo and convert them to 16 bits, in a single pass.
+	* Input channels are expected in the engine order (FL, FR, FC, LFE, SL, SR, BL, BR), the LFE is dropped and
+	* the center and surround channels are mixed in at -3 dB. Mono is copied to both channels.
+	* Out must hold 2 * NumFrames samples. Nothing is allocated for up to 16 input channels.
+	*/
+	void DownmixToStereoS16(const float* In, int32 NumFrames, int32 NumChannels, int16* Out);
+
+	/** Same as DownmixToStereoS16, keeping float samples */
+	void DownmixToStereo(const float* In, int32 NumFrames, int32 NumChannels, float* Out);
+
+	/**
+	* Mix interleaved float frames of any channel count to OutChannels channels and convert them to 16 bits.
+	* Mono and stereo outputs go through DownmixToStereoS16. Surround outputs (5.1, 7.1) keep the engine channel order:
+	* mono goes to the center, stereo to the front channels, 7.1 back channels are folded into the 5.1 surround channels.
+	* Frames with the same channel count are only converted.
+	*/
+	void RemixS16(const float* In, int32 NumFrames, int32 InChannels, int32 OutChannels, int16* Out);
+
+	/** Same as RemixS16, keeping float samples */
+	void Remix(const float* In, int32 NumFrames, int32 InChannels, int32 OutChannels, float* Out);
+
+	/** Add NumSamples 16 bits samples, scaled by Gain, to the float samples of Mix. Mix keeps the scale of DownmixToStereoS16 input */
+	void AccumulateS16(const int16* In, int32 NumSamples, float Gain, float* Mix);
+
+	/**
+	* Apply a gain to interleaved float frames and clamp them to [-1, 1]. The gain ramps linearly from StartGain to EndGain
+	* over the frames, every channel of a frame getting the same gain, so gain changes don't click nor shift the balance.
+	* In and Out may be the same buffer.
+	*/
+	void ApplyGain(const float* In, int32 NumFrames, int32 NumChannels, float StartGain, float EndGain, float* Out);
+}
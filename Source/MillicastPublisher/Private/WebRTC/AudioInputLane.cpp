@@ -0,0 +1,225 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "AudioInputLane.h"
+#include "MillicastPublisherPrivate.h"
+#include "AudioDownmix.h"
+#include "WebRTCInc.h"
+
+static TAutoConsoleVariable<int32> CVarMillicastAudioResamplerQuality(
+	TEXT("Millicast.Publisher.AudioResamplerQuality"),
+	1,
+	TEXT("Quality of the conversion of captured audio which is not at 48 kHz. 0: low, 1: medium, 2: high."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<bool> CVarMillicastAudioDriftCompensation(
+	TEXT("Millicast.Publisher.AudioDriftCompensation"),
+	true,
+	TEXT("Resample the captured audio slightly faster or slower to hold the buffered audio around the target latency, ")
+	TEXT("compensating the drift between the audio capture clock and the clock sending audio to webrtc."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarMillicastAudioTargetLatencyMs(
+	TEXT("Millicast.Publisher.AudioTargetLatencyMs"),
+	40,
+	TEXT("Amount of captured audio the drift compensation keeps buffered, in milliseconds."),
+	ECVF_Default);
+
+/** Drift compensation controller. The correction is kept small enough not to be heard as a pitch change */
+static constexpr double kMaxDriftCorrectionPpm = 1000.0;
+static constexpr double kDriftProportionalGain = 10.0; // ppm per ms of latency error
+static constexpr double kDriftIntegralGain = 0.5;      // ppm per ms.s of accumulated latency error
+static constexpr float kBufferedMsSmoothing = 0.05f;
+
+static TAutoConsoleVariable<int32> CVarMillicastAudioMaxBufferedMs(
+	TEXT("Millicast.Publisher.AudioMaxBufferedMs"),
+	200,
+	TEXT("Maximum amount of captured audio buffered, in milliseconds. Above it the oldest audio is dropped ")
+	TEXT("down to the target latency, with a short crossfade."),
+	ECVF_Default);
+
+/** Upper bounds of the buffered duration histogram buckets, the last bucket has none */
+static constexpr int32 kBufferedMsBucketBounds[] = { 10, 20, 40, 80, 160, 320 };
+
+FAudioInputLane::FAudioInputLane(int32 InNumChannels) noexcept
+	: NumChannels(FMath::Clamp(InNumChannels, 1, kMaxNumChannels)),
+	bIsActive(false),
+	bDriftCompensationAllowed(true),
+	LastPushTimeUs(0),
+	Gain(1.f),
+	bIsMuted(false),
+	AudioBuffer(kMaxBufferedMs * kSampleRate / 1000 * NumChannels, NumChannels),
+	UnsupportedSampleRate(0),
+	bDriftCompensation(false),
+	SmoothedBufferedMs(0.f),
+	LatencyErrorIntegral(0.0),
+	DriftPpm(0.f),
+	Sheds(0),
+	ShedSamples(0)
+{
+	static_assert(UE_ARRAY_COUNT(kBufferedMsBucketBounds) + 1 == kNumBufferedMsBuckets, "Histogram bounds don't match the buckets");
+
+	for (std::atomic<uint32>& Bucket : BufferedMsHistogram)
+	{
+		Bucket = 0;
+	}
+
+	CrossfadeBuffer.SetNumZeroed(GetBlockSamples());
+}
+
+void FAudioInputLane::Push(const float* AudioData, int32 NumSamples, int32 InNumChannels, int32 SampleRate)
+{
+	if (!bIsActive)
+	{
+		return;
+	}
+
+	if (SampleRate < kMinInputSampleRate || SampleRate > kMaxInputSampleRate)
+	{
+		if (UnsupportedSampleRate != SampleRate)
+		{
+			UnsupportedSampleRate = SampleRate;
+			UE_LOG(LogMillicastPublisher, Warning, TEXT("AudioDeviceModule doesn't support %d Hz audio"), SampleRate);
+		}
+		return;
+	}
+
+	if (InNumChannels <= 0)
+	{
+		return;
+	}
+
+	const int32 NumFrames = NumSamples / InNumChannels;
+	LastPushTimeUs = rtc::TimeMicros();
+
+	// Audio at 48 kHz only goes through the resampler to compensate the clock drift
+	const bool bCompensateDrift = bDriftCompensationAllowed && CVarMillicastAudioDriftCompensation.GetValueOnAnyThread();
+	if (bCompensateDrift != bDriftCompensation)
+	{
+		bDriftCompensation = bCompensateDrift;
+		SmoothedBufferedMs = 0.f;
+		LatencyErrorIntegral = 0.0;
+		DriftPpm = 0.f;
+		Resampler.SetRatioAdjustment(0.0);
+	}
+
+	if (SampleRate == kSampleRate && !bDriftCompensation)
+	{
+		// Remixed and converted straight into the ring, the task queue is never blocked by the capture thread.
+		// The ring holds whole frames, so both regions of a write wrapping around start and end on a frame
+		AudioBuffer.Write(NumFrames * NumChannels, [this, AudioData, InNumChannels](Sample* Dest, int32 Offset, int32 Count) {
+			AudioDownmix::RemixS16(AudioData + Offset / NumChannels * InNumChannels, Count / NumChannels, InNumChannels, NumChannels, Dest);
+		});
+		return;
+	}
+
+	const auto Quality = static_cast<FPolyphaseResampler::EQuality>(FMath::Clamp(CVarMillicastAudioResamplerQuality.GetValueOnAnyThread(), 0, 2));
+	if (!Resampler.IsConfigured(SampleRate, kSampleRate, NumChannels, Quality))
+	{
+		UE_LOG(LogMillicastPublisher, Log, TEXT("Resampling captured audio from %d Hz"), SampleRate);
+		Resampler.Configure(SampleRate, kSampleRate, NumChannels, Quality);
+	}
+
+	if (bDriftCompensation)
+	{
+		UpdateDriftCompensation(NumFrames, SampleRate);
+	}
+
+	// Remixed first, so only the output channels are resampled. The buffers only grow for bigger input buffers
+	RemixBuffer.SetNumUninitialized(NumFrames * NumChannels, false);
+	AudioDownmix::Remix(AudioData, NumFrames, InNumChannels, NumChannels, RemixBuffer.GetData());
+
+	ResampleBuffer.SetNumUninitialized(Resampler.GetNumOutputFrames(NumFrames) * NumChannels, false);
+	const int32 NumOutputFrames = Resampler.Process(RemixBuffer.GetData(), NumFrames, ResampleBuffer.GetData());
+
+	const float* Resampled = ResampleBuffer.GetData();
+	AudioBuffer.Write(NumOutputFrames * NumChannels, [this, Resampled](Sample* Dest, int32 Offset, int32 Count) {
+		AudioDownmix::RemixS16(Resampled + Offset, Count / NumChannels, NumChannels, NumChannels, Dest);
+	});
+}
+
+void FAudioInputLane::UpdateDriftCompensation(int32 NumFrames, int32 SampleRate)
+{
+	// The buffered audio goes up and down with every capture and every 10 ms block sent, only its average is relevant
+	const float BufferedMs = SamplesToMs(AudioBuffer.Num());
+	SmoothedBufferedMs += (BufferedMs - SmoothedBufferedMs) * kBufferedMsSmoothing;
+
+	const double Error = SmoothedBufferedMs - CVarMillicastAudioTargetLatencyMs.GetValueOnAnyThread();
+	const double Duration = double(NumFrames) / SampleRate;
+
+	// The integral converges to the actual drift between the clocks, it's clamped so it doesn't wind up during underruns
+	LatencyErrorIntegral = FMath::Clamp(LatencyErrorIntegral + Error * Duration,
+		-kMaxDriftCorrectionPpm / kDriftIntegralGain, kMaxDriftCorrectionPpm / kDriftIntegralGain);
+
+	// More audio buffered than the target means the capture clock is faster, so the input is consumed faster
+	const double Ppm = FMath::Clamp(kDriftProportionalGain * Error + kDriftIntegralGain * LatencyErrorIntegral,
+		-kMaxDriftCorrectionPpm, kMaxDriftCorrectionPpm);
+
+	Resampler.SetRatioAdjustment(Ppm);
+	DriftPpm = float(Ppm);
+}
+
+bool FAudioInputLane::PopBlock(Sample* Out)
+{
+	const int32 BufferedSamples = AudioBuffer.Num();
+
+	const float BufferedMs = SamplesToMs(BufferedSamples);
+	int32 Bucket = 0;
+	while (Bucket < int32(UE_ARRAY_COUNT(kBufferedMsBucketBounds)) && BufferedMs >= kBufferedMsBucketBounds[Bucket])
+	{
+		++Bucket;
+	}
+	BufferedMsHistogram[Bucket].fetch_add(1, std::memory_order_relaxed);
+
+	const int32 BlockSamples = GetBlockSamples();
+	const int32 MaxSamples = FMath::Min(MsToSamples(CVarMillicastAudioMaxBufferedMs.GetValueOnAnyThread()), AudioBuffer.Max());
+
+	if (BufferedSamples <= FMath::Max(MaxSamples, 2 * BlockSamples))
+	{
+		return AudioBuffer.Pop(Out, BlockSamples);
+	}
+
+	// Drop what's between the next block and the block leaving the target latency buffered
+	const int32 TargetSamples = FMath::Min(MsToSamples(CVarMillicastAudioTargetLatencyMs.GetValueOnAnyThread()), MaxSamples);
+	const int32 DroppedSamples = FMath::Max(BufferedSamples - 2 * BlockSamples - TargetSamples, 0) / NumChannels * NumChannels;
+
+	AudioBuffer.Pop(Out, BlockSamples);
+	AudioBuffer.Discard(DroppedSamples);
+	AudioBuffer.Pop(CrossfadeBuffer.GetData(), BlockSamples);
+
+	// Linear crossfade over the block, the audio after the gap replaces the audio before it
+	const Sample* In = CrossfadeBuffer.GetData();
+	for (int32 Frame = 0; Frame < kBlockFrames; ++Frame)
+	{
+		const float FadeIn = (Frame + 0.5f) / kBlockFrames;
+		for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+		{
+			const int32 Index = Frame * NumChannels + Channel;
+			Out[Index] = Sample(FMath::RoundToInt(Out[Index] + (In[Index] - Out[Index]) * FadeIn));
+		}
+	}
+
+	Sheds.fetch_add(1, std::memory_order_relaxed);
+	ShedSamples.fetch_add(DroppedSamples + BlockSamples, std::memory_order_relaxed);
+
+	return true;
+}
+
+FAudioInputLane::FStats FAudioInputLane::GetStats() const
+{
+	FStats Stats;
+	Stats.BufferedSamples = AudioBuffer.Num();
+	Stats.MaxSamples = AudioBuffer.Max();
+	Stats.BufferedMs = SamplesToMs(Stats.BufferedSamples);
+	Stats.Overruns = AudioBuffer.GetOverruns();
+	Stats.Underruns = AudioBuffer.GetUnderruns();
+	Stats.DriftPpm = DriftPpm;
+	Stats.Sheds = Sheds;
+	Stats.ShedMs = SamplesToMs(ShedSamples);
+
+	for (int32 Bucket = 0; Bucket < kNumBufferedMsBuckets; ++Bucket)
+	{
+		Stats.BufferedMsHistogram[Bucket] = BufferedMsHistogram[Bucket];
+	}
+
+	return Stats;
+}
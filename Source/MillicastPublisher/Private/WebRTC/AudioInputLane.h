@@ -0,0 +1,138 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AudioRingBuffer.h"
+#include "PolyphaseResampler.h"
+
+#include <atomic>
+
+/**
+* Audio of one audio source, waiting to be mixed by the audio device module.
+* The source pushes audio at its own rate, channel count and clock, the lane converts it to 48 kHz 16 bits audio
+* with the channels sent to webrtc, and the audio device module pops it in 10 ms blocks.
+* Push must always be called from the same thread, PopBlock from the audio device module task queue.
+*/
+class FAudioInputLane
+{
+public:
+	/** Sample type and format of the blocks popped */
+	typedef int16 Sample;
+
+	static constexpr int32 kSampleRate = 48000;
+	static constexpr int32 kMaxNumChannels = 8;
+	static constexpr int32 kBlockFrames = kSampleRate / 100;
+	static constexpr int32 kMaxBufferedMs = 500;
+	static constexpr int32 kNumBufferedMsBuckets = 7;
+	static constexpr int32 kMinInputSampleRate = 8000;
+	static constexpr int32 kMaxInputSampleRate = 192000;
+
+	/** Sample buffer counters */
+	struct FStats
+	{
+		int32 BufferedSamples = 0; // Interleaved samples waiting to be sent
+		int32 MaxSamples = 0;      // Capacity of the sample buffer
+		float BufferedMs = 0.f;    // Duration of the samples waiting to be sent
+		uint32 Overruns = 0;       // Audio buffers dropped because the sample buffer was full
+		uint32 Underruns = 0;      // 10 ms blocks not sent because not enough samples were buffered
+		float DriftPpm = 0.f;      // Rate correction applied to the captured audio to hold the target latency
+		uint32 Sheds = 0;          // Times the oldest audio was dropped because too much was buffered
+		float ShedMs = 0.f;        // Total duration of the audio dropped
+
+		/** Number of 10 ms ticks by buffered duration, in buckets up to 10, 20, 40, 80, 160, 320 ms and above */
+		uint32 BufferedMsHistogram[kNumBufferedMsBuckets] = {};
+	};
+
+	/** Blocks of NumChannels channels are popped, from 1 to kMaxNumChannels */
+	explicit FAudioInputLane(int32 NumChannels) noexcept;
+
+	int32 GetNumChannels() const { return NumChannels; }
+
+	/** Number of interleaved samples in a 10 ms block */
+	int32 GetBlockSamples() const { return kBlockFrames * NumChannels; }
+
+	/** Queue interleaved float audio, remixed and resampled if needed. Dropped while the lane is inactive */
+	void Push(const float* AudioData, int32 NumSamples, int32 NumChannels, int32 SampleRate);
+
+	/**
+	* Pop the next 10 ms block, GetBlockSamples() interleaved samples. When more than the maximum is buffered, the oldest audio
+	* is dropped down to the target latency, and the block crossfades from the audio before the gap to the audio after it.
+	* Returns false if not enough audio is buffered.
+	*/
+	bool PopBlock(Sample* Out);
+
+	/** Set by the audio device module while it's recording, nothing is queued otherwise as it would only add latency */
+	void SetActive(bool bInActive) { bIsActive = bInActive; }
+	bool IsActive() const { return bIsActive; }
+
+	/**
+	* Whether the rate of the captured audio may be corrected to hold the target latency, allowed when the blocks are
+	* popped at the pace of another clock. Compensation itself is still enabled by a console variable
+	*/
+	void SetDriftCompensationAllowed(bool bAllowed) { bDriftCompensationAllowed = bAllowed; }
+
+	/** Whether a complete 10 ms block is buffered */
+	bool HasBlock() const { return AudioBuffer.Num() >= GetBlockSamples(); }
+
+	/** Time audio was last pushed, in microseconds, 0 if it never was */
+	int64 GetLastPushTimeUs() const { return LastPushTimeUs; }
+
+	/** Linear gain of the lane in the mix */
+	void SetGain(float InGain) { Gain = FMath::Max(InGain, 0.f); }
+	float GetGain() const { return Gain; }
+
+	/** A muted lane is still consumed, so its latency doesn't build up, but isn't heard in the mix */
+	void SetMuted(bool bInMuted) { bIsMuted = bInMuted; }
+	bool IsMuted() const { return bIsMuted; }
+
+	/** Get the sample buffer counters. Can be called from any thread */
+	FStats GetStats() const;
+
+private:
+	/** Duration of a number of interleaved samples, in milliseconds */
+	float SamplesToMs(int32 NumSamples) const
+	{
+		return NumSamples * 1000.f / (kSampleRate * NumChannels);
+	}
+
+	/** Number of interleaved samples in a duration */
+	int32 MsToSamples(int32 Ms) const
+	{
+		return Ms * (kSampleRate / 1000) * NumChannels;
+	}
+
+	/** Update the rate correction from the buffered audio, before NumFrames more are resampled */
+	void UpdateDriftCompensation(int32 NumFrames, int32 SampleRate);
+
+	const int32 NumChannels;
+
+	std::atomic<bool> bIsActive;
+	std::atomic<bool> bDriftCompensationAllowed;
+	std::atomic<int64> LastPushTimeUs;
+	std::atomic<float> Gain;
+	std::atomic<bool> bIsMuted;
+
+	/** Written by the audio capture thread, read by the task queue */
+	TAudioRingBuffer<Sample> AudioBuffer;
+
+	/** Input sample rate conversion, and its buffers. Only used by the capture thread */
+	FPolyphaseResampler Resampler;
+	TArray<float> RemixBuffer;
+	TArray<float> ResampleBuffer;
+	int32 UnsupportedSampleRate;
+
+	/** Clock drift compensation, holding the buffered audio around a target latency. Only used by the capture thread */
+	bool bDriftCompensation;
+	float SmoothedBufferedMs;
+	double LatencyErrorIntegral; // in ms.s
+	std::atomic<float> DriftPpm;
+
+	/** Block faded in after dropping audio. Only used by the task queue */
+	TArray<Sample> CrossfadeBuffer;
+
+	/** Buffer telemetry, written by the task queue only */
+	std::atomic<uint32> Sheds;
+	std::atomic<uint32> ShedSamples;
+	std::atomic<uint32> BufferedMsHistogram[kNumBufferedMsBuckets];
+};
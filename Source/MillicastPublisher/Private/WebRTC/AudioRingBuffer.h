@@ -0,0 +1,140 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include <atomic>
+
+/**
+* Fixed capacity, lock-free single producer / single consumer ring of audio samples.
+* The capacity is a whole number of frames, so as long as whole frames are written and read, the regions
+* a write or a read is split in at the end of the ring hold whole frames too.
+* Writes and reads are all or nothing and wait-free: a write that doesn't fit is counted as an overrun,
+* a read of more than what is buffered as an underrun.
+* Write and Push must only be called from one thread, Read and Pop from another.
+*/
+template<typename SampleType>
+class TAudioRingBuffer
+{
+public:
+	/** The capacity is rounded up to a power of two number of frames of FrameSamples interleaved samples */
+	explicit TAudioRingBuffer(int32 MinCapacity, int32 FrameSamples = 1) noexcept
+		: Capacity(FMath::RoundUpToPowerOfTwo(FMath::DivideAndRoundUp(FMath::Max(MinCapacity, 1), FMath::Max(FrameSamples, 1)))
+			* FMath::Max(FrameSamples, 1)),
+		WritePosition(0),
+		ReadPosition(0),
+		Overruns(0),
+		Underruns(0)
+	{
+		Samples.SetNumZeroed(Capacity);
+	}
+
+	/**
+	* Producer: reserve NumSamples and call Fill(Dest, Offset, Count) for the one or two contiguous regions they span,
+	* Offset being the number of samples written by the previous call. Returns false if they don't fit.
+	*/
+	template<typename FillType>
+	bool Write(int32 NumSamples, FillType&& Fill)
+	{
+		const uint64 Written = WritePosition.load(std::memory_order_relaxed);
+		const uint64 Consumed = ReadPosition.load(std::memory_order_acquire);
+
+		if (NumSamples > int32(Capacity - (Written - Consumed)))
+		{
+			Overruns.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		const uint32 Start = uint32(Written % Capacity);
+		const int32 FirstCount = FMath::Min(NumSamples, int32(Capacity - Start));
+
+		Fill(Samples.GetData() + Start, 0, FirstCount);
+		if (FirstCount < NumSamples)
+		{
+			Fill(Samples.GetData(), FirstCount, NumSamples - FirstCount);
+		}
+
+		WritePosition.store(Written + NumSamples, std::memory_order_release);
+		return true;
+	}
+
+	/** Producer: copy NumSamples in the ring. Returns false if they don't fit */
+	bool Push(const SampleType* Data, int32 NumSamples)
+	{
+		return Write(NumSamples, [Data](SampleType* Dest, int32 Offset, int32 Count) {
+			FMemory::Memcpy(Dest, Data + Offset, Count * sizeof(SampleType));
+		});
+	}
+
+	/**
+	* Consumer: call Consume(Source, Offset, Count) for the one or two contiguous regions of the NumSamples oldest samples,
+	* and release them. Returns false if less than NumSamples are buffered.
+	*/
+	template<typename ConsumeType>
+	bool Read(int32 NumSamples, ConsumeType&& Consume)
+	{
+		const uint64 Consumed = ReadPosition.load(std::memory_order_relaxed);
+		const uint64 Written = WritePosition.load(std::memory_order_acquire);
+
+		if (NumSamples > int32(Written - Consumed))
+		{
+			Underruns.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		const uint32 Start = uint32(Consumed % Capacity);
+		const int32 FirstCount = FMath::Min(NumSamples, int32(Capacity - Start));
+
+		Consume(static_cast<const SampleType*>(Samples.GetData() + Start), 0, FirstCount);
+		if (FirstCount < NumSamples)
+		{
+			Consume(static_cast<const SampleType*>(Samples.GetData()), FirstCount, NumSamples - FirstCount);
+		}
+
+		ReadPosition.store(Consumed + NumSamples, std::memory_order_release);
+		return true;
+	}
+
+	/** Consumer: copy the NumSamples oldest samples out of the ring. Returns false if less than that are buffered */
+	bool Pop(SampleType* Data, int32 NumSamples)
+	{
+		return Read(NumSamples, [Data](const SampleType* Source, int32 Offset, int32 Count) {
+			FMemory::Memcpy(Data + Offset, Source, Count * sizeof(SampleType));
+		});
+	}
+
+	/** Consumer: release the NumSamples oldest samples without reading them. Returns false if less than that are buffered */
+	bool Discard(int32 NumSamples)
+	{
+		return Read(NumSamples, [](const SampleType*, int32, int32) {});
+	}
+
+	/** Number of samples buffered. Exact from the consumer thread, a snapshot from any other */
+	int32 Num() const
+	{
+		// Read position first, the write position can only be further
+		const uint64 Consumed = ReadPosition.load(std::memory_order_acquire);
+		return int32(WritePosition.load(std::memory_order_acquire) - Consumed);
+	}
+
+	int32 Max() const { return Capacity; }
+
+	/** Number of writes dropped because the ring was full */
+	uint32 GetOverruns() const { return Overruns.load(std::memory_order_relaxed); }
+
+	/** Number of reads that failed because not enough samples were buffered */
+	uint32 GetUnderruns() const { return Underruns.load(std::memory_order_relaxed); }
+
+private:
+	const uint32 Capacity;
+
+	TArray<SampleType> Samples;
+
+	/** Total number of samples written and read. Only the producer moves the first one and the consumer the second */
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> WritePosition;
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> ReadPosition;
+
+	std::atomic<uint32> Overruns;
+	std::atomic<uint32> Underruns;
+};
@@ -0,0 +1,61 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/Atomic.h"
+
+/**
+* Decide whether an engine frame has to be captured to hold a target capture framerate.
+* The decision is made before anything is read back, so frames above the target rate cost nothing.
+*/
+class FCaptureFrameScheduler
+{
+	TAtomic<int32> TargetFramerate; // 0 means every frame is captured
+	int64 NextCaptureTimeUs;
+
+public:
+	FCaptureFrameScheduler() noexcept : TargetFramerate(0), NextCaptureTimeUs(0) {}
+
+	/** Set the maximum number of frames captured per second, 0 to capture every engine frame. Can be called from any thread */
+	void SetTargetFramerate(int32 Framerate)
+	{
+		TargetFramerate = FMath::Max(Framerate, 0);
+	}
+
+	int32 GetTargetFramerate() const
+	{
+		return TargetFramerate;
+	}
+
+	/** Returns true if the frame rendered at TimestampUs must be captured */
+	bool ShouldCapture(int64 TimestampUs)
+	{
+		const int32 Framerate = TargetFramerate;
+		if (Framerate <= 0)
+		{
+			return true;
+		}
+
+		const int64 IntervalUs = 1000000 / Framerate;
+
+		// Engine frames don't land exactly on the capture schedule, accept a frame slightly early
+		// rather than waiting for the next one, which would halve the framerate when both rates are close.
+		const int64 ToleranceUs = IntervalUs / 4;
+
+		if (TimestampUs < NextCaptureTimeUs - ToleranceUs)
+		{
+			return false;
+		}
+
+		NextCaptureTimeUs += IntervalUs;
+
+		// Restart the schedule after a hitch or a framerate change instead of capturing a burst of frames
+		if (NextCaptureTimeUs < TimestampUs || NextCaptureTimeUs > TimestampUs + IntervalUs + ToleranceUs)
+		{
+			NextCaptureTimeUs = TimestampUs + IntervalUs;
+		}
+
+		return true;
+	}
+};
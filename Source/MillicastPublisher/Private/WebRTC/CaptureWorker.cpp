@@ -0,0 +1,214 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "CaptureWorker.h"
+#include "Texture2DFrameBuffer.h"
+
+#include "HAL/RunnableThread.h"
+#include "WebRTCInc.h"
+
+FCaptureWorker::FCaptureWorker(int32 InMaxQueuedFrames, EDropPolicy InDropPolicy, FProcessFrame InProcessFrame, FNV12BufferPoolPtr InNV12BufferPool)
+	: MaxQueuedFrames(FMath::Max(InMaxQueuedFrames, 1)),
+	DropPolicy(InDropPolicy),
+	ProcessFrame(MoveTemp(InProcessFrame)),
+	NV12BufferPool(MoveTemp(InNV12BufferPool)),
+	FrameQueuedEvent(FPlatformProcess::GetSynchEventFromPool(false)),
+	Thread(nullptr),
+	bStopping(false),
+	FramesDropped(0),
+	FramesProcessed(0),
+	TotalWaitUs(0),
+	MaxWaitUs(0)
+{
+	Queue.Reserve(MaxQueuedFrames);
+	Thread = FRunnableThread::Create(this, TEXT("MillicastCaptureWorker"), 0, TPri_AboveNormal);
+}
+
+FCaptureWorker::~FCaptureWorker()
+{
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+	}
+
+	FPlatformProcess::ReturnSynchEventToPool(FrameQueuedEvent);
+}
+
+bool FCaptureWorker::Enqueue(const FTextureReadbackRing::FReadbackData& ReadbackData)
+{
+	FQueuedFrame Frame;
+
+	const bool bNV12Buffer = ReadbackData.Layout == FTextureReadbackRing::ELayout::NV12 && NV12BufferPool.IsValid();
+
+	{
+		FScopeLock Lock(&QueueSection);
+
+		if (Queue.Num() == MaxQueuedFrames)
+		{
+			++FramesDropped;
+
+			// Don't even copy the frame
+			if (DropPolicy == EDropPolicy::DropNewest)
+			{
+				return false;
+			}
+
+			if (Queue[0].Data.Max() > 0)
+			{
+				FreeBuffers.Add(MoveTemp(Queue[0].Data));
+			}
+			Queue.RemoveAt(0, 1, false);
+		}
+
+		if (FreeBuffers.Num() > 0 && !bNV12Buffer)
+		{
+			Frame.Data = FreeBuffers.Pop(false);
+		}
+	}
+
+	Frame.ReadbackData = ReadbackData;
+	Frame.EnqueueTimeUs = rtc::TimeMicros();
+
+	if (bNV12Buffer)
+	{
+		// Copied once, in the buffer the frame pushed to webrtc keeps
+		const int32 Width = ReadbackData.Width;
+		const int32 Height = ReadbackData.Height;
+
+		Frame.NV12Buffer = NV12BufferPool->CreateBuffer(Width, Height);
+		libyuv::NV12Copy(ReadbackData.Data, ReadbackData.Stride, ReadbackData.Data + ReadbackData.Stride * Height, ReadbackData.Stride,
+			Frame.NV12Buffer->MutableDataY(), Frame.NV12Buffer->StrideY(), Frame.NV12Buffer->MutableDataUV(), Frame.NV12Buffer->StrideUV(),
+			Width, Height);
+
+		// Frames converted on the GPU have even sizes, the chroma rows follow the luma rows with the same stride
+		check(Frame.NV12Buffer->StrideUV() == Frame.NV12Buffer->StrideY()
+			&& Frame.NV12Buffer->DataUV() == Frame.NV12Buffer->DataY() + Frame.NV12Buffer->StrideY() * Height);
+
+		Frame.ReadbackData.Data = Frame.NV12Buffer->DataY();
+		Frame.ReadbackData.Stride = Frame.NV12Buffer->StrideY();
+
+		{
+			FScopeLock Lock(&QueueSection);
+			Queue.Add(MoveTemp(Frame));
+		}
+
+		FrameQueuedEvent->Trigger();
+
+		return true;
+	}
+
+	// Only the rows of the frame are copied, without the padding of the staging texture
+	const uint8* Source;
+	int32 RowBytes;
+	int32 NumRows;
+
+	if (ReadbackData.Layout == FTextureReadbackRing::ELayout::NV12)
+	{
+		Source = ReadbackData.Data;
+		RowBytes = ReadbackData.Width;
+		NumRows = ReadbackData.Height + ReadbackData.Height / 2;
+	}
+	else
+	{
+		const int32 BytesPerPixel = GPixelFormats[ReadbackData.Format].BlockBytes;
+
+		Source = ReadbackData.Data + ReadbackData.SourceRect.Min.Y * ReadbackData.Stride + ReadbackData.SourceRect.Min.X * BytesPerPixel;
+		RowBytes = ReadbackData.SourceRect.Width() * BytesPerPixel;
+		NumRows = ReadbackData.SourceRect.Height();
+	}
+
+	Frame.Data.SetNumUninitialized(RowBytes * NumRows, false);
+
+	for (int32 Row = 0; Row < NumRows; ++Row)
+	{
+		FMemory::Memcpy(Frame.Data.GetData() + Row * RowBytes, Source + Row * ReadbackData.Stride, RowBytes);
+	}
+
+	Frame.ReadbackData.Data = Frame.Data.GetData();
+	Frame.ReadbackData.Stride = RowBytes;
+	Frame.ReadbackData.SourceRect = FIntRect(FIntPoint::ZeroValue, ReadbackData.SourceRect.Size());
+
+	{
+		FScopeLock Lock(&QueueSection);
+		Queue.Add(MoveTemp(Frame));
+	}
+
+	FrameQueuedEvent->Trigger();
+
+	return true;
+}
+
+uint32 FCaptureWorker::Run()
+{
+	while (!bStopping)
+	{
+		FQueuedFrame Frame;
+		bool bHasFrame = false;
+
+		{
+			FScopeLock Lock(&QueueSection);
+
+			if (Queue.Num() > 0)
+			{
+				Frame = MoveTemp(Queue[0]);
+				Queue.RemoveAt(0, 1, false);
+				bHasFrame = true;
+			}
+		}
+
+		if (!bHasFrame)
+		{
+			FrameQueuedEvent->Wait();
+			continue;
+		}
+
+		const int64 WaitUs = rtc::TimeMicros() - Frame.EnqueueTimeUs;
+		TotalWaitUs += WaitUs;
+		if (WaitUs > MaxWaitUs)
+		{
+			MaxWaitUs = WaitUs;
+		}
+
+		ProcessFrame(Frame.ReadbackData, Frame.NV12Buffer);
+		++FramesProcessed;
+
+		// The frame pushed to webrtc holds its own reference to the NV12 buffer, if it kept the frame
+		Frame.NV12Buffer = nullptr;
+
+		{
+			FScopeLock Lock(&QueueSection);
+
+			// Keep one buffer per queued frame plus the one being copied
+			if (Frame.Data.Max() > 0 && FreeBuffers.Num() <= MaxQueuedFrames)
+			{
+				FreeBuffers.Add(MoveTemp(Frame.Data));
+			}
+		}
+	}
+
+	return 0;
+}
+
+void FCaptureWorker::Stop()
+{
+	bStopping = true;
+	FrameQueuedEvent->Trigger();
+}
+
+FCaptureWorker::FStats FCaptureWorker::GetStats() const
+{
+	FStats Stats;
+
+	{
+		FScopeLock Lock(&QueueSection);
+		Stats.QueueDepth = Queue.Num();
+	}
+
+	const uint32 Processed = FramesProcessed;
+
+	Stats.FramesDropped = FramesDropped;
+	Stats.AverageWaitUs = Processed > 0 ? TotalWaitUs / Processed : 0;
+	Stats.MaxWaitUs = MaxWaitUs;
+
+	return Stats;
+}
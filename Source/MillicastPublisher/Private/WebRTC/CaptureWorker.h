@@ -0,0 +1,88 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#pragma once
+
+#include "HAL/Runnable.h"
+#include "TextureReadbackRing.h"
+#include "FrameBufferPool.h"
+
+/**
+* Bounded queue of captured frames, processed on a dedicated thread.
+* The rendering thread only copies the readback data in a recycled buffer, the conversion and the
+* push to webrtc happen on the worker. Frames converted to NV12 on the GPU are copied straight into a frame buffer
+* of the NV12 pool, which the frame pushed to webrtc keeps, so they are copied once. When the queue is full, either the oldest queued frame or the
+* new one is dropped, so the encoder never lags behind the capture by more than the queue size.
+*/
+class FCaptureWorker : public FRunnable
+{
+public:
+	/** Which frame is dropped when a frame is captured while the queue is full */
+	enum class EDropPolicy : uint8
+	{
+		DropOldest, // Keep the latency low, the queued frame that waited the most is dropped
+		DropNewest  // Keep the frames regular, the new frame is dropped
+	};
+
+	/** Queue counters */
+	struct FStats
+	{
+		int32 QueueDepth = 0;     // Frames waiting for the worker
+		uint32 FramesDropped = 0; // Frames dropped because the queue was full
+		int64 AverageWaitUs = 0;  // Average time spent by a frame in the queue
+		int64 MaxWaitUs = 0;      // Longest time spent by a frame in the queue
+	};
+
+	using FNV12BufferPoolPtr = TSharedPtr<FNV12BufferPool, ESPMode::ThreadSafe>;
+
+	/** Called with the queued frame, and for an NV12 frame the pool buffer holding it, null otherwise */
+	using FProcessFrame = TFunction<void(const FTextureReadbackRing::FReadbackData&, const rtc::scoped_refptr<FNV12Buffer>&)>;
+
+	/**
+	* Start the worker thread, calling ProcessFrame for every queued frame.
+	* Without NV12 pool, NV12 frames are queued in a recycled buffer like the others
+	*/
+	FCaptureWorker(int32 InMaxQueuedFrames, EDropPolicy InDropPolicy, FProcessFrame InProcessFrame, FNV12BufferPoolPtr InNV12BufferPool = nullptr);
+	~FCaptureWorker();
+
+	/**
+	* Copy the frame out of the readback data, in a buffer of the NV12 pool for NV12 frames, and queue it.
+	* Called on the rendering thread.
+	* Returns false if the frame was dropped because the queue is full and the policy is DropNewest.
+	*/
+	bool Enqueue(const FTextureReadbackRing::FReadbackData& ReadbackData);
+
+	/** Get the queue counters. Can be called from any thread */
+	FStats GetStats() const;
+
+	// FRunnable
+	uint32 Run() override;
+	void Stop() override;
+
+private:
+	struct FQueuedFrame
+	{
+		TArray<uint8> Data;
+		rtc::scoped_refptr<FNV12Buffer> NV12Buffer;
+		FTextureReadbackRing::FReadbackData ReadbackData; // Pointing to Data, or to NV12Buffer
+		int64 EnqueueTimeUs = 0;
+	};
+
+	const int32 MaxQueuedFrames;
+	const EDropPolicy DropPolicy;
+	FProcessFrame ProcessFrame;
+	FNV12BufferPoolPtr NV12BufferPool;
+
+	/** Queued frames, oldest first, and the buffers of the processed ones, to be reused */
+	TArray<FQueuedFrame> Queue;
+	TArray<TArray<uint8>> FreeBuffers;
+	mutable FCriticalSection QueueSection;
+
+	FEvent* FrameQueuedEvent;
+	FRunnableThread* Thread;
+	TAtomic<bool> bStopping;
+
+	TAtomic<uint32> FramesDropped;
+	TAtomic<uint32> FramesProcessed;
+	TAtomic<int64> TotalWaitUs;
+	TAtomic<int64> MaxWaitUs;
+};
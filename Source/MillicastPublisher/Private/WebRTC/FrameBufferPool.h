@@ -0,0 +1,170 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#pragma once
+
+#include "WebRTCInc.h"
+
+/** Frame buffer pool counters */
+struct FFrameBufferPoolStats
+{
+	uint32 Hits = 0;          // Buffers reused from the pool
+	uint32 Misses = 0;        // Buffers that had to be allocated
+	uint64 ResidentBytes = 0; // Memory held by the pool, in use or not
+	int32 NumBuffers = 0;
+};
+
+inline uint64 GetFrameBufferSize(const webrtc::I420Buffer& Buffer)
+{
+	const uint64 ChromaHeight = Buffer.ChromaHeight();
+
+	return uint64(Buffer.StrideY()) * Buffer.height()
+		+ uint64(Buffer.StrideU()) * ChromaHeight
+		+ uint64(Buffer.StrideV()) * ChromaHeight;
+}
+
+#if WEBRTC_VERSION >= 96
+using FNV12Buffer = webrtc::NV12Buffer;
+#else
+/**
+* NV12 frame data for the webrtc versions without webrtc::NV12Buffer, with the members of it the capture uses.
+* The Y plane is followed by the interleaved U/V plane in a single allocation.
+*/
+class FNV12Buffer : public rtc::RefCountInterface
+{
+public:
+	static rtc::scoped_refptr<FNV12Buffer> Create(int Width, int Height)
+	{
+		return new rtc::RefCountedObject<FNV12Buffer>(Width, Height);
+	}
+
+	int width() const { return Width; }
+	int height() const { return Height; }
+	int ChromaHeight() const { return (Height + 1) / 2; }
+
+	int StrideY() const { return Width; }
+	int StrideUV() const { return (Width + 1) / 2 * 2; }
+
+	const uint8_t* DataY() const { return Data.GetData(); }
+	const uint8_t* DataUV() const { return Data.GetData() + StrideY() * Height; }
+	uint8_t* MutableDataY() { return Data.GetData(); }
+	uint8_t* MutableDataUV() { return Data.GetData() + StrideY() * Height; }
+
+protected:
+	FNV12Buffer(int InWidth, int InHeight) noexcept
+		: Width(InWidth), Height(InHeight)
+	{
+		Data.SetNumUninitialized(StrideY() * Height + StrideUV() * ChromaHeight());
+	}
+
+	~FNV12Buffer() override = default;
+
+private:
+	int Width;
+	int Height;
+	TArray<uint8_t, TAlignedHeapAllocator<64>> Data;
+};
+#endif
+
+inline uint64 GetFrameBufferSize(const FNV12Buffer& Buffer)
+{
+	return uint64(Buffer.StrideY()) * Buffer.height()
+		+ uint64(Buffer.StrideUV()) * Buffer.ChromaHeight();
+}
+
+/**
+* Pool of frame buffers, modelled on webrtc::I420BufferPool but keyed by size so several resolutions can be in use.
+* A buffer goes back to the pool as soon as the last reference outside the pool (usually the encoder's) is released.
+* Buffers can be created and released from any thread.
+*/
+template<typename BufferType>
+class TFrameBufferPool
+{
+public:
+	explicit TFrameBufferPool(int32 InMaxNumberOfBuffers = 8) noexcept
+		: MaxNumberOfBuffers(FMath::Max(InMaxNumberOfBuffers, 1))
+	{}
+
+	/**
+	* Get a buffer of the requested size, reusing a free one if possible.
+	* When all the pooled buffers are in use, a buffer that won't return to the pool is allocated.
+	* The content of the returned buffer is undefined.
+	*/
+	rtc::scoped_refptr<BufferType> CreateBuffer(int Width, int Height)
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		int32 EvictableIndex = INDEX_NONE;
+
+		for (int32 i = 0; i < Buffers.Num(); ++i)
+		{
+			FPooledBuffer* Buffer = Buffers[i].get();
+
+			// Only the pool holds a reference, the buffer is free
+			if (!Buffer->HasOneRef())
+			{
+				continue;
+			}
+
+			if (Buffer->width() == Width && Buffer->height() == Height)
+			{
+				++Stats.Hits;
+				return Buffers[i];
+			}
+
+			EvictableIndex = i;
+		}
+
+		++Stats.Misses;
+
+		// Make room for the new size by dropping a free buffer of another size
+		if (Buffers.Num() >= MaxNumberOfBuffers && EvictableIndex != INDEX_NONE)
+		{
+			Stats.ResidentBytes -= GetFrameBufferSize(*Buffers[EvictableIndex]);
+			Buffers.RemoveAtSwap(EvictableIndex);
+		}
+
+		if (Buffers.Num() >= MaxNumberOfBuffers)
+		{
+			return BufferType::Create(Width, Height);
+		}
+
+		rtc::scoped_refptr<FPooledBuffer> Buffer = new FPooledBuffer(Width, Height);
+		Stats.ResidentBytes += GetFrameBufferSize(*Buffer);
+		Buffers.Add(Buffer);
+
+		return Buffer;
+	}
+
+	/** Drop every buffer from the pool. Buffers still in use are freed once released */
+	void Release()
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		Buffers.Empty();
+		Stats.ResidentBytes = 0;
+	}
+
+	FFrameBufferPoolStats GetStats() const
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		FFrameBufferPoolStats Result = Stats;
+		Result.NumBuffers = Buffers.Num();
+
+		return Result;
+	}
+
+private:
+	/** Buffer constructors are protected, RefCountedObject gives access to them */
+	using FPooledBuffer = rtc::RefCountedObject<BufferType>;
+
+	TArray<rtc::scoped_refptr<FPooledBuffer>> Buffers;
+	int32 MaxNumberOfBuffers;
+
+	FFrameBufferPoolStats Stats;
+
+	mutable FCriticalSection CriticalSection;
+};
+
+using FI420BufferPool = TFrameBufferPool<webrtc::I420Buffer>;
+using FNV12BufferPool = TFrameBufferPool<FNV12Buffer>;
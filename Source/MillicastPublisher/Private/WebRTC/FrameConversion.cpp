@@ -0,0 +1,45 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "FrameConversion.h"
+
+#include "Async/ParallelFor.h"
+#include "Async/TaskGraphInterfaces.h"
+
+static TAutoConsoleVariable<int32> CVarMillicastConversionBands(
+	TEXT("Millicast.Publisher.ConversionBands"),
+	0,
+	TEXT("Number of bands of rows converted in parallel when converting a captured frame on the CPU. ")
+	TEXT("0 uses one band per task graph worker, 1 converts on the calling thread only."),
+	ECVF_Default);
+
+/** Below this, scheduling the tasks costs more than converting the rows */
+static constexpr int32 kMinRowsPerBand = 64;
+
+void FrameConversion::ParallelForRowBands(int32 Height, TFunctionRef<void(int32 FirstRow, int32 NumRows)> Convert)
+{
+	int32 NumBands = CVarMillicastConversionBands.GetValueOnAnyThread();
+	if (NumBands <= 0)
+	{
+		// The calling thread takes part in the conversion too
+		NumBands = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	}
+
+	NumBands = FMath::Clamp(NumBands, 1, FMath::Max(Height / kMinRowsPerBand, 1));
+
+	if (NumBands == 1)
+	{
+		Convert(0, Height);
+		return;
+	}
+
+	// Pairs of rows spread evenly over the bands, the last band also gets the odd row if any
+	const int32 NumRowPairs = Height / 2;
+
+	ParallelFor(NumBands, [&](int32 Band)
+	{
+		const int32 FirstRow = 2 * (NumRowPairs * Band / NumBands);
+		const int32 EndRow = Band == NumBands - 1 ? Height : 2 * (NumRowPairs * (Band + 1) / NumBands);
+
+		Convert(FirstRow, EndRow - FirstRow);
+	});
+}
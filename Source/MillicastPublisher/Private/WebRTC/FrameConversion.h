@@ -0,0 +1,15 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace FrameConversion
+{
+	/**
+	* Split a frame in bands of rows and call Convert for each of them in parallel on the task graph.
+	* Bands start on even rows, so the chroma rows of 4:2:0 formats are never shared by two bands.
+	* The number of bands is Millicast.Publisher.ConversionBands, or one per task graph worker by default.
+	*/
+	void ParallelForRowBands(int32 Height, TFunctionRef<void(int32 FirstRow, int32 NumRows)> Convert);
+}
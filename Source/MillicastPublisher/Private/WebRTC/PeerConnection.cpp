@@ -3,9 +3,12 @@
 #include "PeerConnection.h"
 #include "MillicastPublisherPrivate.h"
 
+#include <algorithm>
 #include <sstream>
 
 #include "AudioDeviceModule.h"
+#include "MillicastPublisherSource.h"
+#include "Util.h"
 
 rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> FWebRTCPeerConnection::PeerConnectionFactory = nullptr;
 TUniquePtr<rtc::Thread> FWebRTCPeerConnection::SignalingThread = nullptr;
@@ -47,8 +50,8 @@ void FWebRTCPeerConnection::CreatePeerConnectionFactory()
 
 	PeerConnectionFactory = webrtc::CreatePeerConnectionFactory(
 				nullptr, nullptr, SignalingThread.Get(), AudioDeviceModule,
-				webrtc::CreateAudioEncoderFactory<webrtc::AudioEncoderOpus>(),
-				webrtc::CreateAudioDecoderFactory<webrtc::AudioDecoderOpus>(),
+				webrtc::CreateAudioEncoderFactory<webrtc::AudioEncoderOpus, webrtc::AudioEncoderMultiChannelOpus>(),
+				webrtc::CreateAudioDecoderFactory<webrtc::AudioDecoderOpus, webrtc::AudioDecoderMultiChannelOpus>(),
 				webrtc::CreateBuiltinVideoEncoderFactory(),
 				webrtc::CreateBuiltinVideoDecoderFactory(),
 				nullptr, AudioProcessingModule
@@ -76,6 +79,118 @@ rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> FWebRTCPeerConnection
 	return PeerConnectionFactory;
 }
 
+std::vector<webrtc::RtpCodecCapability> FWebRTCPeerConnection::GetVideoCodecPreferences(const TArray<TEnumAsByte<VideoCodecType>>& PreferredCodecs)
+{
+	static const char* CodecNames[] = { cricket::kVp8CodecName, cricket::kVp9CodecName, cricket::kH264CodecName, cricket::kAv1CodecName };
+
+	const auto Capabilities = GetPeerConnectionFactory()->GetRtpSenderCapabilities(cricket::MEDIA_TYPE_VIDEO);
+
+	std::vector<webrtc::RtpCodecCapability> Codecs;
+	TArray<int32> AddedCodecs;
+
+	for (const auto& PreferredCodec : PreferredCodecs)
+	{
+		const int32 Codec = PreferredCodec.GetValue();
+		if (Codec < 0 || Codec >= int32(UE_ARRAY_COUNT(CodecNames)) || AddedCodecs.Contains(Codec))
+		{
+			continue;
+		}
+		AddedCodecs.Add(Codec);
+
+		// H264 has a capability per profile and packetization mode
+		const auto NumCodecs = Codecs.size();
+		for (const auto& Capability : Capabilities.codecs)
+		{
+			if (Capability.name == CodecNames[Codec])
+			{
+				Codecs.push_back(Capability);
+			}
+		}
+
+		if (Codecs.size() == NumCodecs)
+		{
+			UE_LOG(LogMillicastPublisher, Warning, TEXT("Video codec %S is not available"), CodecNames[Codec]);
+		}
+	}
+
+	if (Codecs.empty())
+	{
+		return Codecs;
+	}
+
+	for (const auto& Capability : Capabilities.codecs)
+	{
+		if (Capability.name == cricket::kRtxCodecName || Capability.name == cricket::kRedCodecName
+			|| Capability.name == cricket::kUlpfecCodecName || Capability.name == cricket::kFlexfecCodecName)
+		{
+			Codecs.push_back(Capability);
+		}
+	}
+
+	return Codecs;
+}
+
+std::vector<webrtc::RtpEncodingParameters> FWebRTCPeerConnection::MakeSendEncodings(const UMillicastPublisherSource& Source)
+{
+	const TArray<FMillicastSimulcastLayer>& Layers = Source.SimulcastLayers;
+	std::vector<webrtc::RtpEncodingParameters> Encodings;
+
+	for (int32 Index = 0; Index < Layers.Num(); ++Index)
+	{
+		const FMillicastSimulcastLayer& Layer = Layers[Index];
+
+		webrtc::RtpEncodingParameters Encoding;
+		Encoding.rid = Layer.Rid.IsEmpty() ? "l" + std::to_string(Index) : to_string(Layer.Rid);
+		Encoding.scale_resolution_down_by = FMath::Max(Layer.ScaleResolutionDownBy, 1.f);
+
+		if (Layer.MaxBitrate > 0)
+		{
+			Encoding.max_bitrate_bps = Layer.MaxBitrate * 1000;
+		}
+		if (Layer.MaxFramerate > 0)
+		{
+			Encoding.max_framerate = Layer.MaxFramerate;
+		}
+
+		Encodings.push_back(Encoding);
+	}
+
+	std::stable_sort(Encodings.begin(), Encodings.end(), [](const auto& A, const auto& B) {
+		return *A.scale_resolution_down_by > *B.scale_resolution_down_by;
+	});
+
+	// A single encoding is sent without simulcast, it doesn't need an identifier
+	if (Encodings.size() == 1)
+	{
+		Encodings[0].rid.clear();
+	}
+
+	if (Source.ScalabilityMode != VideoScalabilityMode::SCALABILITY_NONE)
+	{
+#if WEBRTC_VERSION >= 96
+		static const char* ModeNames[] = { "", "L1T2", "L1T3", "L3T3" };
+		const int32 Mode = FMath::Clamp<int32>(Source.ScalabilityMode.GetValue(), 0, UE_ARRAY_COUNT(ModeNames) - 1);
+
+		// The layers of a scalable stream already serve the viewers simulcast would, and webrtc can't send both
+		if (Encodings.size() > 1)
+		{
+			UE_LOG(LogMillicastPublisher, Warning, TEXT("Scalability mode %S is ignored with %d simulcast layers"), ModeNames[Mode], int32(Encodings.size()));
+			return Encodings;
+		}
+
+		if (Encodings.empty())
+		{
+			Encodings.emplace_back();
+		}
+		Encodings[0].scalability_mode = ModeNames[Mode];
+#else
+		UE_LOG(LogMillicastPublisher, Warning, TEXT("Scalability modes need a more recent webrtc version"));
+#endif
+	}
+
+	return Encodings;
+}
+
 rtc::scoped_refptr<FAudioDeviceModule> FWebRTCPeerConnection::GetAudioDeviceModule()
 {
 	if (PeerConnectionFactory == nullptr)
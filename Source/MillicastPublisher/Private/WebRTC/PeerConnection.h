@@ -4,6 +4,7 @@
 
 #include "WebRTC/WebRTCInc.h"
 #include "WebRTC/AudioDeviceModule.h"
+#include "IMillicastSource.h"
 
 #include "SessionDescriptionObserver.h"
 
@@ -14,6 +15,8 @@ class TaskQueueFactory;
 
 }  // webrtc
 
+class UMillicastPublisherSource;
+
 /*
  * Small wrapper for the WebRTC peerconnection
  */
@@ -58,6 +61,17 @@ public:
 	static rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> GetPeerConnectionFactory();
 	/** Get the audio device module */
 	static rtc::scoped_refptr<FAudioDeviceModule> GetAudioDeviceModule();
+	/**
+	* Video codecs sent by webrtc in the order of the preferred codecs, followed by the retransmission and error correction
+	* formats which protect them, to set as the codec preferences of the video transceiver. Empty if none of the preferred
+	* codecs is available
+	*/
+	static std::vector<webrtc::RtpCodecCapability> GetVideoCodecPreferences(const TArray<TEnumAsByte<VideoCodecType>>& PreferredCodecs);
+	/**
+	* Encodings of the video transceiver, from the lowest resolution to the highest as webrtc orders the simulcast streams.
+	* The scalability mode is applied to a single encoding only. Empty when the source sends the default single encoding
+	*/
+	static std::vector<webrtc::RtpEncodingParameters> MakeSendEncodings(const UMillicastPublisherSource& Source);
 
 	/** Get local description observer to set callback for set local description success or failure */
 	FSetSessionDescriptionObserver* GetLocalDescriptionObserver();
@@ -0,0 +1,231 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "PolyphaseResampler.h"
+
+namespace
+{
+	struct FQualitySettings
+	{
+		int32 NumTaps;
+		int32 NumPhases;
+		float KaiserBeta;
+		float Rolloff; // Cutoff, relative to the Nyquist frequency of the lowest rate
+	};
+
+	const FQualitySettings& GetQualitySettings(FPolyphaseResampler::EQuality Quality)
+	{
+		static const FQualitySettings Settings[] = {
+			{ 16, 64, 6.f, 0.90f },
+			{ 32, 128, 8.f, 0.93f },
+			{ 64, 256, 10.f, 0.95f },
+		};
+
+		return Settings[static_cast<int32>(Quality)];
+	}
+
+	/** Modified Bessel function of the first kind, order 0 */
+	double BesselI0(double X)
+	{
+		double Sum = 1.0;
+		double Term = 1.0;
+		for (int32 k = 1; k < 32; ++k)
+		{
+			Term *= (X / (2.0 * k)) * (X / (2.0 * k));
+			Sum += Term;
+		}
+		return Sum;
+	}
+
+	/** Dot product of Num samples with two rows of coefficients at once, Num being a multiple of 4 */
+	FORCEINLINE void DotProduct2(const float* Samples, const float* RowA, const float* RowB, int32 Num, float& OutA, float& OutB)
+	{
+		VectorRegister SumA = VectorZero();
+		VectorRegister SumB = VectorZero();
+
+		for (int32 i = 0; i < Num; i += 4)
+		{
+			const VectorRegister Values = VectorLoad(Samples + i);
+			SumA = VectorMultiplyAdd(Values, VectorLoad(RowA + i), SumA);
+			SumB = VectorMultiplyAdd(Values, VectorLoad(RowB + i), SumB);
+		}
+
+		alignas(16) float LanesA[4];
+		alignas(16) float LanesB[4];
+		VectorStoreAligned(SumA, LanesA);
+		VectorStoreAligned(SumB, LanesB);
+
+		OutA = (LanesA[0] + LanesA[1]) + (LanesA[2] + LanesA[3]);
+		OutB = (LanesB[0] + LanesB[1]) + (LanesB[2] + LanesB[3]);
+	}
+}
+
+FPolyphaseResampler::FPolyphaseResampler() noexcept
+	: InputRate(0), OutputRate(0), NumChannels(0), Quality(EQuality::Medium),
+	NumTaps(0), NumPhases(0), HistoryCapacity(0), NumBuffered(0), Position(0), Step(0), NominalStep(0)
+{}
+
+void FPolyphaseResampler::Configure(int32 InInputRate, int32 InOutputRate, int32 InNumChannels, EQuality InQuality)
+{
+	check(InInputRate > 0 && InOutputRate > 0 && InNumChannels > 0);
+
+	InputRate = InInputRate;
+	OutputRate = InOutputRate;
+	NumChannels = InNumChannels;
+	Quality = InQuality;
+
+	const FQualitySettings& Settings = GetQualitySettings(Quality);
+
+	// When decimating, the cutoff goes down with the output rate, so the filter has to be longer for the same transition band
+	const int32 Decimation = FMath::DivideAndRoundUp(InputRate, OutputRate);
+	NumTaps = Settings.NumTaps * Decimation;
+	NumPhases = Settings.NumPhases;
+
+	// Cutoff in cycles per input sample
+	const double Cutoff = 0.5 * Settings.Rolloff * FMath::Min(1.0, double(OutputRate) / InputRate);
+	const double HalfLength = NumTaps / 2;
+	const double WindowScale = 1.0 / BesselI0(Settings.KaiserBeta);
+
+	Coefficients.SetNumUninitialized((NumPhases + 1) * NumTaps);
+
+	for (int32 Phase = 0; Phase <= NumPhases; ++Phase)
+	{
+		float* Row = Coefficients.GetData() + Phase * NumTaps;
+		double Sum = 0.0;
+
+		for (int32 Tap = 0; Tap < NumTaps; ++Tap)
+		{
+			// Distance between the input sample of this tap and the output sample, in input samples
+			const double Time = Tap - (HalfLength - 1) - double(Phase) / NumPhases;
+			const double X = 2.0 * Cutoff * Time;
+			const double Sinc = FMath::Abs(X) < 1e-9 ? 1.0 : FMath::Sin(PI * X) / (PI * X);
+
+			const double WindowPosition = Time / HalfLength;
+			const double Window = FMath::Abs(WindowPosition) < 1.0
+				? BesselI0(Settings.KaiserBeta * FMath::Sqrt(1.0 - WindowPosition * WindowPosition)) * WindowScale
+				: 0.0;
+
+			Row[Tap] = float(Sinc * Window);
+			Sum += Row[Tap];
+		}
+
+		// Unity gain at DC for every phase
+		for (int32 Tap = 0; Tap < NumTaps; ++Tap)
+		{
+			Row[Tap] = float(Row[Tap] / Sum);
+		}
+	}
+
+	NominalStep = (uint64(InputRate) << 32) / OutputRate;
+	Step = NominalStep;
+
+	// Room for the filter and 20 ms of input, enough for the usual audio buffers
+	HistoryCapacity = NumTaps + InputRate / 50;
+	History.SetNumZeroed(HistoryCapacity * NumChannels);
+
+	Reset();
+}
+
+void FPolyphaseResampler::Reset()
+{
+	// The first output frame is centered on the first input frame, with silence before it
+	NumBuffered = FMath::Max(NumTaps / 2 - 1, 0);
+	Position = 0;
+
+	FMemory::Memzero(History.GetData(), History.Num() * sizeof(float));
+}
+
+void FPolyphaseResampler::SetRatioAdjustment(double Ppm)
+{
+	Step = uint64(double(NominalStep) * (1.0 + Ppm * 1e-6));
+}
+
+int32 FPolyphaseResampler::GetNumOutputFrames(int32 NumInputFrames) const
+{
+	// Output frames need NumTaps input frames from the integer part of their position
+	const int64 LastIndex = int64(NumBuffered) + NumInputFrames - NumTaps;
+	if (Step == 0 || LastIndex < 0 || (uint64(LastIndex + 1) << 32) <= Position)
+	{
+		return 0;
+	}
+
+	const uint64 LastPosition = (uint64(LastIndex + 1) << 32) - 1;
+	return int32((LastPosition - Position) / Step) + 1;
+}
+
+int32 FPolyphaseResampler::Process(const float* In, int32 NumInputFrames, float* Out)
+{
+	checkSlow(NumTaps > 0);
+
+	// Grow the history for bigger input buffers only, it doesn't shrink
+	const int32 NumRequired = NumBuffered + NumInputFrames;
+	if (NumRequired > HistoryCapacity)
+	{
+		TArray<float> NewHistory;
+		NewHistory.SetNumZeroed(NumRequired * NumChannels);
+
+		for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+		{
+			FMemory::Memcpy(NewHistory.GetData() + Channel * NumRequired, History.GetData() + Channel * HistoryCapacity, NumBuffered * sizeof(float));
+		}
+
+		History = MoveTemp(NewHistory);
+		HistoryCapacity = NumRequired;
+	}
+
+	// Deinterleave, so every channel is filtered on contiguous samples
+	for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+	{
+		float* Plane = History.GetData() + Channel * HistoryCapacity + NumBuffered;
+		for (int32 Frame = 0; Frame < NumInputFrames; ++Frame)
+		{
+			Plane[Frame] = In[Frame * NumChannels + Channel];
+		}
+	}
+	NumBuffered += NumInputFrames;
+
+	int32 NumOutputFrames = 0;
+
+	for (;;)
+	{
+		const int32 Index = int32(Position >> 32);
+		if (Index + NumTaps > NumBuffered)
+		{
+			break;
+		}
+
+		// Fraction of input frame in 32 bits, split in a phase and a blend factor between it and the next phase
+		const uint64 PhasePosition = (Position & 0xFFFFFFFF) * NumPhases;
+		const int32 Phase = int32(PhasePosition >> 32);
+		const float Blend = float(uint32(PhasePosition)) * (1.f / 4294967296.f);
+
+		const float* RowA = Coefficients.GetData() + Phase * NumTaps;
+		const float* RowB = RowA + NumTaps;
+
+		for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+		{
+			float A, B;
+			DotProduct2(History.GetData() + Channel * HistoryCapacity + Index, RowA, RowB, NumTaps, A, B);
+
+			Out[NumOutputFrames * NumChannels + Channel] = A + (B - A) * Blend;
+		}
+
+		++NumOutputFrames;
+		Position += Step;
+	}
+
+	// Drop the input frames no output frame needs anymore
+	const int32 Consumed = FMath::Min(int32(Position >> 32), NumBuffered);
+	if (Consumed > 0)
+	{
+		for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+		{
+			float* Plane = History.GetData() + Channel * HistoryCapacity;
+			FMemory::Memmove(Plane, Plane + Consumed, (NumBuffered - Consumed) * sizeof(float));
+		}
+
+		NumBuffered -= Consumed;
+		Position -= uint64(Consumed) << 32;
+	}
+
+	return NumOutputFrames;
+}
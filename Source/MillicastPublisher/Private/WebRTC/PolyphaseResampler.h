@@ -0,0 +1,74 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+* Streaming resampler for interleaved float audio, based on a Kaiser windowed sinc filter.
+* The filter is tabulated for a fixed number of phases, and the coefficients of the two closest phases
+* are interpolated, so any ratio is supported and it can be changed while streaming without glitches.
+* Once configured, Process doesn't allocate as long as the input buffers don't get bigger.
+*/
+class FPolyphaseResampler
+{
+public:
+	/** Filter length and stop band attenuation, against CPU cost */
+	enum class EQuality : uint8
+	{
+		Low,    // 16 taps, around 60 dB
+		Medium, // 32 taps, around 80 dB
+		High    // 64 taps, around 100 dB
+	};
+
+	FPolyphaseResampler() noexcept;
+
+	/** Build the filter and reset the stream. This allocates, so it should only be called when the input format changes */
+	void Configure(int32 InInputRate, int32 InOutputRate, int32 InNumChannels, EQuality InQuality);
+
+	/** Whether the resampler is already set up for this conversion */
+	bool IsConfigured(int32 InInputRate, int32 InOutputRate, int32 InNumChannels, EQuality InQuality) const
+	{
+		return InputRate == InInputRate && OutputRate == InOutputRate && NumChannels == InNumChannels && Quality == InQuality;
+	}
+
+	/** Forget the buffered input, keeping the filter */
+	void Reset();
+
+	/**
+	* Consume the input faster (positive) or slower (negative) than the configured ratio, in parts per million.
+	* Used to follow a drifting input clock, takes effect on the next output frame.
+	*/
+	void SetRatioAdjustment(double Ppm);
+
+	/** Exact number of frames the next call to Process will output for NumInputFrames */
+	int32 GetNumOutputFrames(int32 NumInputFrames) const;
+
+	/** Resample interleaved frames. Out must hold GetNumOutputFrames(NumInputFrames) frames. Returns the number of frames written */
+	int32 Process(const float* In, int32 NumInputFrames, float* Out);
+
+	/** Input frames buffered for the filter, which is the delay added by the resampler */
+	int32 GetNumBufferedFrames() const { return NumBuffered; }
+
+private:
+	int32 InputRate;
+	int32 OutputRate;
+	int32 NumChannels;
+	EQuality Quality;
+
+	int32 NumTaps;   // Multiple of 4
+	int32 NumPhases;
+
+	/** NumPhases + 1 rows of NumTaps coefficients, the last one being the first one delayed by one frame */
+	TArray<float> Coefficients;
+
+	/** Input frames not consumed yet, one plane of HistoryCapacity samples per channel */
+	TArray<float> History;
+	int32 HistoryCapacity;
+	int32 NumBuffered;
+
+	/** Position of the next output frame in History, and increment per output frame, in 32.32 fixed point */
+	uint64 Position;
+	uint64 Step;
+	uint64 NominalStep; // Without ratio adjustment
+};
@@ -0,0 +1,176 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "ReadbackPool.h"
+
+#include "MillicastPublisherPrivate.h"
+
+static TAutoConsoleVariable<int32> CVarMillicastReadbackPoolMaxMB(
+	TEXT("Millicast.Publisher.ReadbackPoolMaxMB"),
+	0,
+	TEXT("Maximum staging memory held by the GPU readbacks of a video capture, in MB. ")
+	TEXT("0 to size it to the readback ring, two 4K RGBA frames per slot. Negative for no limit."),
+	ECVF_Default);
+
+namespace
+{
+	// Largest row pitch alignment of the staging textures among the RHIs (D3D12)
+	constexpr int64 kReadbackPitchAlignment = 256;
+
+	// Readbacks per ring slot the default cap makes room for, the one in flight and the one replacing it
+	constexpr int64 kDefaultReadbacksPerSlot = 2;
+	constexpr int64 kDefaultReadbackBytes = int64(3840) * 2160 * 4;
+
+	// Idle readbacks kept per size and format, enough to refill a ring switching back and forth
+	constexpr int32 kMaxIdleReadbacksPerKey = 2;
+
+	// Frames after which the idle readbacks of a size and format no longer requested are released
+	constexpr uint64 kMaxIdleFrames = 120;
+}
+
+FReadbackPool::FReadbackPool(int32 InNumSlots) noexcept
+	: NumSlots(FMath::Max(InNumSlots, 1))
+{
+}
+
+int64 FReadbackPool::GetReadbackBytes(FIntPoint Size, EPixelFormat Format)
+{
+	const FPixelFormatInfo& FormatInfo = GPixelFormats[Format];
+
+	const int64 RowBytes = int64(FMath::DivideAndRoundUp(Size.X, FormatInfo.BlockSizeX)) * FormatInfo.BlockBytes;
+	const int64 NumRows = FMath::DivideAndRoundUp(Size.Y, FormatInfo.BlockSizeY);
+
+	return Align(RowBytes, kReadbackPitchAlignment) * NumRows;
+}
+
+int64 FReadbackPool::GetMaxBytes() const
+{
+	const int32 MaxMB = CVarMillicastReadbackPoolMaxMB.GetValueOnAnyThread();
+	if (MaxMB == 0)
+	{
+		return NumSlots * kDefaultReadbacksPerSlot * kDefaultReadbackBytes;
+	}
+
+	return MaxMB > 0 ? int64(MaxMB) * 1024 * 1024 : 0;
+}
+
+void FReadbackPool::Evict(int32 Index)
+{
+	Stats.ResidentBytes -= GetReadbackBytes(IdleReadbacks[Index].Size, IdleReadbacks[Index].Format);
+	--Stats.NumReadbacks;
+	++Stats.Evictions;
+
+	IdleReadbacks.RemoveAt(Index);
+}
+
+void FReadbackPool::AdvanceFrame()
+{
+	check(IsInRenderingThread());
+
+	FScopeLock Lock(&CriticalSection);
+
+	++NumFrames;
+
+	for (int32 Index = IdleReadbacks.Num() - 1; Index >= 0; --Index)
+	{
+		if (NumFrames - IdleReadbacks[Index].LastRequested > kMaxIdleFrames)
+		{
+			Evict(Index);
+		}
+	}
+}
+
+TUniquePtr<FRHIGPUTextureReadback> FReadbackPool::Acquire(FIntPoint Size, EPixelFormat Format)
+{
+	check(IsInRenderingThread());
+
+	FScopeLock Lock(&CriticalSection);
+
+	int32 Index = INDEX_NONE;
+	for (int32 IdleIndex = 0; IdleIndex < IdleReadbacks.Num(); ++IdleIndex)
+	{
+		FIdleReadback& Idle = IdleReadbacks[IdleIndex];
+		if (Idle.Size == Size && Idle.Format == Format)
+		{
+			// Still wanted, even the ones left idle
+			Idle.LastRequested = NumFrames;
+			Index = IdleIndex;
+		}
+	}
+
+	if (Index != INDEX_NONE)
+	{
+		TUniquePtr<FRHIGPUTextureReadback> Readback = MoveTemp(IdleReadbacks[Index].Readback);
+		IdleReadbacks.RemoveAt(Index);
+		++Stats.Hits;
+		return Readback;
+	}
+
+	const int64 Bytes = GetReadbackBytes(Size, Format);
+	if (!MakeRoom(Bytes))
+	{
+		if (Stats.Refused++ == 0)
+		{
+			UE_LOG(LogMillicastPublisher, Warning, TEXT("Capture readbacks are over Millicast.Publisher.ReadbackPoolMaxMB, frames are dropped"));
+		}
+		return nullptr;
+	}
+
+	++Stats.Misses;
+	++Stats.NumReadbacks;
+	Stats.ResidentBytes += Bytes;
+
+	return MakeUnique<FRHIGPUTextureReadback>(TEXT("MillicastCaptureReadback"));
+}
+
+void FReadbackPool::Release(TUniquePtr<FRHIGPUTextureReadback> Readback, FIntPoint Size, EPixelFormat Format)
+{
+	check(IsInRenderingThread());
+
+	if (!Readback.IsValid())
+	{
+		return;
+	}
+
+	FScopeLock Lock(&CriticalSection);
+
+	FIdleReadback& Idle = IdleReadbacks.AddDefaulted_GetRef();
+	Idle.Readback = MoveTemp(Readback);
+	Idle.Size = Size;
+	Idle.Format = Format;
+	Idle.LastRequested = NumFrames;
+
+	// Release the least recently released ones beyond the idle readbacks kept for this size and format
+	int32 NumIdle = 0;
+	for (int32 Index = IdleReadbacks.Num() - 1; Index >= 0; --Index)
+	{
+		if (IdleReadbacks[Index].Size == Size && IdleReadbacks[Index].Format == Format && ++NumIdle > kMaxIdleReadbacksPerKey)
+		{
+			Evict(Index);
+		}
+	}
+
+	// The cap may have been lowered in the meantime
+	MakeRoom(0);
+}
+
+bool FReadbackPool::MakeRoom(int64 NewBytes)
+{
+	const int64 MaxBytes = GetMaxBytes();
+	if (MaxBytes <= 0)
+	{
+		return true;
+	}
+
+	while (Stats.ResidentBytes + NewBytes > MaxBytes && IdleReadbacks.Num() > 0)
+	{
+		Evict(0);
+	}
+
+	return Stats.ResidentBytes + NewBytes <= MaxBytes;
+}
+
+FReadbackPoolStats FReadbackPool::GetStats() const
+{
+	FScopeLock Lock(&CriticalSection);
+	return Stats;
+}
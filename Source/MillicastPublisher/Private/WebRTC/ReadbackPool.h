@@ -0,0 +1,73 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#pragma once
+
+#include "RHI.h"
+#include "RHIGPUReadback.h"
+
+/** Readback pool counters */
+struct FReadbackPoolStats
+{
+	uint32 Hits = 0;          // Readbacks reused from the pool
+	uint32 Misses = 0;        // Readbacks that had to be created
+	uint32 Evictions = 0;     // Idle readbacks released to stay under the memory cap, or no longer requested
+	uint32 Refused = 0;       // Readbacks that could not be created without going over the memory cap
+	int32 NumReadbacks = 0;   // Readbacks in use or idle
+	int64 ResidentBytes = 0;  // Staging memory of all the readbacks
+};
+
+/**
+* Pool of GPU readbacks, keyed by the size and format of the texture they copy.
+* The staging texture of a readback is created on its first copy, so a readback reused for the same
+* size and format doesn't allocate anything. At most two readbacks are kept idle per size and format,
+* and they are released once their size and format hasn't been requested for a few seconds of capture,
+* or when the resident memory goes over Millicast.Publisher.ReadbackPoolMaxMB.
+* Acquire, Release and AdvanceFrame must only be called from the rendering thread.
+*/
+class FReadbackPool
+{
+public:
+	/** The default memory cap is sized for the readbacks of a ring of NumSlots slots */
+	explicit FReadbackPool(int32 InNumSlots = 1) noexcept;
+
+	/** Get an idle readback for this size and format, or create one. Returns nullptr if it would go over the memory cap */
+	TUniquePtr<FRHIGPUTextureReadback> Acquire(FIntPoint Size, EPixelFormat Format);
+
+	/** Give back a readback acquired for this size and format. It must not be in flight anymore */
+	void Release(TUniquePtr<FRHIGPUTextureReadback> Readback, FIntPoint Size, EPixelFormat Format);
+
+	/** Count a captured frame, releasing the idle readbacks whose size and format is no longer requested */
+	void AdvanceFrame();
+
+	/** Get the pool counters. Can be called from any thread */
+	FReadbackPoolStats GetStats() const;
+
+private:
+	struct FIdleReadback
+	{
+		TUniquePtr<FRHIGPUTextureReadback> Readback;
+		FIntPoint Size;
+		EPixelFormat Format;
+		uint64 LastRequested; // Frame this size and format was last requested
+	};
+
+	/** Staging memory of a readback, rows aligned to the copy pitch of the RHI */
+	static int64 GetReadbackBytes(FIntPoint Size, EPixelFormat Format);
+
+	int64 GetMaxBytes() const;
+
+	/** Release an idle readback */
+	void Evict(int32 Index);
+
+	/** Release the least recently used idle readbacks until NewBytes more fit under the cap. Returns false if they don't */
+	bool MakeRoom(int64 NewBytes);
+
+	/** Idle readbacks, least recently released first */
+	TArray<FIdleReadback> IdleReadbacks;
+
+	const int32 NumSlots;
+	uint64 NumFrames = 0;
+
+	FReadbackPoolStats Stats;
+	mutable FCriticalSection CriticalSection;
+};
@@ -0,0 +1,449 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "SdpEditor.h"
+#include "MillicastPublisherPrivate.h"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+static const std::string kRtpmapPrefix = "a=rtpmap:";
+static const std::string kFmtpPrefix = "a=fmtp:";
+
+static bool EqualsIgnoreCase(const std::string& A, const std::string& B)
+{
+	return A.size() == B.size() && std::equal(A.begin(), A.end(), B.begin(), [](char a, char b) {
+		return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+	});
+}
+
+static std::string Trim(const std::string& Value)
+{
+	const auto First = Value.find_first_not_of(' ');
+	const auto Last = Value.find_last_not_of(' ');
+	return First != std::string::npos ? Value.substr(First, Last - First + 1) : std::string();
+}
+
+/** Split a=<attribute>:<payload type> <value> */
+static bool ParseFormatLine(const std::string& Line, const std::string& Prefix, std::string& PayloadType, std::string& Value)
+{
+	if (Line.compare(0, Prefix.size(), Prefix) != 0)
+	{
+		return false;
+	}
+
+	const auto Space = Line.find(' ', Prefix.size());
+	if (Space == std::string::npos)
+	{
+		return false;
+	}
+
+	PayloadType = Line.substr(Prefix.size(), Space - Prefix.size());
+	Value = Line.substr(Space + 1);
+	return true;
+}
+
+/** Retransmission and error correction formats protect the video codecs, they have no bitrate of their own */
+static bool IsVideoCodec(const std::string& Codec)
+{
+	return !EqualsIgnoreCase(Codec, "rtx") && !EqualsIgnoreCase(Codec, "red")
+		&& !EqualsIgnoreCase(Codec, "ulpfec") && !EqualsIgnoreCase(Codec, "flexfec-03");
+}
+
+template<typename FilterType, typename FunctionType>
+int32 FSdpEditor::ForEachFormat(const std::string& Kind, FilterType&& Filter, FunctionType&& Function)
+{
+	int32 NumVisited = 0;
+	for (FMediaSection& Section : MediaSections)
+	{
+		if (Section.Kind != Kind)
+		{
+			continue;
+		}
+
+		for (FFormat& Format : Section.Formats)
+		{
+			if (Filter(Format))
+			{
+				Function(Format);
+				++NumVisited;
+			}
+		}
+	}
+	return NumVisited;
+}
+
+bool FSdpEditor::Parse(const std::string& Sdp)
+{
+	SessionLines.Empty();
+	MediaSections.Empty();
+
+	std::istringstream Stream(Sdp);
+	std::string Line;
+	while (std::getline(Stream, Line))
+	{
+		if (!Line.empty() && Line.back() == '\r')
+		{
+			Line.pop_back();
+		}
+		if (Line.empty())
+		{
+			continue;
+		}
+
+		// m=<kind> <port> <proto> <payload types>
+		if (Line.compare(0, 2, "m=") == 0)
+		{
+			FMediaSection& Section = MediaSections.AddDefaulted_GetRef();
+			Section.MLine = Line;
+
+			std::istringstream MLine(Line.substr(2));
+			MLine >> Section.Kind >> Section.Port >> Section.Proto;
+
+			std::string PayloadType;
+			while (MLine >> PayloadType)
+			{
+				Section.Formats.AddDefaulted_GetRef().PayloadType = PayloadType;
+			}
+			continue;
+		}
+
+		if (MediaSections.Num() == 0)
+		{
+			SessionLines.Add(Line);
+			continue;
+		}
+
+		FMediaSection& Section = MediaSections.Last();
+		Section.Lines.Add(Line);
+
+		std::string PayloadType, Value;
+		if (ParseFormatLine(Line, kRtpmapPrefix, PayloadType, Value))
+		{
+			const int32 Index = FindFormat(Section, PayloadType);
+			if (Index != INDEX_NONE)
+			{
+				Section.Formats[Index].Encoding = Value;
+				Section.Formats[Index].Codec = Value.substr(0, Value.find('/'));
+			}
+		}
+		else if (ParseFormatLine(Line, kFmtpPrefix, PayloadType, Value))
+		{
+			const int32 Index = FindFormat(Section, PayloadType);
+			if (Index != INDEX_NONE)
+			{
+				Section.Formats[Index].bHasFmtpLine = true;
+				ParseFmtp(Value, Section.Formats[Index]);
+			}
+		}
+	}
+
+	return MediaSections.Num() > 0;
+}
+
+std::string FSdpEditor::ToString() const
+{
+	std::string Sdp;
+	for (const std::string& Line : SessionLines)
+	{
+		Sdp += Line + "\r\n";
+	}
+
+	for (const FMediaSection& Section : MediaSections)
+	{
+		if (Section.bFormatsReordered)
+		{
+			Sdp += "m=" + Section.Kind + " " + Section.Port + " " + Section.Proto;
+			for (const FFormat& Format : Section.Formats)
+			{
+				Sdp += " " + Format.PayloadType;
+			}
+			Sdp += "\r\n";
+		}
+		else
+		{
+			Sdp += Section.MLine + "\r\n";
+		}
+
+		for (const std::string& Line : Section.Lines)
+		{
+			std::string PayloadType, Value;
+			if (ParseFormatLine(Line, kFmtpPrefix, PayloadType, Value))
+			{
+				const int32 Index = FindFormat(Section, PayloadType);
+				if (Index != INDEX_NONE && Section.Formats[Index].bParametersChanged)
+				{
+					// Dropped when no parameter is left
+					if (Section.Formats[Index].Parameters.Num() > 0)
+					{
+						Sdp += WriteFmtp(Section.Formats[Index]) + "\r\n";
+					}
+					continue;
+				}
+			}
+
+			Sdp += Line + "\r\n";
+
+			// A format which had no parameters gets its fmtp line after its rtpmap line
+			if (ParseFormatLine(Line, kRtpmapPrefix, PayloadType, Value))
+			{
+				const int32 Index = FindFormat(Section, PayloadType);
+				if (Index != INDEX_NONE && !Section.Formats[Index].bHasFmtpLine && Section.Formats[Index].Parameters.Num() > 0)
+				{
+					Sdp += WriteFmtp(Section.Formats[Index]) + "\r\n";
+				}
+			}
+		}
+	}
+
+	return Sdp;
+}
+
+void FSdpEditor::Apply(const FSdpCodecProfile& Profile)
+{
+	if (!Profile.PreferredAudioFormat.empty() && !PreferFormat("audio", Profile.PreferredAudioFormat))
+	{
+		UE_LOG(LogMillicastPublisher, Warning, TEXT("Audio format %S is not offered"), Profile.PreferredAudioFormat.c_str());
+	}
+
+	ApplyCodecParameters(Profile);
+}
+
+void FSdpEditor::ApplyCodecParameters(const FSdpCodecProfile& Profile)
+{
+	// A media attribute, RFC 7587 doesn't define it as an opus parameter
+	if (Profile.AudioPtime.IsSet())
+	{
+		SetMediaAttribute("audio", "ptime", std::to_string(*Profile.AudioPtime));
+	}
+
+	auto SetFlag = [this](const char* Codec, const char* Name, const TOptional<bool>& bValue) {
+		if (bValue.IsSet())
+		{
+			SetFmtpParameter("audio", Codec, Name, *bValue ? "1" : "0");
+		}
+	};
+
+	for (const char* Codec : { "opus", "multiopus" })
+	{
+		if (Profile.OpusMaxAverageBitrate.IsSet())
+		{
+			SetFmtpParameter("audio", Codec, "maxaveragebitrate", std::to_string(*Profile.OpusMaxAverageBitrate));
+		}
+
+		SetFlag(Codec, "usedtx", Profile.bOpusDtx);
+		SetFlag(Codec, "useinbandfec", Profile.bOpusFec);
+		SetFlag(Codec, "cbr", Profile.bOpusCbr);
+	}
+
+	SetFlag("opus", "stereo", Profile.bOpusStereo);
+
+	const TPair<const char*, const TOptional<int32>*> VideoBitrates[] = {
+		{ "x-google-start-bitrate", &Profile.VideoStartBitrate },
+		{ "x-google-min-bitrate", &Profile.VideoMinBitrate },
+		{ "x-google-max-bitrate", &Profile.VideoMaxBitrate },
+	};
+
+	for (const auto& Bitrate : VideoBitrates)
+	{
+		if (Bitrate.Value->IsSet())
+		{
+			const std::string Value = std::to_string(**Bitrate.Value);
+			ForEachFormat("video", [](const FFormat& Format) { return IsVideoCodec(Format.Codec); },
+				[&Bitrate, &Value](FFormat& Format) { SetParameter(Format, Bitrate.Key, Value); });
+		}
+	}
+}
+
+bool FSdpEditor::PreferFormat(const std::string& Kind, const std::string& Encoding)
+{
+	bool bFound = false;
+	for (FMediaSection& Section : MediaSections)
+	{
+		if (Section.Kind != Kind)
+		{
+			continue;
+		}
+
+		const int32 Index = Section.Formats.IndexOfByPredicate([&Encoding](const FFormat& Format) {
+			return EqualsIgnoreCase(Format.Encoding, Encoding);
+		});
+		if (Index == INDEX_NONE)
+		{
+			continue;
+		}
+
+		bFound = true;
+		if (Index > 0)
+		{
+			FFormat Format = MoveTemp(Section.Formats[Index]);
+			Section.Formats.RemoveAt(Index);
+			Section.Formats.Insert(MoveTemp(Format), 0);
+			Section.bFormatsReordered = true;
+		}
+	}
+	return bFound;
+}
+
+int32 FSdpEditor::SetFmtpParameter(const std::string& Kind, const std::string& Codec, const std::string& Name, const std::string& Value)
+{
+	return ForEachFormat(Kind, [&Codec](const FFormat& Format) { return EqualsIgnoreCase(Format.Codec, Codec); },
+		[&Name, &Value](FFormat& Format) { SetParameter(Format, Name, Value); });
+}
+
+int32 FSdpEditor::RemoveFmtpParameter(const std::string& Kind, const std::string& Codec, const std::string& Name)
+{
+	int32 NumChanged = 0;
+	ForEachFormat(Kind, [&Codec](const FFormat& Format) { return EqualsIgnoreCase(Format.Codec, Codec); },
+		[&Name, &NumChanged](FFormat& Format) {
+			if (Format.Parameters.RemoveAll([&Name](const auto& Parameter) { return Parameter.Key == Name; }) > 0)
+			{
+				Format.bParametersChanged = true;
+				++NumChanged;
+			}
+		});
+	return NumChanged;
+}
+
+TOptional<std::string> FSdpEditor::GetFmtpParameter(const std::string& Kind, const std::string& Codec, const std::string& Name) const
+{
+	for (const FMediaSection& Section : MediaSections)
+	{
+		if (Section.Kind != Kind)
+		{
+			continue;
+		}
+
+		for (const FFormat& Format : Section.Formats)
+		{
+			if (EqualsIgnoreCase(Format.Codec, Codec))
+			{
+				for (const auto& Parameter : Format.Parameters)
+				{
+					if (Parameter.Key == Name)
+					{
+						return Parameter.Value;
+					}
+				}
+				return {};
+			}
+		}
+	}
+	return {};
+}
+
+int32 FSdpEditor::SetMediaAttribute(const std::string& Kind, const std::string& Name, const std::string& Value)
+{
+	const std::string Prefix = "a=" + Name + ":";
+	const std::string Line = Prefix + Value;
+
+	int32 NumChanged = 0;
+	for (FMediaSection& Section : MediaSections)
+	{
+		if (Section.Kind != Kind)
+		{
+			continue;
+		}
+
+		std::string* Attribute = Section.Lines.FindByPredicate([&Prefix](const std::string& Line) {
+			return Line.compare(0, Prefix.size(), Prefix) == 0;
+		});
+
+		if (Attribute)
+		{
+			*Attribute = Line;
+		}
+		else
+		{
+			Section.Lines.Add(Line);
+		}
+		++NumChanged;
+	}
+	return NumChanged;
+}
+
+TOptional<std::string> FSdpEditor::GetMediaAttribute(const std::string& Kind, const std::string& Name) const
+{
+	const std::string Prefix = "a=" + Name + ":";
+
+	for (const FMediaSection& Section : MediaSections)
+	{
+		if (Section.Kind != Kind)
+		{
+			continue;
+		}
+
+		for (const std::string& Line : Section.Lines)
+		{
+			if (Line.compare(0, Prefix.size(), Prefix) == 0)
+			{
+				return Line.substr(Prefix.size());
+			}
+		}
+		return {};
+	}
+	return {};
+}
+
+int32 FSdpEditor::FindFormat(const FMediaSection& Section, const std::string& PayloadType)
+{
+	return Section.Formats.IndexOfByPredicate([&PayloadType](const FFormat& Format) { return Format.PayloadType == PayloadType; });
+}
+
+void FSdpEditor::SetParameter(FFormat& Format, const std::string& Name, const std::string& Value)
+{
+	auto* Parameter = Format.Parameters.FindByPredicate([&Name](const auto& Parameter) { return Parameter.Key == Name; });
+	if (Parameter)
+	{
+		Parameter->Value = Value;
+	}
+	else
+	{
+		Format.Parameters.Emplace(Name, Value);
+	}
+	Format.bParametersChanged = true;
+}
+
+void FSdpEditor::ParseFmtp(const std::string& Value, FFormat& Format)
+{
+	// <name>=<value>;<name>=<value>, or a value of its own like 0-15 for telephone-event
+	std::istringstream Stream(Value);
+	std::string Parameter;
+	while (std::getline(Stream, Parameter, ';'))
+	{
+		Parameter = Trim(Parameter);
+		if (Parameter.empty())
+		{
+			continue;
+		}
+
+		const auto Equal = Parameter.find('=');
+		if (Equal != std::string::npos)
+		{
+			Format.Parameters.Emplace(Trim(Parameter.substr(0, Equal)), Trim(Parameter.substr(Equal + 1)));
+		}
+		else
+		{
+			Format.Parameters.Emplace(Parameter, TOptional<std::string>());
+		}
+	}
+}
+
+std::string FSdpEditor::WriteFmtp(const FFormat& Format)
+{
+	std::string Line = kFmtpPrefix + Format.PayloadType + " ";
+	for (int32 Index = 0; Index < Format.Parameters.Num(); ++Index)
+	{
+		const auto& Parameter = Format.Parameters[Index];
+		if (Index > 0)
+		{
+			Line += ";";
+		}
+		Line += Parameter.Key;
+		if (Parameter.Value.IsSet())
+		{
+			Line += "=" + *Parameter.Value;
+		}
+	}
+	return Line;
+}
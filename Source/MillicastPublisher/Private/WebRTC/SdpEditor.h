@@ -0,0 +1,127 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include <string>
+
+/**
+* Codec parameters written in the offer, and in the answer for the ones webrtc configures the encoders from.
+* The unset ones are left as they were negotiated
+*/
+struct FSdpCodecProfile
+{
+	/** Encoding of the audio format negotiated first, like multiopus/48000/6. Empty keeps the order webrtc offered */
+	std::string PreferredAudioFormat;
+
+	/** Audio packet duration, in ms (10, 20, 40 or 60). Written as the a=ptime attribute of the audio sections */
+	TOptional<int32> AudioPtime;
+
+	/** Applied to opus and multiopus */
+	TOptional<int32> OpusMaxAverageBitrate; // in bps
+	TOptional<bool> bOpusDtx;
+	TOptional<bool> bOpusFec;
+	TOptional<bool> bOpusCbr;
+
+	/** Applied to opus only, multiopus sets its channels in its rtpmap */
+	TOptional<bool> bOpusStereo;
+
+	/** Applied to every video codec, except the retransmission and error correction formats */
+	TOptional<int32> VideoStartBitrate; // in kbps
+	TOptional<int32> VideoMinBitrate;   // in kbps
+	TOptional<int32> VideoMaxBitrate;   // in kbps
+};
+
+/**
+* Session description split into its media sections, with the formats of each section and their fmtp parameters.
+* The lines which aren't edited are written back unchanged, so parsing and writing an offer gives the same offer.
+*/
+class FSdpEditor
+{
+public:
+	/** Parse a session description. Returns false if it has no media section */
+	bool Parse(const std::string& Sdp);
+
+	/** Write the session description back, with the edits */
+	std::string ToString() const;
+
+	/** Apply the parameters set in the profile, and move the preferred audio format first */
+	void Apply(const FSdpCodecProfile& Profile);
+
+	/**
+	* Apply the parameters set in the profile, keeping the order of the formats.
+	* Used on the answer, which webrtc configures the encoders from, without changing the codec the remote chose
+	*/
+	void ApplyCodecParameters(const FSdpCodecProfile& Profile);
+
+	/**
+	* Move the format with the given rtpmap encoding, like opus/48000/2, first in the m-line of the sections of a kind,
+	* so it's the one negotiated. Returns false if no section offers it
+	*/
+	bool PreferFormat(const std::string& Kind, const std::string& Encoding);
+
+	/** Set an fmtp parameter of a codec, like opus or VP8, in the sections of a kind. Returns the number of formats changed */
+	int32 SetFmtpParameter(const std::string& Kind, const std::string& Codec, const std::string& Name, const std::string& Value);
+
+	/** Remove an fmtp parameter of a codec in the sections of a kind. Returns the number of formats changed */
+	int32 RemoveFmtpParameter(const std::string& Kind, const std::string& Codec, const std::string& Name);
+
+	/** Get an fmtp parameter of the first format of a codec in the sections of a kind */
+	TOptional<std::string> GetFmtpParameter(const std::string& Kind, const std::string& Codec, const std::string& Name) const;
+
+	/** Set the a=<name>:<value> attribute of the sections of a kind, replacing the existing one. Returns the number of sections changed */
+	int32 SetMediaAttribute(const std::string& Kind, const std::string& Name, const std::string& Value);
+
+	/** Get the value of the a=<name>:<value> attribute of the first section of a kind */
+	TOptional<std::string> GetMediaAttribute(const std::string& Kind, const std::string& Name) const;
+
+private:
+	/** Payload type of a media section, with its a=rtpmap and a=fmtp lines */
+	struct FFormat
+	{
+		std::string PayloadType;
+		std::string Encoding; // rtpmap encoding, like opus/48000/2
+		std::string Codec;    // encoding name, like opus
+
+		/** fmtp parameters in their order. A parameter which isn't name=value, like the red redundancy, has no value */
+		TArray<TPair<std::string, TOptional<std::string>>> Parameters;
+
+		/** The fmtp line is written again from the parameters only once they're changed */
+		bool bHasFmtpLine = false;
+		bool bParametersChanged = false;
+	};
+
+	/** m= line and the lines following it */
+	struct FMediaSection
+	{
+		std::string Kind; // audio, video or application
+		std::string Port;
+		std::string Proto;
+
+		/** In the m-line order */
+		TArray<FFormat> Formats;
+
+		/** Lines after the m-line. The rtpmap and fmtp lines are kept for their position */
+		TArray<std::string> Lines;
+
+		/** The m-line is written again only once the formats are reordered */
+		std::string MLine;
+		bool bFormatsReordered = false;
+	};
+
+	/** Index of a payload type in the formats of a section, INDEX_NONE if it isn't in the m-line */
+	static int32 FindFormat(const FMediaSection& Section, const std::string& PayloadType);
+
+	/** Call Function on the formats of the sections of a kind which pass Filter. Returns the number of formats visited */
+	template<typename FilterType, typename FunctionType>
+	int32 ForEachFormat(const std::string& Kind, FilterType&& Filter, FunctionType&& Function);
+
+	static void SetParameter(FFormat& Format, const std::string& Name, const std::string& Value);
+	static void ParseFmtp(const std::string& Value, FFormat& Format);
+	static std::string WriteFmtp(const FFormat& Format);
+
+	/** Lines before the first m-line */
+	TArray<std::string> SessionLines;
+	TArray<FMediaSection> MediaSections;
+};
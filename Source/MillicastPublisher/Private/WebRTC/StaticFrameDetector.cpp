@@ -0,0 +1,68 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "StaticFrameDetector.h"
+
+#include "Hash/CityHash.h"
+
+/** Number of rows hashed together */
+static constexpr int32 kRowsPerTile = 16;
+
+FStaticFrameDetector::FStaticFrameDetector() noexcept
+	: Layout(FTextureReadbackRing::ELayout::Texture)
+{}
+
+bool FStaticFrameDetector::IsUnchanged(const FTextureReadbackRing::FReadbackData& ReadbackData)
+{
+	// Bytes covered by the frame in the readback data
+	const uint8* Data;
+	int32 RowBytes;
+	int32 NumRows;
+
+	if (ReadbackData.Layout == FTextureReadbackRing::ELayout::NV12)
+	{
+		// Luma rows followed by the interleaved chroma rows, with the same stride
+		Data = ReadbackData.Data;
+		RowBytes = ReadbackData.Width;
+		NumRows = ReadbackData.Height + ReadbackData.Height / 2;
+	}
+	else
+	{
+		const int32 BytesPerPixel = GPixelFormats[ReadbackData.Format].BlockBytes;
+
+		Data = ReadbackData.Data + ReadbackData.SourceRect.Min.Y * ReadbackData.Stride + ReadbackData.SourceRect.Min.X * BytesPerPixel;
+		RowBytes = ReadbackData.SourceRect.Width() * BytesPerPixel;
+		NumRows = ReadbackData.SourceRect.Height();
+	}
+
+	const int32 NumTiles = FMath::DivideAndRoundUp(NumRows, kRowsPerTile);
+
+	// A different region or layout can't be compared with the previous frame
+	bool bUnchanged = TileHashes.Num() == NumTiles && SourceRect == ReadbackData.SourceRect && Layout == ReadbackData.Layout;
+
+	TileHashes.SetNum(NumTiles);
+	SourceRect = ReadbackData.SourceRect;
+	Layout = ReadbackData.Layout;
+
+	for (int32 Tile = 0; Tile < NumTiles; ++Tile)
+	{
+		const int32 FirstRow = Tile * kRowsPerTile;
+		const int32 LastRow = FMath::Min(FirstRow + kRowsPerTile, NumRows);
+
+		uint64 Hash = 0;
+		for (int32 Row = FirstRow; Row < LastRow; ++Row)
+		{
+			Hash = CityHash64WithSeed(reinterpret_cast<const char*>(Data + Row * ReadbackData.Stride), RowBytes, Hash);
+		}
+
+		// Keep hashing once a change is found, the next frame is compared to every tile of this one
+		bUnchanged &= TileHashes[Tile] == Hash;
+		TileHashes[Tile] = Hash;
+	}
+
+	return bUnchanged;
+}
+
+void FStaticFrameDetector::Reset()
+{
+	TileHashes.Empty();
+}
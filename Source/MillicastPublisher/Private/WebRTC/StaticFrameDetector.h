@@ -0,0 +1,29 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#pragma once
+
+#include "TextureReadbackRing.h"
+
+/**
+* Detect frames identical to the previous one, before they are converted and encoded.
+* The frame is split in bands of rows hashed with CityHash, so the cost is a single read of the readback data.
+*/
+class FStaticFrameDetector
+{
+public:
+	FStaticFrameDetector() noexcept;
+
+	/** Returns true if the frame content is the same as the one of the previous frame given to this function */
+	bool IsUnchanged(const FTextureReadbackRing::FReadbackData& ReadbackData);
+
+	/** Forget the previous frame, the next one will be reported as changed */
+	void Reset();
+
+private:
+	/** Hash of every band of rows of the previous frame */
+	TArray<uint64> TileHashes;
+
+	/** Frame region and layout the hashes were computed for */
+	FIntRect SourceRect;
+	FTextureReadbackRing::ELayout Layout;
+};
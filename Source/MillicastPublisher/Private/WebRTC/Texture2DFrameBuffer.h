@@ -4,11 +4,13 @@
 
 #include "WebRTCInc.h"
 #include "RHI.h"
-#include "RHIGPUReadback.h"
+#include "TextureReadbackRing.h"
+#include "FrameBufferPool.h"
+#include "FrameConversion.h"
 
 namespace libyuv {
 	extern "C" {
-		/** libyuv header can't be included here, so just declare this function to convert the frames. */
+		/** libyuv header can't be included here, so just declare the functions used to convert the frames. */
 		int ARGBToI420(const uint8_t* src_bgra,
 			int src_stride_bgra,
 			uint8_t* dst_y,
@@ -19,70 +21,147 @@ namespace libyuv {
 			int dst_stride_v,
 			int width,
 			int height);
+
+		int ABGRToI420(const uint8_t* src_abgr,
+			int src_stride_abgr,
+			uint8_t* dst_y,
+			int dst_stride_y,
+			uint8_t* dst_u,
+			int dst_stride_u,
+			uint8_t* dst_v,
+			int dst_stride_v,
+			int width,
+			int height);
+
+		int NV12ToI420(const uint8_t* src_y,
+			int src_stride_y,
+			const uint8_t* src_uv,
+			int src_stride_uv,
+			uint8_t* dst_y,
+			int dst_stride_y,
+			uint8_t* dst_u,
+			int dst_stride_u,
+			uint8_t* dst_v,
+			int dst_stride_v,
+			int width,
+			int height);
+
+		void NV12Copy(const uint8_t* src_y,
+			int src_stride_y,
+			const uint8_t* src_uv,
+			int src_stride_uv,
+			uint8_t* dst_y,
+			int dst_stride_y,
+			uint8_t* dst_uv,
+			int dst_stride_uv,
+			int width,
+			int height);
 	}
 }
 
+/** Video frame buffer converted from the CPU copy of a captured texture */
 class FTexture2DFrameBuffer : public webrtc::VideoFrameBuffer
 {
+public:
+	using FI420BufferPoolPtr = TSharedPtr<FI420BufferPool, ESPMode::ThreadSafe>;
+
+private:
 	int Width;
 	int Height;
 
 	rtc::scoped_refptr<webrtc::I420Buffer> Buffer;
 
-	FTexture2DRHIRef TextureFrame;
-	FCriticalSection CriticalSection;
-	void* TextureData;
-
-	TUniquePtr<FRHIGPUTextureReadback> Readback;
+	/** Pool of the converted frame, also giving the copies scaled for the simulcast layers */
+	FI420BufferPoolPtr BufferPool;
 
 public:
 
-	explicit FTexture2DFrameBuffer(FTexture2DRHIRef SourceTexture) noexcept : TextureData(nullptr)
+	/**
+	* Convert the data read back from the GPU to I420, in a buffer taken from the pool.
+	* When the frame has not been cropped and scaled on the GPU, it is done here with libyuv.
+	* The readback data only has to stay valid for the duration of the constructor.
+	*/
+	FTexture2DFrameBuffer(const FTextureReadbackRing::FReadbackData& ReadbackData, FI420BufferPoolPtr InBufferPool) noexcept
+		: Width(ReadbackData.Width), Height(ReadbackData.Height), BufferPool(MoveTemp(InBufferPool))
 	{
-		/* Get video farme height and  width */
-		Width = SourceTexture->GetSizeX();
-		Height = SourceTexture->GetSizeY();
-		TextureFrame = SourceTexture;
-		
-		ENQUEUE_RENDER_COMMAND(ReadSurfaceCommand)(
-			[this](FRHICommandListImmediate& RHICmdList)
+		/* Get an I420 buffer */
+		Buffer = BufferPool->CreateBuffer(Width, Height);
+
+		const int32 Stride = ReadbackData.Stride;
+		const FIntRect& SourceRect = ReadbackData.SourceRect;
+		const FIntPoint SourceSize = SourceRect.Size();
+
+		/* Convert the source region at its own size first if it has to be scaled */
+		rtc::scoped_refptr<webrtc::I420Buffer> Converted = Buffer;
+		if (SourceSize.X != Width || SourceSize.Y != Height)
+		{
+			Converted = BufferPool->CreateBuffer(SourceSize.X, SourceSize.Y);
+		}
+
+		const int StrideY = Converted->StrideY();
+		const int StrideU = Converted->StrideU();
+		const int StrideV = Converted->StrideV();
+		uint8* DataY = Converted->MutableDataY();
+		uint8* DataU = Converted->MutableDataU();
+		uint8* DataV = Converted->MutableDataV();
+
+		if (ReadbackData.Layout == FTextureReadbackRing::ELayout::NV12)
+		{
+			/* Already converted on the GPU, only the chroma planes have to be split */
+			const uint8* TextureY = ReadbackData.Data;
+			const uint8* TextureUV = ReadbackData.Data + Stride * Height;
+
+			FrameConversion::ParallelForRowBands(Height, [&](int32 Row, int32 NumRows)
 			{
-				FScopeLock Lock(&CriticalSection);
-
-				if (GDynamicRHI && GDynamicRHI->GetName() == FString(TEXT("D3D12")))
-				{
-					ReadTextureDX12(RHICmdList);
-				}
-				else
-				{
-					ReadTexture(RHICmdList);
-				}
+				libyuv::NV12ToI420(TextureY + Row * Stride, Stride, TextureUV + Row / 2 * Stride, Stride,
+					DataY + Row * StrideY, StrideY, DataU + Row / 2 * StrideU, StrideU, DataV + Row / 2 * StrideV, StrideV,
+					Width, NumRows);
 			});
+			return;
+		}
 
-		// FlushRenderingCommands();
-	}
-	
-	void ReadTextureDX12(FRHICommandListImmediate& RHICmdList)
-	{
-		if (!Readback.IsValid())
+		const uint8* TextureData = ReadbackData.Data + SourceRect.Min.Y * Stride
+			+ SourceRect.Min.X * GPixelFormats[ReadbackData.Format].BlockBytes;
+
+		/* libyuv names formats after their little endian word order, so BGRA in memory is "ARGB" */
+		decltype(&libyuv::ARGBToI420) ConvertToI420 = nullptr;
+		switch (ReadbackData.Format)
 		{
-			Readback = MakeUnique<FRHIGPUTextureReadback>(TEXT("CaptureReadback"));
+		case PF_B8G8R8A8:
+			ConvertToI420 = &libyuv::ARGBToI420;
+			break;
+		case PF_R8G8B8A8:
+			ConvertToI420 = &libyuv::ABGRToI420;
+			break;
+		default:
+			break;
 		}
 
-		Readback->EnqueueCopy(RHICmdList, TextureFrame, FResolveRect(0, 0, Width, Height));
-		RHICmdList.BlockUntilGPUIdle();
-		check(Readback->IsReady());
+		if (ConvertToI420)
+		{
+			/* One core can't convert a 4K frame at 60 fps, so convert bands of rows in parallel */
+			FrameConversion::ParallelForRowBands(SourceSize.Y, [&](int32 Row, int32 NumRows)
+			{
+				ConvertToI420(TextureData + Row * Stride, Stride,
+					DataY + Row * StrideY, StrideY, DataU + Row / 2 * StrideU, StrideU, DataV + Row / 2 * StrideV, StrideV,
+					SourceSize.X, NumRows);
+			});
+		}
+		else
+		{
+			webrtc::I420Buffer::SetBlack(Converted.get());
+		}
 
-		TextureData = Readback->Lock(Width * Height * 4);
-		Readback->Unlock();
+		if (Converted != Buffer)
+		{
+			Buffer->ScaleFrom(*Converted);
+		}
 	}
 
-	void ReadTexture(FRHICommandListImmediate& RHICmdList)
+	/** Whether the texture pixel format can be converted on the CPU by this frame buffer */
+	static bool IsFormatSupported(EPixelFormat Format)
 	{
-		uint32 stride;
-		TextureData = (uint8*)RHICmdList.LockTexture2D(TextureFrame, 0, EResourceLockMode::RLM_ReadOnly, stride, true);
-
-		RHICmdList.UnlockTexture2D(TextureFrame, 0, true);
+		return Format == PF_B8G8R8A8 || Format == PF_R8G8B8A8;
 	}
 
 	/** Get video frame width */
@@ -97,80 +176,98 @@ public:
 	/** Get the I420 buffer */
 	rtc::scoped_refptr<webrtc::I420BufferInterface> ToI420() override
 	{
-		/* Create an I420 buffer */
-		FScopeLock Lock(&CriticalSection);
-
-		Buffer = webrtc::I420Buffer::Create(Width, Height);
-
-		uint8* DataY = Buffer->MutableDataY();
-		uint8* DataU = Buffer->MutableDataU();
-		uint8* DataV = Buffer->MutableDataV();
-
-		const auto STRIDES = Width * 4;
+		return Buffer;
+	}
 
-		if (TextureData) {
-			libyuv::ARGBToI420((uint8_t*)TextureData, STRIDES,
-				DataY, Buffer->StrideY(), DataU, Buffer->StrideU(), DataV, Buffer->StrideV(),
-				Width, Height);
-		}
+#if WEBRTC_VERSION >= 96
+	/**
+	* Scale the converted frame in a buffer taken from the pool, for each simulcast layer sent at a lower resolution.
+	* The default implementation allocates a new buffer for every layer of every frame
+	*/
+	rtc::scoped_refptr<webrtc::VideoFrameBuffer> CropAndScale(int OffsetX, int OffsetY, int CropWidth, int CropHeight,
+		int ScaledWidth, int ScaledHeight) override
+	{
+		rtc::scoped_refptr<webrtc::I420Buffer> Scaled = BufferPool->CreateBuffer(ScaledWidth, ScaledHeight);
+		Scaled->CropAndScaleFrom(*Buffer, OffsetX, OffsetY, CropWidth, CropHeight);
 
-		return Buffer;
+		return Scaled;
 	}
+#endif
 };
 
-class FColorTexture2DFrameBuffer : public webrtc::VideoFrameBuffer
+/**
+* Native video frame buffer holding a frame converted to NV12 on the GPU.
+* Encoders taking NV12 map it as is, I420 is only produced for the encoders asking for it.
+* Crop and scale requested by webrtc are deferred until the frame is mapped.
+* Before webrtc 96, encoders only get native buffers through ToI420, so the conversion moves from the capture
+* worker to the encoder and is skipped for the frames the encoder drops. It is done once per frame, however many
+* layers and sinks ask for it.
+*/
+class FNV12FrameBuffer : public webrtc::VideoFrameBuffer
 {
-	int Width;
-	int Height;
-
-	rtc::scoped_refptr<webrtc::I420Buffer> Buffer;
-
 public:
+	using FI420BufferPoolPtr = TSharedPtr<FI420BufferPool, ESPMode::ThreadSafe>;
+	using FNV12BufferPoolPtr = TSharedPtr<FNV12BufferPool, ESPMode::ThreadSafe>;
 
-	explicit FColorTexture2DFrameBuffer(FTexture2DRHIRef SourceTexture) noexcept
-	{
-		/* Get video farme height and  width */
-		Width = SourceTexture->GetSizeX();
-		Height = SourceTexture->GetSizeY();
+private:
+	/** Full frame, shared by every cropped and scaled view of it */
+	rtc::scoped_refptr<FNV12Buffer> Buffer;
 
-		/* Create an I420 buffer */
-		Buffer = webrtc::I420Buffer::Create(Width, Height);
+	/** Converted on the first ToI420, every encoder layer and sink asking for I420 gets the same buffer */
+	rtc::scoped_refptr<webrtc::I420Buffer> I420Buffer;
+	FCriticalSection I420Section;
 
+	FI420BufferPoolPtr I420BufferPool;
+	FNV12BufferPoolPtr NV12BufferPool;
 
-		/* Convert the texture2d frame to YUV pixel format */
-		FRHICommandListImmediate& RHICommandList = FRHICommandListExecutor::GetImmediateCommandList();
+	/** Region of the full frame this view shows, scaled to Width x Height */
+	int OffsetX;
+	int OffsetY;
+	int CropWidth;
+	int CropHeight;
+	int Width;
+	int Height;
 
-		const auto ARGB_BUFFER_SIZE = Width * Height * 4;
-		FIntRect Rect(0, 0, Width, Height);
-		TArray<FColor> ColorData;
-		uint8* TextureData = new uint8[ARGB_BUFFER_SIZE];
+protected:
+	/** View of another frame buffer, used by CropAndScale */
+	FNV12FrameBuffer(const FNV12FrameBuffer& Other, int InOffsetX, int InOffsetY, int InCropWidth, int InCropHeight, int InWidth, int InHeight) noexcept
+		: Buffer(Other.Buffer), I420BufferPool(Other.I420BufferPool), NV12BufferPool(Other.NV12BufferPool),
+		OffsetX(InOffsetX), OffsetY(InOffsetY), CropWidth(InCropWidth), CropHeight(InCropHeight), Width(InWidth), Height(InHeight)
+	{}
 
-		FReadSurfaceDataFlags ReadSurfaceData{};
-		ReadSurfaceData.SetMip(0);
+	bool IsCroppedOrScaled() const
+	{
+		return OffsetX != 0 || OffsetY != 0 || CropWidth != Width || CropHeight != Height
+			|| Width != Buffer->width() || Height != Buffer->height();
+	}
 
-		RHICommandList.ReadSurfaceData(SourceTexture, Rect, ColorData, ReadSurfaceData);
+public:
+	/**
+	* Copy the NV12 data read back from the GPU in a buffer taken from the pool.
+	* The readback data only has to stay valid for the duration of the constructor.
+	*/
+	FNV12FrameBuffer(const FTextureReadbackRing::FReadbackData& ReadbackData, FI420BufferPoolPtr InI420BufferPool, FNV12BufferPoolPtr InNV12BufferPool) noexcept
+		: I420BufferPool(MoveTemp(InI420BufferPool)), NV12BufferPool(MoveTemp(InNV12BufferPool)),
+		OffsetX(0), OffsetY(0), CropWidth(ReadbackData.Width), CropHeight(ReadbackData.Height), Width(ReadbackData.Width), Height(ReadbackData.Height)
+	{
+		check(ReadbackData.Layout == FTextureReadbackRing::ELayout::NV12);
 
-		for (uint64 i = 0; i < Width * Height; ++i) {
-			const int64 ind = i * 4;
-			TextureData[ind] = ColorData[i].B;
-			TextureData[ind + 1] = ColorData[i].G;
-			TextureData[ind + 2] = ColorData[i].R;
-			TextureData[ind + 3] = ColorData[i].A;
-		}
+		Buffer = NV12BufferPool->CreateBuffer(Width, Height);
 
-		uint8* DataY = Buffer->MutableDataY();
-		uint8* DataU = Buffer->MutableDataU();
-		uint8* DataV = Buffer->MutableDataV();
+		const uint8* TextureData = ReadbackData.Data;
+		const int32 Stride = ReadbackData.Stride;
 
-		/* The buffer is in BGRA, but for some reason, this is ARGGToI420 that we need to use */
-		const auto STRIDES = Width * 4;
-		libyuv::ARGBToI420(TextureData, STRIDES,
-			DataY, Buffer->StrideY(), DataU, Buffer->StrideU(), DataV, Buffer->StrideV(),
+		libyuv::NV12Copy(TextureData, Stride, TextureData + Stride * Height, Stride,
+			Buffer->MutableDataY(), Buffer->StrideY(), Buffer->MutableDataUV(), Buffer->StrideUV(),
 			Width, Height);
-
-		delete[] TextureData;
 	}
 
+	/** Take a buffer of the NV12 pool the capture worker already copied the frame in, without copying it again */
+	FNV12FrameBuffer(rtc::scoped_refptr<FNV12Buffer> InBuffer, FI420BufferPoolPtr InI420BufferPool, FNV12BufferPoolPtr InNV12BufferPool) noexcept
+		: Buffer(MoveTemp(InBuffer)), I420BufferPool(MoveTemp(InI420BufferPool)), NV12BufferPool(MoveTemp(InNV12BufferPool)),
+		OffsetX(0), OffsetY(0), CropWidth(Buffer->width()), CropHeight(Buffer->height()), Width(Buffer->width()), Height(Buffer->height())
+	{}
+
 	/** Get video frame width */
 	int width() const override { return Width; }
 
@@ -180,9 +277,77 @@ public:
 	/** Get buffer type */
 	Type type() const override { return Type::kNative; }
 
-	/** Get the I420 buffer */
-	rtc::scoped_refptr<webrtc::I420BufferInterface> ToI420() override
+	/** Get the NV12 buffer, cropped and scaled if needed */
+	rtc::scoped_refptr<FNV12Buffer> ToNV12()
 	{
+#if WEBRTC_VERSION >= 96
+		if (IsCroppedOrScaled())
+		{
+			rtc::scoped_refptr<FNV12Buffer> Scaled = NV12BufferPool->CreateBuffer(Width, Height);
+			Scaled->CropAndScaleFrom(*Buffer, OffsetX, OffsetY, CropWidth, CropHeight);
+
+			return Scaled;
+		}
+#endif
 		return Buffer;
 	}
-};
\ No newline at end of file
+
+	/** Get the I420 buffer, converted once per view */
+	rtc::scoped_refptr<webrtc::I420BufferInterface> ToI420() override
+	{
+		FScopeLock Lock(&I420Section);
+
+		if (I420Buffer)
+		{
+			return I420Buffer;
+		}
+
+		rtc::scoped_refptr<FNV12Buffer> NV12 = ToNV12();
+		rtc::scoped_refptr<webrtc::I420Buffer> I420 = I420BufferPool->CreateBuffer(Width, Height);
+
+		FrameConversion::ParallelForRowBands(Height, [&](int32 Row, int32 NumRows)
+		{
+			libyuv::NV12ToI420(NV12->DataY() + Row * NV12->StrideY(), NV12->StrideY(), NV12->DataUV() + Row / 2 * NV12->StrideUV(), NV12->StrideUV(),
+				I420->MutableDataY() + Row * I420->StrideY(), I420->StrideY(),
+				I420->MutableDataU() + Row / 2 * I420->StrideU(), I420->StrideU(),
+				I420->MutableDataV() + Row / 2 * I420->StrideV(), I420->StrideV(),
+				Width, NumRows);
+		});
+
+		I420Buffer = I420;
+		return I420Buffer;
+	}
+
+#if WEBRTC_VERSION >= 96
+	/** Map the frame to the first of the requested types it can be converted to, in the encoder order of preference */
+	rtc::scoped_refptr<webrtc::VideoFrameBuffer> GetMappedFrameBuffer(rtc::ArrayView<Type> Types) override
+	{
+		for (Type BufferType : Types)
+		{
+			if (BufferType == Type::kNV12)
+			{
+				return ToNV12();
+			}
+			if (BufferType == Type::kI420)
+			{
+				return ToI420();
+			}
+		}
+
+		return nullptr;
+	}
+
+	/** Crop and scale lazily, the returned view shares this frame buffer data */
+	rtc::scoped_refptr<webrtc::VideoFrameBuffer> CropAndScale(int InOffsetX, int InOffsetY, int InCropWidth, int InCropHeight,
+		int InScaledWidth, int InScaledHeight) override
+	{
+		// The requested region is relative to this view, map it to the full frame
+		return new rtc::RefCountedObject<FNV12FrameBuffer>(*this,
+			OffsetX + InOffsetX * CropWidth / Width,
+			OffsetY + InOffsetY * CropHeight / Height,
+			InCropWidth * CropWidth / Width,
+			InCropHeight * CropHeight / Height,
+			InScaledWidth, InScaledHeight);
+	}
+#endif
+};
@@ -1,35 +1,249 @@
-
 // Copyright Millicast 2022. All Rights Reserved.
 
 #include "Texture2DVideoSourceAdapter.h"
 #include "Texture2DFrameBuffer.h"
 
+#include "RGBToNV12Shader.h"
 #include "MillicastPublisherPrivate.h"
 
-void FTexture2DVideoSourceAdapter::OnFrameReady(const FTexture2DRHIRef& FrameBuffer, bool ReadColor)
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+
+static TAutoConsoleVariable<int32> CVarMillicastReadbackRingSize(
+	TEXT("Millicast.Publisher.ReadbackRingSize"),
+	3,
+	TEXT("Number of GPU readback buffers in flight per video capture. Takes effect on the next capture."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<bool> CVarMillicastGPUColorConversion(
+	TEXT("Millicast.Publisher.GPUColorConversion"),
+	true,
+	TEXT("Convert captured frames to YUV on the GPU before reading them back. ")
+	TEXT("When disabled or not supported, the RGB texture is read back and converted on the CPU."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarMillicastCaptureQueueSize(
+	TEXT("Millicast.Publisher.CaptureQueueSize"),
+	2,
+	TEXT("Maximum number of captured frames waiting to be converted by the capture worker. Takes effect on the next capture."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarMillicastCaptureQueueDropPolicy(
+	TEXT("Millicast.Publisher.CaptureQueueDropPolicy"),
+	0,
+	TEXT("Frame dropped when the capture queue is full. 0: the oldest queued frame, 1: the new frame. ")
+	TEXT("Takes effect on the next capture."),
+	ECVF_Default);
+
+FTexture2DVideoSourceAdapter::FTexture2DVideoSourceAdapter() noexcept
+	: ReadbackPool(CVarMillicastReadbackRingSize.GetValueOnAnyThread()),
+	ReadbackRing(CVarMillicastReadbackRingSize.GetValueOnAnyThread(), ReadbackPool),
+	BufferPool(MakeShared<FI420BufferPool, ESPMode::ThreadSafe>()),
+	NV12BufferPool(MakeShared<FNV12BufferPool, ESPMode::ThreadSafe>()),
+	bDetectStaticFrames(false),
+	StaticFrameRefreshRate(0.f),
+	LastFrameTimestampUs(0),
+	FramesCaptured(0),
+	FramesSkipped(0),
+	FramesDropped(0),
+	FramesStatic(0),
+	UnsupportedFormat(PF_Unknown)
+{
+	const FCaptureWorker::EDropPolicy DropPolicy = CVarMillicastCaptureQueueDropPolicy.GetValueOnAnyThread() == 1
+		? FCaptureWorker::EDropPolicy::DropNewest
+		: FCaptureWorker::EDropPolicy::DropOldest;
+
+	CaptureWorker = MakeUnique<FCaptureWorker>(CVarMillicastCaptureQueueSize.GetValueOnAnyThread(), DropPolicy,
+		[this](const FTextureReadbackRing::FReadbackData& ReadbackData, const rtc::scoped_refptr<FNV12Buffer>& NV12Buffer) {
+			OnReadbackReady(ReadbackData, NV12Buffer);
+		},
+		NV12BufferPool);
+}
+
+FTexture2DVideoSourceAdapter::~FTexture2DVideoSourceAdapter()
 {
+	// Wait for the frame being converted, it uses the pools
+	CaptureWorker.Reset();
+}
+
+void FTexture2DVideoSourceAdapter::OnFrameReady(const FTexture2DRHIRef& FrameBuffer, bool bIsBackBuffer)
+{
+	check(IsInRenderingThread());
+
+	FScopeLock Lock(&CriticalSection);
+
+	FRHICommandListImmediate& RHICmdList = FRHICommandListExecutor::GetImmediateCommandList();
+
+	// Hand the frames whose copy completed to the worker first, so their slots can be reused for this one
+	ReadbackRing.Poll(RHICmdList, [this](const FTextureReadbackRing::FReadbackData& ReadbackData) {
+		CaptureWorker->Enqueue(ReadbackData);
+	});
+
 	const int64 Timestamp = rtc::TimeMicros();
 
-	if (!AdaptVideoFrame(Timestamp, FrameBuffer->GetSizeXY())) return;
+	// Engine frames above the target capture framerate are skipped before anything is read back
+	if (!FrameScheduler.ShouldCapture(Timestamp))
+	{
+		++FramesSkipped;
+		return;
+	}
+
+	// The frame is dropped when every readback is still in flight, rather than stalling the render thread.
+	// Checked before the webrtc adapter, which counts every frame it accepts as delivered for its framerate decimation
+	if (ReadbackRing.IsFull())
+	{
+		++FramesDropped;
+		return;
+	}
+
+	const EPixelFormat Format = FrameBuffer->GetFormat();
+	const bool bCPUFormat = FTexture2DFrameBuffer::IsFormatSupported(Format);
+	const bool bGPUConversion = CVarMillicastGPUColorConversion.GetValueOnRenderThread()
+		&& IsRGBToNV12Supported(FrameBuffer->GetSizeXY() / 2 * 2);
+
+	if (!bGPUConversion && !bCPUFormat)
+	{
+		if (UnsupportedFormat != Format)
+		{
+			UnsupportedFormat = Format;
+			UE_LOG(LogMillicastPublisher, Warning, TEXT("Unsupported capture texture format %s"), GPixelFormats[UnsupportedFormat].Name);
+		}
+		++FramesDropped;
+		return;
+	}
+
+	// Resolution and framerate decisions of webrtc (sink wants, bandwidth adaptation) are applied before any readback
+	FAdaptedFrame AdaptedFrame;
+	if (!AdaptVideoFrame(Timestamp, FrameBuffer->GetSizeXY(), AdaptedFrame))
+	{
+		++FramesDropped;
+		return;
+	}
+
+	// A format only the GPU conversion reads is sent at an even size, at most a pixel less than the adapter asked for
+	FIntPoint OutputSize = AdaptedFrame.OutputSize;
+	if (!bCPUFormat)
+	{
+		OutputSize = OutputSize / 2 * 2;
+	}
+
+	const bool bConvertOnGPU = bGPUConversion && IsRGBToNV12Supported(OutputSize);
+
+	FRDGBuilder GraphBuilder(RHICmdList);
+
+	FRDGTextureRef InputTexture = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(FrameBuffer, TEXT("MillicastCaptureTexture")));
+
+	// Slate presents the back buffer right after this callback
+	if (bIsBackBuffer)
+	{
+		GraphBuilder.SetTextureAccessFinal(InputTexture, ERHIAccess::Present);
+	}
 
-	rtc::scoped_refptr<webrtc::VideoFrameBuffer> Buffer; 
-	
-	if (ReadColor)
+	if (bConvertOnGPU)
 	{
-		Buffer = new rtc::RefCountedObject<FColorTexture2DFrameBuffer>(FrameBuffer);
+		// Only 1.5 bytes per pixel of the scaled frame are read back instead of 4 of the whole texture,
+		// and the CPU doesn't have to convert them
+		FRDGTextureRef NV12Texture = AddRGBToNV12Pass(GraphBuilder, InputTexture, AdaptedFrame.CropRect, OutputSize);
+		if (!ReadbackRing.Enqueue(GraphBuilder, NV12Texture, FIntRect(FIntPoint::ZeroValue, OutputSize), OutputSize,
+			FTextureReadbackRing::ELayout::NV12, Timestamp))
+		{
+			++FramesDropped;
+		}
 	}
 	else
 	{
-		Buffer = new rtc::RefCountedObject<FTexture2DFrameBuffer>(FrameBuffer);
+		// Cropped and scaled by libyuv once read back
+		if (!ReadbackRing.Enqueue(GraphBuilder, InputTexture, AdaptedFrame.CropRect, OutputSize,
+			FTextureReadbackRing::ELayout::Texture, Timestamp))
+		{
+			++FramesDropped;
+		}
+	}
+
+	GraphBuilder.Execute();
+}
+
+void FTexture2DVideoSourceAdapter::OnReadbackReady(const FTextureReadbackRing::FReadbackData& ReadbackData, const rtc::scoped_refptr<FNV12Buffer>& NV12Buffer)
+{
+	FScopeLock Lock(&ProcessingSection);
+
+	// Hashing the frame is much cheaper than converting and encoding it again
+	if (bDetectStaticFrames && StaticFrameDetector.IsUnchanged(ReadbackData))
+	{
+		const bool bRefresh = StaticFrameRefreshRate > 0.f
+			&& ReadbackData.TimestampUs - LastFrameTimestampUs >= static_cast<int64>(rtc::kNumMicrosecsPerSec / StaticFrameRefreshRate);
+
+		if (!bRefresh)
+		{
+			++FramesStatic;
+			return;
+		}
+	}
+
+	rtc::scoped_refptr<webrtc::VideoFrameBuffer> Buffer;
+
+	// Frames converted on the GPU are kept in NV12, and only converted to I420 if the encoder needs it
+	if (NV12Buffer)
+	{
+		Buffer = new rtc::RefCountedObject<FNV12FrameBuffer>(NV12Buffer, BufferPool, NV12BufferPool);
+	}
+	else if (ReadbackData.Layout == FTextureReadbackRing::ELayout::NV12)
+	{
+		Buffer = new rtc::RefCountedObject<FNV12FrameBuffer>(ReadbackData, BufferPool, NV12BufferPool);
+	}
+	else
+	{
+		Buffer = new rtc::RefCountedObject<FTexture2DFrameBuffer>(ReadbackData, BufferPool);
 	}
 
 	webrtc::VideoFrame Frame = webrtc::VideoFrame::Builder()
 		.set_video_frame_buffer(Buffer)
-		.set_timestamp_us(Timestamp)
+		.set_timestamp_us(ReadbackData.TimestampUs)
 		.set_rotation(webrtc::VideoRotation::kVideoRotation_0)
 		.build();
 
 	rtc::AdaptedVideoTrackSource::OnFrame(Frame);
+
+	LastFrameTimestampUs = ReadbackData.TimestampUs;
+	++FramesCaptured;
+}
+
+void FTexture2DVideoSourceAdapter::SetCaptureFramerate(int32 Framerate)
+{
+	FrameScheduler.SetTargetFramerate(Framerate);
+}
+
+void FTexture2DVideoSourceAdapter::SetStaticFrameDetection(bool bEnabled, float RefreshRate)
+{
+	FScopeLock Lock(&ProcessingSection);
+
+	if (bEnabled != bDetectStaticFrames)
+	{
+		StaticFrameDetector.Reset();
+	}
+
+	bDetectStaticFrames = bEnabled;
+	StaticFrameRefreshRate = FMath::Max(RefreshRate, 0.f);
+}
+
+FTexture2DVideoSourceAdapter::FStats FTexture2DVideoSourceAdapter::GetStats() const
+{
+	FStats Stats;
+	Stats.FramesCaptured = FramesCaptured;
+	Stats.FramesSkipped = FramesSkipped;
+	Stats.FramesDropped = FramesDropped;
+	Stats.FramesStatic = FramesStatic;
+	Stats.Queue = CaptureWorker->GetStats();
+	Stats.BufferPool = BufferPool->GetStats();
+	Stats.ReadbackPool = ReadbackPool.GetStats();
+
+	const FFrameBufferPoolStats NV12Stats = NV12BufferPool->GetStats();
+	Stats.BufferPool.Hits += NV12Stats.Hits;
+	Stats.BufferPool.Misses += NV12Stats.Misses;
+	Stats.BufferPool.ResidentBytes += NV12Stats.ResidentBytes;
+	Stats.BufferPool.NumBuffers += NV12Stats.NumBuffers;
+
+	return Stats;
 }
 
 webrtc::MediaSourceInterface::SourceState FTexture2DVideoSourceAdapter::state() const
@@ -37,9 +251,17 @@ webrtc::MediaSourceInterface::SourceState FTexture2DVideoSourceAdapter::state()
 	return webrtc::MediaSourceInterface::SourceState::kLive;
 }
 
-bool FTexture2DVideoSourceAdapter::AdaptVideoFrame(int64 TimestampUs, FIntPoint Resolution)
+bool FTexture2DVideoSourceAdapter::AdaptVideoFrame(int64 TimestampUs, FIntPoint Resolution, FAdaptedFrame& OutAdaptedFrame)
 {
 	int out_width, out_height, crop_width, crop_height, crop_x, crop_y;
-	return rtc::AdaptedVideoTrackSource::AdaptFrame(Resolution.X, Resolution.Y, TimestampUs,
-		 &out_width, &out_height, &crop_width, &crop_height, &crop_x, &crop_y);
+	if (!rtc::AdaptedVideoTrackSource::AdaptFrame(Resolution.X, Resolution.Y, TimestampUs,
+		 &out_width, &out_height, &crop_width, &crop_height, &crop_x, &crop_y))
+	{
+		return false;
+	}
+
+	OutAdaptedFrame.CropRect = FIntRect(crop_x, crop_y, crop_x + crop_width, crop_y + crop_height);
+	OutAdaptedFrame.OutputSize = FIntPoint(out_width, out_height);
+
+	return true;
 }
@@ -5,14 +5,50 @@
 #include "WebRTCInc.h"
 #include "RHI.h"
 
+#include "TextureReadbackRing.h"
+#include "FrameBufferPool.h"
+#include "CaptureFrameScheduler.h"
+#include "StaticFrameDetector.h"
+#include "CaptureWorker.h"
+
 /** Video Source adapter to create webrtc video frame from a Texture 2D and push it into webrtc pipelines */
 class FTexture2DVideoSourceAdapter : public rtc::AdaptedVideoTrackSource
 {
 public:
-	FTexture2DVideoSourceAdapter() noexcept = default;
-	~FTexture2DVideoSourceAdapter() = default;
+	/** Capture counters */
+	struct FStats
+	{
+		uint32 FramesCaptured = 0; // Frames pushed to webrtc
+		uint32 FramesSkipped = 0;  // Engine frames skipped to hold the target capture framerate
+		uint32 FramesDropped = 0;  // Frames dropped by the webrtc adapter, or because every readback was in flight
+		uint32 FramesStatic = 0;   // Frames read back but not pushed because they were identical to the previous one
+		FCaptureWorker::FStats Queue; // Frames read back and waiting to be converted
+		FFrameBufferPoolStats BufferPool;
+		FReadbackPoolStats ReadbackPool;
+	};
+
+	FTexture2DVideoSourceAdapter() noexcept;
+	~FTexture2DVideoSourceAdapter();
+
+	/**
+	* Called on the rendering thread with the captured texture.
+	* The texture is copied to a readback buffer, and once the GPU copy completed, which is usually one or two frames later,
+	* the frame is queued to the capture worker which converts it and pushes it to webrtc.
+	* bIsBackBuffer must be set for Slate back buffers, which are presented after the copy.
+	*/
+	void OnFrameReady(const FTexture2DRHIRef& FrameBuffer, bool bIsBackBuffer = false);
+
+	/** Set the maximum number of frames captured per second, 0 to capture every engine frame */
+	void SetCaptureFramerate(int32 Framerate);
 
-	void OnFrameReady(const FTexture2DRHIRef& FrameBuffer, bool ReadColor = false);
+	/**
+	* Skip the frames identical to the previous one, before they are converted and encoded.
+	* While the content doesn't change, RefreshRate frames per second are still pushed so the stream keeps going, 0 to push none.
+	*/
+	void SetStaticFrameDetection(bool bEnabled, float RefreshRate);
+
+	/** Get the capture counters, including the ones of the pools the frames are allocated from */
+	FStats GetStats() const;
 
 	webrtc::MediaSourceInterface::SourceState state() const override;
 	absl::optional<bool> needs_denoising() const override { return false; }
@@ -20,7 +56,53 @@ public:
 	bool remote() const override { return false; }
 
 private:
-	bool AdaptVideoFrame(int64 TimestampUs, FIntPoint Resolution);
+	/** Crop and scale requested by the webrtc video adapter for a frame */
+	struct FAdaptedFrame
+	{
+		FIntRect CropRect;
+		FIntPoint OutputSize;
+	};
+
+	/** Returns false if the frame must be dropped, otherwise how it has to be cropped and scaled */
+	bool AdaptVideoFrame(int64 TimestampUs, FIntPoint Resolution, FAdaptedFrame& OutAdaptedFrame);
+
+	/**
+	* Push a video frame to webrtc from a completed readback. Called on the capture worker thread,
+	* with the NV12 pool buffer the worker copied an NV12 frame in
+	*/
+	void OnReadbackReady(const FTextureReadbackRing::FReadbackData& ReadbackData, const rtc::scoped_refptr<FNV12Buffer>& NV12Buffer);
+
+	FCaptureFrameScheduler FrameScheduler;
 
+	/** Staging readbacks, kept across frames and render target switches. Must outlive the ring */
+	FReadbackPool ReadbackPool;
+	FTextureReadbackRing ReadbackRing;
+
+	/** Frame buffers recycled once the encoder is done with them. Shared with the frames converting lazily */
+	TSharedPtr<FI420BufferPool, ESPMode::ThreadSafe> BufferPool;
+	TSharedPtr<FNV12BufferPool, ESPMode::ThreadSafe> NV12BufferPool;
+
+	/** Converts the frames read back. Stopped before anything it uses is destroyed */
+	TUniquePtr<FCaptureWorker> CaptureWorker;
+
+	FStaticFrameDetector StaticFrameDetector;
+	bool bDetectStaticFrames;
+	float StaticFrameRefreshRate;
+
+	/** Capture timestamp of the last frame pushed to webrtc */
+	int64 LastFrameTimestampUs;
+
+	TAtomic<uint32> FramesCaptured;
+	TAtomic<uint32> FramesSkipped;
+	TAtomic<uint32> FramesDropped;
+	TAtomic<uint32> FramesStatic;
+
+	/** Last texture format that could not be captured, to warn only once */
+	EPixelFormat UnsupportedFormat;
+
+	/** Guards the readback ring on the rendering thread */
 	FCriticalSection CriticalSection;
-};
\ No newline at end of file
+
+	/** Guards the frame processing state on the capture worker */
+	FCriticalSection ProcessingSection;
+};
@@ -0,0 +1,112 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "TextureReadbackRing.h"
+
+#include "MillicastPublisherPrivate.h"
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+
+FTextureReadbackRing::FTextureReadbackRing(int32 InNumSlots, FReadbackPool& InReadbackPool) noexcept
+	: ReadbackPool(InReadbackPool), WriteIndex(0), ReadIndex(0), InFlightCount(0)
+{
+	Slots.SetNum(FMath::Max(InNumSlots, 1));
+}
+
+FTextureReadbackRing::FSlot* FTextureReadbackRing::AcquireSlot(FIntPoint Size, EPixelFormat Format)
+{
+	check(IsInRenderingThread());
+
+	ReadbackPool.AdvanceFrame();
+
+	if (InFlightCount == Slots.Num())
+	{
+		return nullptr;
+	}
+
+	FSlot& Slot = Slots[WriteIndex];
+
+	// The staging texture of a readback is created on the first copy and assumes every following copy
+	// has the same size and format, so swap it for one of the pool when the source texture changes.
+	if (!Slot.Readback.IsValid() || Slot.Size != Size || Slot.Format != Format)
+	{
+		ReadbackPool.Release(MoveTemp(Slot.Readback), Slot.Size, Slot.Format);
+
+		Slot.Readback = ReadbackPool.Acquire(Size, Format);
+		if (!Slot.Readback.IsValid())
+		{
+			return nullptr;
+		}
+
+		Slot.Size = Size;
+		Slot.Format = Format;
+	}
+
+	WriteIndex = (WriteIndex + 1) % Slots.Num();
+	++InFlightCount;
+
+	return &Slot;
+}
+
+bool FTextureReadbackRing::Enqueue(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, FIntRect SourceRect, FIntPoint FrameSize, ELayout Layout, int64 TimestampUs)
+{
+	FSlot* Slot = AcquireSlot(Texture->Desc.Extent, Texture->Desc.Format);
+	if (!Slot)
+	{
+		return false;
+	}
+
+	Slot->SourceRect = SourceRect;
+	Slot->FrameSize = FrameSize;
+	Slot->Layout = Layout;
+	Slot->TimestampUs = TimestampUs;
+
+	// The graph takes care of the transitions of the source texture, whether it's a render target or a back buffer
+	AddEnqueueCopyPass(GraphBuilder, Slot->Readback.Get(), Texture);
+
+	return true;
+}
+
+void FTextureReadbackRing::Poll(FRHICommandListImmediate& RHICmdList, FOnReadbackReady OnReady)
+{
+	check(IsInRenderingThread());
+
+	while (InFlightCount > 0 && Slots[ReadIndex].Readback->IsReady())
+	{
+		FSlot& Slot = Slots[ReadIndex];
+
+		void* Data = nullptr;
+		int32 RowPitchInPixels = 0;
+		Slot.Readback->LockTexture(RHICmdList, Data, RowPitchInPixels);
+
+		if (Data)
+		{
+			FReadbackData ReadbackData;
+			ReadbackData.Data = static_cast<const uint8*>(Data);
+			ReadbackData.Stride = RowPitchInPixels * GPixelFormats[Slot.Format].BlockBytes;
+			ReadbackData.Width = Slot.FrameSize.X;
+			ReadbackData.Height = Slot.FrameSize.Y;
+			ReadbackData.SourceRect = Slot.SourceRect;
+			ReadbackData.Format = Slot.Format;
+			ReadbackData.Layout = Slot.Layout;
+			ReadbackData.TimestampUs = Slot.TimestampUs;
+
+			OnReady(ReadbackData);
+		}
+		else
+		{
+			UE_LOG(LogMillicastPublisher, Warning, TEXT("Could not lock capture readback"));
+		}
+
+		Slot.Readback->Unlock();
+
+		ReadIndex = (ReadIndex + 1) % Slots.Num();
+		--InFlightCount;
+	}
+}
+
+void FTextureReadbackRing::Reset()
+{
+	WriteIndex = 0;
+	ReadIndex = 0;
+	InFlightCount = 0;
+}
@@ -0,0 +1,84 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#pragma once
+
+#include "RHI.h"
+#include "RHIGPUReadback.h"
+#include "RenderGraphFwd.h"
+#include "ReadbackPool.h"
+
+/**
+* Ring of GPU readback staging buffers.
+* A copy of the captured texture is enqueued in the next free slot and polled on the following frames,
+* so the render thread never waits for the GPU. Frames are delivered one or two frames late instead.
+* Must only be used from the rendering thread.
+*/
+class FTextureReadbackRing
+{
+public:
+	/** Memory layout of the data read back */
+	enum class ELayout : uint8
+	{
+		Texture, // Pixels of the captured texture, in its own format
+		NV12     // Y plane followed by the interleaved U/V plane, converted on the GPU
+	};
+
+	/** CPU view of a completed readback. Only valid for the duration of the poll callback. */
+	struct FReadbackData
+	{
+		const uint8* Data;
+		int32 Stride; // in bytes
+		int32 Width;  // of the video frame
+		int32 Height; // of the video frame
+		FIntRect SourceRect; // Region of the data holding the frame, scaled to Width x Height
+		EPixelFormat Format;
+		ELayout Layout;
+		int64 TimestampUs;
+	};
+
+	using FOnReadbackReady = TFunctionRef<void(const FReadbackData&)>;
+
+	/** The readbacks of the slots are taken from the pool, which must outlive the ring */
+	FTextureReadbackRing(int32 InNumSlots, FReadbackPool& InReadbackPool) noexcept;
+
+	/**
+	* Add a pass to the graph copying the texture in the next free slot.
+	* The frame is the SourceRect region of the texture, in the given layout, to be scaled to FrameSize.
+	* Returns false and drops the frame if every slot is still waiting for the GPU, or no readback fits in the pool memory cap.
+	*/
+	bool Enqueue(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, FIntRect SourceRect, FIntPoint FrameSize, ELayout Layout, int64 TimestampUs);
+
+	/** Call OnReady for every completed readback, oldest first, and release their slots */
+	void Poll(FRHICommandListImmediate& RHICmdList, FOnReadbackReady OnReady);
+
+	/** Forget all the pending readbacks */
+	void Reset();
+
+	/** Number of readbacks waiting for the GPU */
+	int32 NumInFlight() const { return InFlightCount; }
+
+	/** Whether every slot is waiting for the GPU */
+	bool IsFull() const { return InFlightCount == Slots.Num(); }
+
+private:
+	struct FSlot
+	{
+		TUniquePtr<FRHIGPUTextureReadback> Readback;
+		FIntPoint Size = FIntPoint::ZeroValue; // of the staging texture
+		EPixelFormat Format = PF_Unknown;
+		FIntRect SourceRect;
+		FIntPoint FrameSize = FIntPoint::ZeroValue;
+		ELayout Layout = ELayout::Texture;
+		int64 TimestampUs = 0;
+	};
+
+	/** Get the next free slot with a readback matching the texture size and format, or nullptr if there is none */
+	FSlot* AcquireSlot(FIntPoint Size, EPixelFormat Format);
+
+	TArray<FSlot> Slots;
+	FReadbackPool& ReadbackPool;
+
+	int32 WriteIndex;    // Next slot to write to
+	int32 ReadIndex;     // Oldest slot in flight
+	int32 InFlightCount;
+};
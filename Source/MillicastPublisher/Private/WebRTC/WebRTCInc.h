@@ -24,11 +24,14 @@ THIRD_PARTY_INCLUDES_START
 #include "api/media_stream_interface.h"
 #include "api/peer_connection_interface.h"
 #include "api/create_peerconnection_factory.h"
+#include "api/stats/rtcstats_objects.h"
 #include "api/task_queue/default_task_queue_factory.h"
 #include "api/audio_codecs/audio_decoder_factory.h"
 #include "api/audio_codecs/audio_encoder_factory.h"
 #include "api/audio_codecs/opus/audio_decoder_opus.h"
 #include "api/audio_codecs/opus/audio_encoder_opus.h"
+#include "api/audio_codecs/opus/audio_decoder_multi_channel_opus.h"
+#include "api/audio_codecs/opus/audio_encoder_multi_channel_opus.h"
 #include "api/audio_codecs/audio_decoder_factory_template.h"
 #include "api/audio_codecs/audio_encoder_factory_template.h"
 #include "api/audio_codecs/builtin_audio_encoder_factory.h"
@@ -37,17 +40,23 @@ THIRD_PARTY_INCLUDES_START
 #include "api/video_codecs/builtin_video_encoder_factory.h"
 #include "api/video_codecs/video_decoder_factory.h"
 #include "api/video_codecs/video_encoder_factory.h"
+#include "api/video_codecs/video_encoder.h"
 #include "api/video/video_frame.h"
 #include "api/video/video_rotation.h"
 #include "api/video/video_frame_buffer.h"
 #include "api/video/i420_buffer.h"
+#if WEBRTC_VERSION >= 96
+#include "api/video/nv12_buffer.h"
+#endif
 #include "api/video/video_sink_interface.h"
 
 #include "media/base/adapted_video_track_source.h"
+#include "media/base/media_constants.h"
 
 #include "modules/audio_device/include/audio_device.h"
 #include "modules/audio_device/audio_device_buffer.h"
 #include "modules/video_capture/video_capture.h"
+#include "modules/video_coding/include/video_codec_interface.h"
 
 #include "pc/session_description.h"
 #include "pc/video_track_source.h"
@@ -51,6 +51,29 @@ public:
 	static IMillicastVideoSource* Create(UTextureRenderTarget2D* RenderTarget);
 };
 
+/** Video codecs the encoded video can be published with */
+UENUM(BlueprintType)
+enum VideoCodecType
+{
+	VIDEO_VP8  UMETA(DisplayName = "VP8"),
+	VIDEO_VP9  UMETA(DisplayName = "VP9"),
+	VIDEO_H264 UMETA(DisplayName = "H264"),
+	VIDEO_AV1  UMETA(DisplayName = "AV1"),
+};
+
+/**
+* Temporal and spatial layers of a scalable video encoding. L1T3 sends one resolution at three framerates,
+* L3T3 three resolutions at three framerates each, which viewers can drop without another encode
+*/
+UENUM(BlueprintType)
+enum VideoScalabilityMode
+{
+	SCALABILITY_NONE UMETA(DisplayName = "None"),
+	SCALABILITY_L1T2 UMETA(DisplayName = "L1T2"),
+	SCALABILITY_L1T3 UMETA(DisplayName = "L1T3"),
+	SCALABILITY_L3T3 UMETA(DisplayName = "L3T3"),
+};
+
 UENUM(BlueprintType)
 enum AudioCapturerType
 {
@@ -59,6 +82,26 @@ enum AudioCapturerType
 	LOOPBACK UMETA(DisplayName = "Loopback (windows only)"),
 };
 
+/** Channels of the published audio, in the engine channel order */
+UENUM(BlueprintType)
+enum AudioChannelLayout
+{
+	AUDIO_MONO   UMETA(DisplayName = "Mono"),
+	AUDIO_STEREO UMETA(DisplayName = "Stereo"),
+	AUDIO_5_1    UMETA(DisplayName = "5.1"),
+	AUDIO_7_1    UMETA(DisplayName = "7.1"),
+};
+
+/** Duration of the audio in each Opus packet. Longer packets have less overhead, shorter ones less latency */
+UENUM(BlueprintType)
+enum AudioPacketDuration
+{
+	AUDIO_PACKET_10MS UMETA(DisplayName = "10 ms"),
+	AUDIO_PACKET_20MS UMETA(DisplayName = "20 ms"),
+	AUDIO_PACKET_40MS UMETA(DisplayName = "40 ms"),
+	AUDIO_PACKET_60MS UMETA(DisplayName = "60 ms"),
+};
+
 /**
 * Specialized interface for audio source.
 * Basically, the audio source is reading audio data from the main audio device 
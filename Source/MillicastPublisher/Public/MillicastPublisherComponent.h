@@ -14,6 +14,83 @@ class IWebSocket;
 class FWebRTCPeerConnection;
 class IHttpResponse;
 
+/** Priority of a sender, relative to the others */
+UENUM(BlueprintType)
+enum EncodingPriority
+{
+	PRIORITY_VERY_LOW UMETA(DisplayName = "Very low"),
+	PRIORITY_LOW      UMETA(DisplayName = "Low"),
+	PRIORITY_MEDIUM   UMETA(DisplayName = "Medium"),
+	PRIORITY_HIGH     UMETA(DisplayName = "High"),
+};
+
+/** Parameters of an encoding sent, one per simulcast layer. Can be changed while publishing */
+USTRUCT(BlueprintType)
+struct FMillicastEncodingParameters
+{
+	GENERATED_BODY()
+
+	/** Identifier of the simulcast layer, empty without simulcast. Can't be changed */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Encoding)
+	FString Rid;
+
+	/** Whether the encoding is sent */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Encoding)
+	bool Active = true;
+
+	/** Bitrate the encoding doesn't go over, in kbps. 0 for no limit */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Encoding, META = (ClampMin = 0))
+	int32 MaxBitrate = 0;
+
+	/** Frames per second the encoding doesn't go over. 0 for no limit, ignored for audio */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Encoding, META = (ClampMin = 0))
+	int32 MaxFramerate = 0;
+
+	/** The captured resolution is divided by this factor. Ignored for audio */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Encoding, META = (ClampMin = 1))
+	float ScaleResolutionDownBy = 1.f;
+
+	/** Share of the available bandwidth given to the encoding, relative to the others. 1 by default */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Encoding, META = (ClampMin = 0))
+	float BitratePriority = 1.f;
+
+	/** Priority of the packets on the network, marked with DSCP */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Encoding)
+	TEnumAsByte<EncodingPriority> NetworkPriority = EncodingPriority::PRIORITY_LOW;
+};
+
+/** Encoding stats of a video layer, one per simulcast layer */
+USTRUCT(BlueprintType)
+struct FMillicastVideoLayerStats
+{
+	GENERATED_BODY()
+
+	/** Identifier of the simulcast layer, empty without simulcast. Always empty before webrtc 96, the layers differ by their resolution */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	FString Rid;
+
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int32 Width = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int32 Height = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	float FramesPerSecond = 0.f;
+
+	/** Frames encoded since the publishing started */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int64 FramesEncoded = 0;
+
+	/** Average time spent encoding a frame, in milliseconds */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	float EncodeMsPerFrame = 0.f;
+
+	/** Bitrate the encoder currently aims at, in kbps */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	float TargetBitrate = 0.f;
+};
+
 // Event declaration
 DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE(FMillicastPublisherComponentAuthenticated, UMillicastPublisherComponent, OnAuthenticated);
 DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE_TwoParams(FMillicastPublisherComponentAuthenticationFailure, UMillicastPublisherComponent, OnAuthenticationFailure, int, Code, const FString&, Msg);
@@ -24,6 +101,8 @@ DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE_OneParam(FMillicastPublisherComponentP
 DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE(FMillicastPublisherComponentActive, UMillicastPublisherComponent, OnActive);
 DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE(FMillicastPublisherComponentInactive, UMillicastPublisherComponent, OnInactive);
 
+DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE_OneParam(FMillicastPublisherComponentVideoLayerStats, UMillicastPublisherComponent, OnVideoLayerStats, const TArray<FMillicastVideoLayerStats>&, Layers);
+
 /**
 	A component used to publish audio, video feed to millicast.
 */
@@ -78,11 +157,51 @@ public:
 
 	/**
 	* Set the maximum bitrate for the peerconnection
-	* Have to be called before Publish
+	* Can be called before Publish or while publishing
 	*/
 	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "SetMaximumBitrate"))
 	void SetMaximumBitrate(int Bps);
 
+	/**
+	* Set the minimum bitrate for the peerconnection, the bandwidth estimate doesn't go under it
+	* Can be called before Publish or while publishing
+	*/
+	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "SetMinimumBitrate"))
+	void SetMinimumBitrate(int Bps);
+
+	/**
+	* Set the bitrate the bandwidth estimate starts from, instead of ramping up from the webrtc default
+	* When called while publishing, the estimate restarts from it
+	*/
+	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "SetStartBitrate"))
+	void SetStartBitrate(int Bps);
+
+	/** Get the parameters of the audio encoding sent. Empty if not publishing audio */
+	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "GetAudioEncodingParameters"))
+	TArray<FMillicastEncodingParameters> GetAudioEncodingParameters() const;
+
+	/** Change the parameters of the audio encoding sent, while publishing. Returns false if they couldn't be applied */
+	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "SetAudioEncodingParameters"))
+	bool SetAudioEncodingParameters(const TArray<FMillicastEncodingParameters>& Parameters);
+
+	/** Get the parameters of each video encoding sent, one per simulcast layer. Empty if not publishing video */
+	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "GetVideoEncodingParameters"))
+	TArray<FMillicastEncodingParameters> GetVideoEncodingParameters() const;
+
+	/**
+	* Change the parameters of the video encodings sent, while publishing. The encodings are matched by their order,
+	* as returned by GetVideoEncodingParameters, and can't be added or removed. Returns false if they couldn't be applied
+	*/
+	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "SetVideoEncodingParameters"))
+	bool SetVideoEncodingParameters(const TArray<FMillicastEncodingParameters>& Parameters);
+
+	/**
+	* Collect the encoding stats of each video layer while publishing.
+	* OnVideoLayerStats is called with them once they're collected
+	*/
+	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "RequestVideoLayerStats"))
+	void RequestVideoLayerStats();
+
 public:
 	/** Called when the response from the Publisher api is successfull */
 	UPROPERTY(BlueprintAssignable, Category = "Components|Activation")
@@ -108,6 +227,10 @@ public:
 	UPROPERTY(BlueprintAssignable, Category = "Components|Activation")
 	FMillicastPublisherComponentInactive OnInactive;
 
+	/** Called with the encoding stats of each video layer, after RequestVideoLayerStats */
+	UPROPERTY(BlueprintAssignable, Category = "Components|Activation")
+	FMillicastPublisherComponentVideoLayerStats OnVideoLayerStats;
+
 private:
 	/** Websocket callback */
 	bool StartWebSocketConnection(const FString& url, const FString& jwt);
@@ -122,6 +245,13 @@ private:
 	/** Create the peerconnection and starts subscribing*/
 	bool PublishToMillicast();
 
+	/** Apply the bitrates set to the peerconnection. The start bitrate resets the bandwidth estimate */
+	void ApplyBitrates(bool bApplyStartBitrate);
+
+	/** Encodings of the sender of a kind of track, audio or video */
+	TArray<FMillicastEncodingParameters> GetEncodingParameters(const std::string& Kind) const;
+	bool SetEncodingParameters(const std::string& Kind, const TArray<FMillicastEncodingParameters>& Parameters);
+
 	void ParseDirectorResponse(TSharedPtr<IHttpResponse, ESPMode::ThreadSafe> Response);
 	void SetupIceServersFromJson(TArray<TSharedPtr<FJsonValue>> IceServersField);
 
@@ -139,5 +269,7 @@ private:
 
 	/** Publisher */
 	bool bIsPublishing;
+	TOptional<int> MinimumBitrate; // in bps
+	TOptional<int> StartBitrate; // in bps
 	TOptional<int> MaximumBitrate; // in bps
 };
@@ -26,6 +26,131 @@ struct FAudioCaptureInfo
 		DeviceName(MoveTemp(InDeviceName)), DeviceId(MoveTemp(InDeviceId)) {}
 };
 
+/** Encoding of the published video, sent along the others with simulcast */
+USTRUCT(BlueprintType)
+struct FMillicastSimulcastLayer
+{
+	GENERATED_BODY()
+
+	/** Identifier of the layer in the offer, letters and digits only. Generated from the layer index if empty */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Video)
+	FString Rid;
+
+	/** The captured resolution is divided by this factor, 1 sends the captured resolution */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Video, META = (ClampMin = 1))
+	float ScaleResolutionDownBy = 1.f;
+
+	/** Bitrate the layer doesn't go over, in kbps. 0 lets webrtc choose it from the resolution */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Video, META = (ClampMin = 0))
+	int32 MaxBitrate = 0;
+
+	/** Frames per second the layer doesn't go over. 0 sends every frame captured */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Video, META = (ClampMin = 0, ClampMax = 240))
+	int32 MaxFramerate = 0;
+};
+
+/** Video capture counters, since the capture started */
+USTRUCT(BlueprintType)
+struct FMillicastVideoCaptureStats
+{
+	GENERATED_BODY()
+
+	/** Frames pushed to WebRTC */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int64 FramesCaptured = 0;
+
+	/** Engine frames skipped to hold the capture framerate */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int64 FramesSkipped = 0;
+
+	/** Frames dropped by WebRTC adaptation or because the GPU readbacks were late */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int64 FramesDropped = 0;
+
+	/** Frames not pushed because they were identical to the previous one */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int64 FramesStatic = 0;
+
+	/** Frames read back and waiting to be converted */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int64 QueueDepth = 0;
+
+	/** Frames dropped because too many frames were waiting to be converted */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int64 QueueFramesDropped = 0;
+
+	/** Average time a frame waited to be converted, in microseconds */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int64 QueueAverageWaitUs = 0;
+
+	/** Longest time a frame waited to be converted, in microseconds */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int64 QueueMaxWaitUs = 0;
+
+	/** Frame buffers reused from the pool */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int64 BufferPoolHits = 0;
+
+	/** Frame buffers that had to be allocated */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int64 BufferPoolMisses = 0;
+
+	/** Memory held by the frame buffer pool, in bytes */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int64 BufferPoolResidentBytes = 0;
+
+	/** GPU readback staging memory held by the capture, in bytes */
+	UPROPERTY(BlueprintReadOnly, Category = Video)
+	int64 ReadbackPoolResidentBytes = 0;
+};
+
+/** Counters of the audio of a source buffered before being mixed and sent to WebRTC */
+USTRUCT(BlueprintType)
+struct FMillicastAudioCaptureStats
+{
+	GENERATED_BODY()
+
+	/** Audio buffered and waiting to be sent, in milliseconds */
+	UPROPERTY(BlueprintReadOnly, Category = Audio)
+	float BufferedMs = 0.f;
+
+	/** Audio buffers dropped because too much audio was buffered */
+	UPROPERTY(BlueprintReadOnly, Category = Audio)
+	int64 Overruns = 0;
+
+	/** 10 ms blocks not sent because not enough audio was buffered */
+	UPROPERTY(BlueprintReadOnly, Category = Audio)
+	int64 Underruns = 0;
+
+	/** Drift of the audio capture clock compensated by resampling, in parts per million */
+	UPROPERTY(BlueprintReadOnly, Category = Audio)
+	float DriftPpm = 0.f;
+
+	/** Times the oldest audio was dropped because too much was buffered */
+	UPROPERTY(BlueprintReadOnly, Category = Audio)
+	int64 Sheds = 0;
+
+	/** Total duration of the audio dropped, in milliseconds */
+	UPROPERTY(BlueprintReadOnly, Category = Audio)
+	float ShedMs = 0.f;
+
+	/** Number of 10 ms blocks sent by buffered duration, in buckets up to 10, 20, 40, 80, 160, 320 ms and above */
+	UPROPERTY(BlueprintReadOnly, Category = Audio)
+	TArray<int64> BufferedMsHistogram;
+
+	/** Smoothed deviation of the interval between two 10 ms blocks handed to WebRTC from 10 ms, shared by all the sources */
+	UPROPERTY(BlueprintReadOnly, Category = Audio)
+	float DeliveryJitterMs = 0.f;
+
+	/** Largest deviation of the interval between two 10 ms blocks handed to WebRTC from 10 ms */
+	UPROPERTY(BlueprintReadOnly, Category = Audio)
+	float MaxDeliveryJitterMs = 0.f;
+
+	/** Most 10 ms blocks handed to WebRTC at once, catching up after a late delivery */
+	UPROPERTY(BlueprintReadOnly, Category = Audio)
+	int64 MaxBlocksPerDelivery = 0;
+};
+
 /**
  * Media source description for Millicast Publisher.
  */
@@ -57,6 +182,55 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Video, AssetRegistrySearchable)
 	UTextureRenderTarget2D* RenderTarget = nullptr;
 
+	/** Maximum number of frames captured per second. 0 captures every engine frame */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Video, AssetRegistrySearchable, META = (ClampMin = 0, ClampMax = 240))
+	int32 CaptureFramerate = 0;
+
+	/** Don't encode the frames identical to the previous one, which saves bandwidth and CPU for static content */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Video, AssetRegistrySearchable)
+	bool SkipStaticFrames = false;
+
+	/** Frames per second still published while the content doesn't change. 0 publishes none until it changes */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Video, AssetRegistrySearchable, META = (ClampMin = 0, ClampMax = 60))
+	float StaticFrameRefreshRate = 1.f;
+
+	/**
+	* Video codecs offered, in order of preference, the server picks the first one it supports. VP8 costs the least CPU,
+	* VP9 and AV1 need less bandwidth for the same quality, H264 can be hardware encoded and decoded.
+	* The codecs not listed aren't offered. Empty offers every codec available, in the webrtc order
+	*/
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Video, AssetRegistrySearchable)
+	TArray<TEnumAsByte<VideoCodecType>> PreferredVideoCodecs;
+
+	/**
+	* Video encodings sent at the same time, so the viewers on weak links get a lower resolution instead of lowering
+	* the stream of everyone, for instance 1080p, 540p and 270p with scales of 1, 2 and 4.
+	* Every layer is scaled from the same captured frame. Supported with VP8 and H264. Empty sends a single encoding.
+	* Since webrtc 96 (UE5) the layers are scaled from the frame buffer pool of the capture. Before, webrtc can't ask
+	* the frame for a scaled copy: VP8 and H264 scale into buffers of their own, the other codecs allocate a buffer per layer and frame
+	*/
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Video, AssetRegistrySearchable)
+	TArray<FMillicastSimulcastLayer> SimulcastLayers;
+
+	/**
+	* Scalable video coding mode, supported with VP9 and AV1. Ignored with more than one simulcast layer.
+	* Needs webrtc 96 (UE5), the setting is hidden on the engines before
+	*/
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Video, AssetRegistrySearchable)
+	TEnumAsByte<VideoScalabilityMode> ScalabilityMode = VideoScalabilityMode::SCALABILITY_NONE;
+
+	/** Bitrate the video encoder starts at before the bandwidth is estimated, in kbps. 0 keeps the webrtc default */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Video, AssetRegistrySearchable, META = (ClampMin = 0))
+	int32 VideoStartBitrate = 0;
+
+	/** Bitrate the video encoder doesn't go under, in kbps. 0 keeps the webrtc default */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Video, AssetRegistrySearchable, META = (ClampMin = 0))
+	int32 VideoMinBitrate = 0;
+
+	/** Bitrate the video encoder doesn't go over, in kbps. 0 keeps the webrtc default */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Video, AssetRegistrySearchable, META = (ClampMin = 0))
+	int32 VideoMaxBitrate = 0;
+
 	/** Whether we should capture game audio or not */
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Audio, AssetRegistrySearchable)
 	bool CaptureAudio = true;
@@ -65,6 +239,33 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Audio, AssetRegistrySearchable)
 	TEnumAsByte<AudioCapturerType> AudioCaptureType;
 
+	/**
+	* Channels of the published audio. Mono halves the encoding cost of voice only streams, 5.1 and 7.1 are
+	* published with multichannel Opus. Shared by all the sources publishing audio at the same time
+	*/
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Audio, AssetRegistrySearchable)
+	TEnumAsByte<AudioChannelLayout> AudioChannels = AudioChannelLayout::AUDIO_STEREO;
+
+	/** Average bitrate of the Opus encoder, in kbps. 0 lets the encoder choose it from the channels */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Audio, AssetRegistrySearchable, META = (ClampMin = 0, ClampMax = 510))
+	int32 AudioBitrate = 0;
+
+	/** Duration of the audio in each packet */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Audio, AssetRegistrySearchable)
+	TEnumAsByte<AudioPacketDuration> AudioPacketTime = AudioPacketDuration::AUDIO_PACKET_20MS;
+
+	/** Discontinuous transmission, almost nothing is sent during silences */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Audio, AssetRegistrySearchable)
+	bool AudioDtx = false;
+
+	/** In-band forward error correction, lost packets are partly recovered from the next one */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Audio, AssetRegistrySearchable)
+	bool AudioFec = true;
+
+	/** Constant bitrate, instead of a bitrate varying with the content */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Audio, AssetRegistrySearchable)
+	bool AudioCbr = false;
+
 	/** Audio submix */
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Audio, AssetRegistrySearchable)
 	USoundSubmix* Submix;
@@ -81,6 +282,17 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Audio, AssetRegistrySearchable)
 	float VolumeMultiplier = 20.f;
 
+	/**
+	* Linear gain of this source when the audio of several sources is mixed in the published audio,
+	* for instance the game audio and a commentator microphone
+	*/
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Audio, AssetRegistrySearchable, META = (ClampMin = 0, UIMax = 2))
+	float MixGain = 1.f;
+
+	/** Leave the audio of this source out of the mix, without stopping its capture */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = Audio, AssetRegistrySearchable)
+	bool MixMuted = false;
+
 public:
 	/** Mute the video stream */
 	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "MuteVideo"))
@@ -90,6 +302,18 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "ChangeRenderTarget"))
 	void ChangeRenderTarget(UTextureRenderTarget2D * InRenderTarget);
 
+	/** Set the maximum number of frames captured per second, 0 to capture every engine frame */
+	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "SetCaptureFramerate"))
+	void SetCaptureFramerate(int32 Framerate);
+
+	/** Enable or disable the static frames detection, and set how many static frames per second are still published */
+	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "SetSkipStaticFrames"))
+	void SetSkipStaticFrames(bool Enabled, float RefreshRate = 1.f);
+
+	/** Get the video capture counters */
+	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "GetVideoCaptureStats"))
+	FMillicastVideoCaptureStats GetVideoCaptureStats() const;
+
 public:
 	/** Mute the audio stream */
 	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "MuteAudio"))
@@ -111,6 +335,18 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "SetVolumeMultiplier"))
 	void SetVolumeMultiplier(float f);
 
+	/** Set the linear gain of this source in the audio mix */
+	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "SetMixGain"))
+	void SetMixGain(float Gain);
+
+	/** Leave the audio of this source out of the mix, or put it back */
+	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "SetMixMuted"))
+	void SetMixMuted(bool Muted);
+
+	/** Get the audio buffer counters of this source */
+	UFUNCTION(BlueprintCallable, Category = "MillicastPublisher", META = (DisplayName = "GetAudioCaptureStats"))
+	FMillicastAudioCaptureStats GetAudioCaptureStats() const;
+
 public:
 	//~ IMediaOptions interface
 
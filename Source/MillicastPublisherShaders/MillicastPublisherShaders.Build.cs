@@ -0,0 +1,22 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+namespace UnrealBuildTool.Rules
+{
+	public class MillicastPublisherShaders : ModuleRules
+	{
+		public MillicastPublisherShaders(ReadOnlyTargetRules Target) : base(Target)
+		{
+			PublicDependencyModuleNames.AddRange(
+				new string[] {
+					"Core",
+					"RenderCore",
+					"RHI"
+				});
+
+			PrivateDependencyModuleNames.AddRange(
+				new string[] {
+					"Projects"
+				});
+		}
+	}
+}
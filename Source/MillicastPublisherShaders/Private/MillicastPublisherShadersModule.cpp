@@ -0,0 +1,27 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/Paths.h"
+#include "Modules/ModuleManager.h"
+#include "ShaderCore.h"
+
+/**
+ * Implements the Millicast Publisher shaders module.
+ * Global shaders have to be registered before the engine initializes, so this module loads at PostConfigInit
+ * while the runtime module keeps its own loading phase.
+ */
+class FMillicastPublisherShadersModule : public IModuleInterface
+{
+public:
+
+	//~ IModuleInterface interface
+	virtual void StartupModule() override
+	{
+		// Map the plugin shaders directory, used for the GPU color conversion of captured frames
+		const FString ShaderDir = FPaths::Combine(IPluginManager::Get().FindPlugin(TEXT("MillicastPublisher"))->GetBaseDir(), TEXT("Shaders"));
+		AddShaderSourceDirectoryMapping(TEXT("/Plugin/MillicastPublisher"), ShaderDir);
+	}
+};
+
+IMPLEMENT_MODULE(FMillicastPublisherShadersModule, MillicastPublisherShaders);
@@ -0,0 +1,77 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#include "RGBToNV12Shader.h"
+
+#include "GlobalShader.h"
+#include "ShaderParameterStruct.h"
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+#include "RHIStaticStates.h"
+
+class FMillicastRGBToNV12CS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FMillicastRGBToNV12CS);
+	SHADER_USE_PARAMETER_STRUCT(FMillicastRGBToNV12CS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture2D<float4>, InputTexture)
+		SHADER_PARAMETER_SAMPLER(SamplerState, InputSampler)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float>, OutputTexture)
+		SHADER_PARAMETER(FIntPoint, OutputSize)
+		SHADER_PARAMETER(FVector2D, InputUVOffset)
+		SHADER_PARAMETER(FVector2D, InputUVScale)
+	END_SHADER_PARAMETER_STRUCT()
+
+	/** Each thread converts a 2x2 block of pixels */
+	static constexpr int32 ThreadGroupSize = 8;
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE"), ThreadGroupSize);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FMillicastRGBToNV12CS, "/Plugin/MillicastPublisher/Private/MillicastRGBToNV12.usf", "MainCS", SF_Compute);
+
+bool IsRGBToNV12Supported(FIntPoint Size)
+{
+	// Chroma is subsampled by 2x2 blocks, odd sizes are left to the CPU conversion
+	return GMaxRHIFeatureLevel >= ERHIFeatureLevel::SM5
+		&& Size.X % 2 == 0 && Size.Y % 2 == 0;
+}
+
+FRDGTextureRef AddRGBToNV12Pass(FRDGBuilder& GraphBuilder, FRDGTextureRef InputTexture, FIntRect InputRect, FIntPoint OutputSize)
+{
+	const FVector2D InputTextureSize(InputTexture->Desc.Extent);
+
+	const FRDGTextureDesc OutputDesc = FRDGTextureDesc::Create2D(
+		FIntPoint(OutputSize.X, OutputSize.Y + OutputSize.Y / 2), PF_G8, FClearValueBinding::None, TexCreate_ShaderResource | TexCreate_UAV);
+
+	FRDGTextureRef OutputTexture = GraphBuilder.CreateTexture(OutputDesc, TEXT("MillicastNV12"));
+
+	// Read the raw texture values, the CPU conversion doesn't linearize sRGB textures either
+	FRDGTextureSRVDesc InputDesc = FRDGTextureSRVDesc::Create(InputTexture);
+	InputDesc.SRGBOverride = SRGBO_ForceDisable;
+
+	auto* PassParameters = GraphBuilder.AllocParameters<FMillicastRGBToNV12CS::FParameters>();
+	PassParameters->InputTexture = GraphBuilder.CreateSRV(InputDesc);
+	PassParameters->InputSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+	PassParameters->OutputTexture = GraphBuilder.CreateUAV(OutputTexture);
+	PassParameters->OutputSize = OutputSize;
+	PassParameters->InputUVOffset = FVector2D(InputRect.Min) / InputTextureSize;
+	PassParameters->InputUVScale = FVector2D(InputRect.Size()) / (FVector2D(OutputSize) * InputTextureSize);
+
+	TShaderMapRef<FMillicastRGBToNV12CS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+
+	FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("MillicastRGBToNV12"), ComputeShader, PassParameters,
+		FComputeShaderUtils::GetGroupCount(OutputSize / 2, FMillicastRGBToNV12CS::ThreadGroupSize));
+
+	return OutputTexture;
+}
@@ -0,0 +1,16 @@
+// Copyright Millicast 2022. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderGraphFwd.h"
+
+/** Whether the GPU color conversion can be used for a frame of this size */
+MILLICASTPUBLISHERSHADERS_API bool IsRGBToNV12Supported(FIntPoint Size);
+
+/**
+* Add a compute pass cropping the input texture to InputRect, scaling it to OutputSize and converting it to NV12.
+* The output is a single PF_G8 texture of OutputSize.X * (OutputSize.Y * 3 / 2) pixels,
+* the Y plane being followed by the interleaved U/V plane, like NV12 in memory.
+*/
+MILLICASTPUBLISHERSHADERS_API FRDGTextureRef AddRGBToNV12Pass(FRDGBuilder& GraphBuilder, FRDGTextureRef InputTexture, FIntRect InputRect, FIntPoint OutputSize);